@@ -1,10 +1,88 @@
 #include <cryptoTools/Common/BitVector.h>
+#include <cryptoTools/Common/CpuFeatures.h>
 #include <sstream>
 #include <cstring>
 #include <iomanip>
+#include <immintrin.h>
 
 namespace osuCrypto {
 
+    namespace
+    {
+        // The number of set bits of x, adding up the counts of ever larger
+        // groups of bits.
+        inline u64 popcountPortable(u64 x)
+        {
+            x = x - ((x >> 1) & 0x5555555555555555ULL);
+            x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+            x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return (x * 0x0101010101010101ULL) >> 56;
+        }
+
+        u64 loadWord(const u8* p)
+        {
+            u64 w;
+            memcpy(&w, p, 8);
+            return w;
+        }
+
+        u64 hammingWeightPortable(const u8* data, u64 bytes)
+        {
+            u64 ham = 0, i = 0;
+            for (; i + 8 <= bytes; i += 8)
+                ham += popcountPortable(loadWord(data + i));
+            for (; i < bytes; ++i)
+                ham += popcountPortable(data[i]);
+            return ham;
+        }
+
+        OC_TARGET("popcnt")
+        u64 hammingWeightPopcnt(const u8* data, u64 bytes)
+        {
+            // four counts so that the popcnt instructions can overlap.
+            u64 h0 = 0, h1 = 0, h2 = 0, h3 = 0, i = 0;
+            for (; i + 32 <= bytes; i += 32)
+            {
+                h0 += _mm_popcnt_u64(loadWord(data + i));
+                h1 += _mm_popcnt_u64(loadWord(data + i + 8));
+                h2 += _mm_popcnt_u64(loadWord(data + i + 16));
+                h3 += _mm_popcnt_u64(loadWord(data + i + 24));
+            }
+            for (; i + 8 <= bytes; i += 8)
+                h0 += _mm_popcnt_u64(loadWord(data + i));
+            for (; i < bytes; ++i)
+                h0 += _mm_popcnt_u32(data[i]);
+            return h0 + h1 + h2 + h3;
+        }
+
+        // Looks up the counts of the low and high nibble of each byte with
+        // vpshufb and sums the bytes of each 64 bit lane with vpsadbw.
+        OC_TARGET("avx2,popcnt")
+        u64 hammingWeightAvx2(const u8* data, u64 bytes)
+        {
+            const __m256i table = _mm256_setr_epi8(
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i low = _mm256_set1_epi8(0x0F);
+            __m256i acc = _mm256_setzero_si256();
+
+            u64 i = 0;
+            for (; i + 32 <= bytes; i += 32)
+            {
+                __m256i v = _mm256_loadu_si256((__m256i*)(data + i));
+                __m256i lo = _mm256_and_si256(v, low);
+                __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+                __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(table, lo), _mm256_shuffle_epi8(table, hi));
+                acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+            }
+
+            u64 ham =
+                u64(_mm256_extract_epi64(acc, 0)) + u64(_mm256_extract_epi64(acc, 1)) +
+                u64(_mm256_extract_epi64(acc, 2)) + u64(_mm256_extract_epi64(acc, 3));
+            return ham + hammingWeightPopcnt(data + i, bytes - i);
+        }
+    }
+
 
     BitVector::BitVector(std::string data)
         :
@@ -186,66 +264,48 @@ namespace osuCrypto {
 
     BitVector BitVector::operator^(const BitVector& B)const
     {
-        BitVector ret(*this);
-
-        ret ^= B;
-
+        BitVector ret;
+        ret.assignExpr(bitExpr(*this) ^ B);
         return ret;
     }
 
     BitVector BitVector::operator&(const BitVector & B) const
     {
-        BitVector ret(*this);
-
-        ret &= B;
-
+        BitVector ret;
+        ret.assignExpr(bitExpr(*this) & B);
         return ret;
     }
 
     BitVector BitVector::operator|(const BitVector & B) const
     {
-        BitVector ret(*this);
-
-        ret |= B;
-
+        BitVector ret;
+        ret.assignExpr(bitExpr(*this) | B);
         return ret;
     }
 
     BitVector BitVector::operator~() const
     {
-        BitVector ret(*this);
-
-        for (u64 i = 0; i < sizeBytes(); i++)
-            ret.mData[i] = ~mData[i];
-
+        BitVector ret;
+        ret.assignExpr(~bitExpr(*this));
         return ret;
     }
 
 
     void BitVector::operator&=(const BitVector & A)
     {
-        for (u64 i = 0; i < sizeBytes(); i++)
-        {
-            mData[i] &= A.mData[i];
-        }
+        assignExpr(bitExpr(*this) & A);
     }
 
     void BitVector::operator|=(const BitVector & A)
     {
-        for (u64 i = 0; i < sizeBytes(); i++)
-        {
-            mData[i] |= A.mData[i];
-        }
+        assignExpr(bitExpr(*this) | A);
     }
 
     void BitVector::operator^=(const BitVector& A)
     {
-        if (mNumBits != A.mNumBits) throw std::runtime_error("rt error at " LOCATION);
-        for (u64 i = 0; i < sizeBytes(); i++)
-        {
-            mData[i] ^= A.mData[i];
-        }
+        assignExpr(bitExpr(*this) ^ A);
     }
+
     void BitVector::fromString(std::string data)
     {
         resize(data.size());
@@ -268,11 +328,10 @@ namespace osuCrypto {
         if (mNumBits != rhs.mNumBits)
             return false;
 
-        u64 lastByte = sizeBytes() - 1;
-        for (u64 i = 0; i < lastByte; i++)
-        {
-            if (mData[i] != rhs.mData[i]) { return false; }
-        }
+        // the whole bytes, then the bits of the last partial byte.
+        u64 fullBytes = mNumBits / 8;
+        if (fullBytes && memcmp(mData, rhs.mData, fullBytes))
+            return false;
 
         // numBits = 4
         // 00001010
@@ -280,9 +339,12 @@ namespace osuCrypto {
         //     ^^^^ compare these
 
         u64 rem = mNumBits & 7;
-        u8 mask = ((u8)-1) >> (8 - rem);
-        if ((mData[lastByte] & mask) != (rhs.mData[lastByte] & mask))
-            return false;
+        if (rem)
+        {
+            u8 mask = ((u8)-1) >> (8 - rem);
+            if ((mData[fullBytes] & mask) != (rhs.mData[fullBytes] & mask))
+                return false;
+        }
 
         return true;
     }
@@ -299,20 +361,22 @@ namespace osuCrypto {
 
     void BitVector::nChoosek(u64 n, u64 k, PRNG & prng)
     {
-        reset(n);
-        // wiki: Reservoir sampling
+        if (k > n)
+            throw std::runtime_error("k must be at most n. " LOCATION);
 
+        reset(n);
 
+        // the first k bits set, then shuffled with Fisher-Yates. Bit i < k
+        // only swaps with other set bits, so the shuffle starts at k.
         memset(data(), u8(-1), k / 8);
-        for (u64 i = k - 1; i >= (k & (~3)); --i)
+        for (u64 i = 8 * (k / 8); i < k; ++i)
             (*this)[i] = 1;
 
-
         for (u64 i = k; i < n; ++i)
         {
-            u64 j = prng.get<u64>() % i;
+            u64 j = prng.getUniform(i + 1);
 
-            if (j < k)
+            if (j < i)
             {
                 u8 b = (*this)[j];
                 (*this)[j] = 0;
@@ -323,47 +387,39 @@ namespace osuCrypto {
 
     u64 BitVector::hammingWeight() const
     {
-        //TODO("make sure top bits are cleared");
-        u64 ham(0);
-        for (u64 i = 0; i < sizeBytes(); ++i)
-        {
-            u8 b = data()[i];
-            while (b)
-            {
-                ++ham;
-                b &= b - 1;
-            }
-        }
+        static const CpuDispatch<u64(const u8*, u64)> kernel{
+            { hammingWeightAvx2, { &CpuFeatures::mAVX2, &CpuFeatures::mPOPCNT } },
+            { hammingWeightPopcnt, { &CpuFeatures::mPOPCNT } },
+            { hammingWeightPortable, {} } };
+
+        // only the bits of the last byte that are part of the vector.
+        u64 fullBytes = mNumBits / 8, rem = mNumBits & 7;
+        u64 ham = kernel(mData, fullBytes);
+        if (rem)
+            ham += popcountPortable(mData[fullBytes] & ((1 << rem) - 1));
         return ham;
     }
 
 
-    u8 BitVector::parity()
+    u8 BitVector::parity() const
     {
-        u8 bit = 0;
+        // the xor of all words has the same parity.
+        u64 fullBytes = mNumBits / 8, rem = mNumBits & 7, i = 0;
+        block x = ZeroBlock;
+        for (; i + 16 <= fullBytes; i += 16)
+            x = x ^ _mm_loadu_si128((block*)(mData + i));
 
-        u64 lastByte = mNumBits / 8;
-        for (u64 i = 0; i < lastByte; i++)
-        {
-
-            bit ^= (mData[i] & 1); // bit 0
-            bit ^= ((mData[i] >> 1) & 1); // bit 1
-            bit ^= ((mData[i] >> 2) & 1); // bit 2
-            bit ^= ((mData[i] >> 3) & 1); // bit 3
-            bit ^= ((mData[i] >> 4) & 1); // bit 4
-            bit ^= ((mData[i] >> 5) & 1); // bit 5
-            bit ^= ((mData[i] >> 6) & 1); // bit 6
-            bit ^= ((mData[i] >> 7) & 1); // bit 7
-        }
+        u64 w = _mm_cvtsi128_si64(x) ^ _mm_extract_epi64(x, 1);
+        for (; i < fullBytes; ++i)
+            w ^= mData[i];
+        if (rem)
+            w ^= mData[fullBytes] & ((1 << rem) - 1);
 
-        u64 lastBits = mNumBits - lastByte * 8;
-        for (u64 i = 0; i < lastBits; i++)
-        {
-            bit ^= (mData[lastByte] >> i) & 1;
-        }
-
-        return bit;
+        for (u64 s = 32; s; s >>= 1)
+            w ^= w >> s;
+        return w & 1;
     }
+
     void BitVector::pushBack(u8 bit)
     {
         if (size() == capacity())
@@ -377,7 +433,7 @@ namespace osuCrypto {
     }
     void BitVector::randomize(PRNG& G)
     {
-        G.get(mData, sizeBytes());
+        G.getBits(*this, size());
     }
 
     std::string BitVector::hex() const
@@ -4,9 +4,37 @@
 #include <cryptoTools/Common/BitIterator.h>
 #include <cryptoTools/Crypto/PRNG.h>
 #include <cryptoTools/Network/IoBuffer.h>
+#include <type_traits>
 
 namespace osuCrypto {
 
+    class BitVector;
+    class BitVectorRef;
+    template<typename Op, typename L, typename R> class BitVectorExpr;
+    template<typename E> class BitVectorNot;
+
+    namespace details
+    {
+        template<typename T> struct IsBitVectorExpr : std::false_type {};
+        template<> struct IsBitVectorExpr<BitVectorRef> : std::true_type {};
+        template<typename Op, typename L, typename R> struct IsBitVectorExpr<BitVectorExpr<Op, L, R>> : std::true_type {};
+        template<typename E> struct IsBitVectorExpr<BitVectorNot<E>> : std::true_type {};
+
+        // BitVectors and expressions of them.
+        template<typename T> struct IsBitVectorOperand : IsBitVectorExpr<T> {};
+        template<> struct IsBitVectorOperand<BitVector> : std::true_type {};
+
+        template<typename E>
+        using EnableIfBitVectorExpr = typename std::enable_if<IsBitVectorExpr<E>::value>::type;
+
+        // Two operands of which at least one is an expression. Two plain
+        // BitVectors use the BitVector member operators instead.
+        template<typename L, typename R>
+        using EnableIfBitVectorExprPair = typename std::enable_if<
+            IsBitVectorOperand<L>::value && IsBitVectorOperand<R>::value &&
+            (IsBitVectorExpr<L>::value || IsBitVectorExpr<R>::value)>::type;
+    }
+
 	// A class to access a vector of packed bits. Similar to std::vector<bool>.
     class BitVector
     {
@@ -84,27 +112,43 @@ namespace osuCrypto {
 		// Get a reference to a specific bit.
         BitReference operator[](const u64 idx) const;
 
-		// Xor two BitVectors together and return the result. Must have the same size. 
+		// Evaluate an expression such as bitExpr(a) ^ (b & c), see BitVectorExpr.
+        template<typename E, typename = details::EnableIfBitVectorExpr<E>>
+        BitVector(const E& expr) { assignExpr(expr); }
+
+		// Evaluate an expression such as bitExpr(a) ^ (b & c) into this BitVector.
+        template<typename E, typename = details::EnableIfBitVectorExpr<E>>
+        BitVector& operator=(const E& expr) { assignExpr(expr); return *this; }
+
+		// Xor two BitVectors together and return the result. Must have the same size.
         BitVector operator^(const BitVector& B)const;
 
-		// AND two BitVectors together and return the result. Must have the same size. 
+		// AND two BitVectors together and return the result. Must have the same size.
         BitVector operator&(const BitVector& B)const;
 
-		// OR two BitVectors together and return the result. Must have the same size. 
+		// OR two BitVectors together and return the result. Must have the same size.
         BitVector operator|(const BitVector& B)const;
 
-		// Invert the bits of the BitVector and return the result. 
+		// Invert the bits of the BitVector and return the result.
         BitVector operator~()const;
 
-		// Xor the rhs into this BitVector
+		// Xor the rhs into this BitVector. Must have the same size.
         void operator^=(const BitVector& A);
 
-		// And the rhs into this BitVector
+		// And the rhs into this BitVector. Must have the same size.
         void operator&=(const BitVector& A);
 
-		// Or the rhs into this BitVector
+		// Or the rhs into this BitVector. Must have the same size.
         void operator|=(const BitVector& A);
 
+		// The same for an expression, which is evaluated in the same pass.
+        template<typename E, typename = details::EnableIfBitVectorExpr<E>>
+        void operator^=(const E& expr);
+        template<typename E, typename = details::EnableIfBitVectorExpr<E>>
+        void operator&=(const E& expr);
+        template<typename E, typename = details::EnableIfBitVectorExpr<E>>
+        void operator|=(const E& expr);
+
 		// Check for equality between two BitVectors
         bool operator==(const BitVector& k) { return equals(k); }
 
@@ -126,7 +170,8 @@ namespace osuCrypto {
 		// Initialize this bit vector to size n with a random set of k bits set to 1.
         void nChoosek(u64 n, u64 k, PRNG& prng);
 
-		// Return the hamming weight of the BitVector.
+		// Return the hamming weight of the BitVector. Uses POPCNT, or AVX2
+		// table lookups for 32 bytes at a time, when the CPU has them.
         u64 hammingWeight() const;
 
 		// Append the bit to the end of the BitVector.
@@ -139,7 +184,7 @@ namespace osuCrypto {
         void randomize(PRNG& G); 
 
 		// Return the parity of the vector.
-        u8 parity();  
+        u8 parity() const;
 
 		// Return the hex representation of the vector.
         std::string hex()const;
@@ -155,8 +200,171 @@ namespace osuCrypto {
 	private:
 		u8* mData = nullptr;
 		u64 mNumBits = 0, mAllocBytes = 0;
+
+        // Resizes to expr.size() and evaluates expr 16 bytes at a time. expr
+        // may refer to this BitVector since byte i only depends on the bytes
+        // i of the operands. The unused bits of the last byte are cleared.
+        template<typename E>
+        void assignExpr(const E& expr);
+    };
+
+    namespace details
+    {
+        inline u64 bitVectorSize(const BitVector& v) { return v.size(); }
+        inline block bitVectorLoad(const BitVector& v, u64 i) { return _mm_loadu_si128((block*)(v.data() + i)); }
+        inline u8 bitVectorByte(const BitVector& v, u64 i) { return v.data()[i]; }
+
+        template<typename E> u64 bitVectorSize(const E& e) { return e.size(); }
+        template<typename E> block bitVectorLoad(const E& e, u64 i) { return e.load(i); }
+        template<typename E> u8 bitVectorByte(const E& e, u64 i) { return e.byte(i); }
+
+        // BitVectors are held by reference and expressions by value.
+        template<typename T> struct BitVectorOperand { typedef T type; };
+        template<> struct BitVectorOperand<BitVector> { typedef const BitVector& type; };
+
+        struct BitXor
+        {
+            static block apply(const block& a, const block& b) { return _mm_xor_si128(a, b); }
+            static u8 apply(u8 a, u8 b) { return a ^ b; }
+        };
+
+        struct BitAnd
+        {
+            static block apply(const block& a, const block& b) { return _mm_and_si128(a, b); }
+            static u8 apply(u8 a, u8 b) { return a & b; }
+        };
+
+        struct BitOr
+        {
+            static block apply(const block& a, const block& b) { return _mm_or_si128(a, b); }
+            static u8 apply(u8 a, u8 b) { return a | b; }
+        };
+    }
+
+    // A BitVector used as an operand of a fused expression, see bitExpr().
+    class BitVectorRef
+    {
+    public:
+        BitVectorRef(const BitVector& v) : mV(v) {}
+
+        u64 size() const { return mV.size(); }
+        block load(u64 i) const { return details::bitVectorLoad(mV, i); }
+        u8 byte(u64 i) const { return mV.data()[i]; }
+
+        BitVector eval() const { return BitVector(*this); }
+
+    private:
+        const BitVector& mV;
+    };
+
+    // An expression of BitVectors such as bitExpr(a) ^ (b & ~bitExpr(c)).
+    // The BitVector operators return a new BitVector for each operation, so
+    // an expression is started with bitExpr(), after which ^, &, | and ~
+    // build the expression instead. Nothing is computed until it is assigned
+    // to a BitVector or eval() is called, which then takes a single pass over
+    // the operands and allocates nothing else. The operands must have the
+    // same size. An expression refers to its BitVectors and must not outlive
+    // them, so it should not be stored with auto.
+    template<typename Op, typename L, typename R>
+    class BitVectorExpr
+    {
+    public:
+        BitVectorExpr(const L& l, const R& r)
+            : mL(l), mR(r)
+        {
+            if (details::bitVectorSize(l) != details::bitVectorSize(r))
+                throw std::runtime_error("BitVectors must have the same size. " LOCATION);
+        }
+
+        u64 size() const { return details::bitVectorSize(mL); }
+
+        // Bytes i to i + 15 of the result.
+        block load(u64 i) const { return Op::apply(details::bitVectorLoad(mL, i), details::bitVectorLoad(mR, i)); }
+
+        // Byte i of the result.
+        u8 byte(u64 i) const { return Op::apply(details::bitVectorByte(mL, i), details::bitVectorByte(mR, i)); }
+
+        // Evaluate the expression into a new BitVector.
+        BitVector eval() const { return BitVector(*this); }
+
+    private:
+        typename details::BitVectorOperand<L>::type mL;
+        typename details::BitVectorOperand<R>::type mR;
     };
 
+    // The expression ~e.
+    template<typename E>
+    class BitVectorNot
+    {
+    public:
+        BitVectorNot(const E& e) : mE(e) {}
+
+        u64 size() const { return details::bitVectorSize(mE); }
+        block load(u64 i) const { return _mm_xor_si128(details::bitVectorLoad(mE, i), _mm_set1_epi32(-1)); }
+        u8 byte(u64 i) const { return ~details::bitVectorByte(mE, i); }
+
+        BitVector eval() const { return BitVector(*this); }
+
+    private:
+        typename details::BitVectorOperand<E>::type mE;
+    };
+
+    // Start a fused expression with the BitVector v.
+    inline BitVectorRef bitExpr(const BitVector& v) { return { v }; }
+
+    // Xor, AND and OR where at least one side is an expression. Must have the same size.
+    template<typename L, typename R, typename = details::EnableIfBitVectorExprPair<L, R>>
+    BitVectorExpr<details::BitXor, L, R> operator^(const L& l, const R& r) { return { l, r }; }
+
+    template<typename L, typename R, typename = details::EnableIfBitVectorExprPair<L, R>>
+    BitVectorExpr<details::BitAnd, L, R> operator&(const L& l, const R& r) { return { l, r }; }
+
+    template<typename L, typename R, typename = details::EnableIfBitVectorExprPair<L, R>>
+    BitVectorExpr<details::BitOr, L, R> operator|(const L& l, const R& r) { return { l, r }; }
+
+    // Invert the bits of an expression.
+    template<typename E, typename = details::EnableIfBitVectorExpr<E>>
+    BitVectorNot<E> operator~(const E& e) { return { e }; }
+
+    // Set dst to a ^ b, a & b and a | b in one pass. a and b must have the
+    // same size and dst may be either of them.
+    inline void xorInto(BitVector& dst, const BitVector& a, const BitVector& b) { dst = bitExpr(a) ^ b; }
+    inline void andInto(BitVector& dst, const BitVector& a, const BitVector& b) { dst = bitExpr(a) & b; }
+    inline void orInto(BitVector& dst, const BitVector& a, const BitVector& b) { dst = bitExpr(a) | b; }
+
+    template<typename E>
+    void BitVector::assignExpr(const E& expr)
+    {
+        resize(expr.size());
+
+        u64 n = sizeBytes(), i = 0;
+        for (; i + 16 <= n; i += 16)
+            _mm_storeu_si128((block*)(mData + i), expr.load(i));
+        for (; i < n; ++i)
+            mData[i] = expr.byte(i);
+
+        if (mNumBits & 7)
+            mData[n - 1] &= u8(0xFF >> (8 - (mNumBits & 7)));
+    }
+
+    template<typename E, typename>
+    void BitVector::operator^=(const E& expr)
+    {
+        assignExpr(bitExpr(*this) ^ expr);
+    }
+
+    template<typename E, typename>
+    void BitVector::operator&=(const E& expr)
+    {
+        assignExpr(bitExpr(*this) & expr);
+    }
+
+    template<typename E, typename>
+    void BitVector::operator|=(const E& expr)
+    {
+        assignExpr(bitExpr(*this) | expr);
+    }
+
     template<class T>
     inline span<T> BitVector::getArrayView() const
     {
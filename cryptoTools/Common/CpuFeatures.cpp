@@ -0,0 +1,108 @@
+#include <cryptoTools/Common/CpuFeatures.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#elif defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#endif
+
+namespace osuCrypto
+{
+    namespace
+    {
+        // regs = {eax, ebx, ecx, edx} of CPUID leaf/subleaf.
+        void cpuid(u32 leaf, u32 subleaf, u32 regs[4])
+        {
+#ifdef _MSC_VER
+            int r[4];
+            __cpuidex(r, int(leaf), int(subleaf));
+            for (u64 i = 0; i < 4; ++i) regs[i] = u32(r[i]);
+#elif defined(__GNUC__) || defined(__clang__)
+            regs[0] = regs[1] = regs[2] = regs[3] = 0;
+            if (__get_cpuid_max(leaf & 0x80000000, nullptr) >= leaf)
+                __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#else
+            regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+        }
+
+        // The register state that the OS saves on a context switch.
+        u64 xgetbv0()
+        {
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#elif defined(__GNUC__) || defined(__clang__)
+            u32 eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (u64(edx) << 32) | eax;
+#else
+            return 0;
+#endif
+        }
+
+        CpuFeatures& mutableFeatures()
+        {
+            static CpuFeatures features = detectCpuFeatures();
+            return features;
+        }
+    }
+
+    CpuFeatures detectCpuFeatures()
+    {
+        CpuFeatures ret;
+        u32 r[4];
+
+        cpuid(0, 0, r);
+        u32 maxLeaf = r[0];
+        if (maxLeaf < 1)
+            return ret;
+
+        cpuid(1, 0, r);
+        ret.mSSE41 = (r[2] >> 19) & 1;
+        ret.mAES = (r[2] >> 25) & 1;
+        ret.mPCLMUL = (r[2] >> 1) & 1;
+        ret.mPOPCNT = (r[2] >> 23) & 1;
+
+        bool osxsave = (r[2] >> 27) & 1;
+        bool avx = (r[2] >> 28) & 1;
+        u64 xcr0 = osxsave ? xgetbv0() : 0;
+
+        // xmm and ymm state, plus opmask and the upper zmm state.
+        bool ymmSaved = (xcr0 & 0x06) == 0x06;
+        bool zmmSaved = (xcr0 & 0xe6) == 0xe6;
+
+        if (maxLeaf >= 7)
+        {
+            cpuid(7, 0, r);
+            ret.mAVX2 = avx && ymmSaved && ((r[1] >> 5) & 1);
+            ret.mAVX512F = zmmSaved && ((r[1] >> 16) & 1);
+            ret.mVAES = avx && ymmSaved && ((r[2] >> 9) & 1);
+            ret.mSHA = (r[1] >> 29) & 1;
+            ret.mVPCLMUL = avx && ymmSaved && ((r[2] >> 10) & 1);
+            ret.mBMI2 = (r[1] >> 8) & 1;
+        }
+
+        return ret;
+    }
+
+    const CpuFeatures& cpuFeatures()
+    {
+        return mutableFeatures();
+    }
+
+    void setCpuFeatures(const CpuFeatures& enabled)
+    {
+        auto detected = detectCpuFeatures();
+        auto& f = mutableFeatures();
+        f.mSSE41 = enabled.mSSE41 && detected.mSSE41;
+        f.mAES = enabled.mAES && detected.mAES;
+        f.mPCLMUL = enabled.mPCLMUL && detected.mPCLMUL;
+        f.mAVX2 = enabled.mAVX2 && detected.mAVX2;
+        f.mAVX512F = enabled.mAVX512F && detected.mAVX512F;
+        f.mVAES = enabled.mVAES && detected.mVAES;
+        f.mSHA = enabled.mSHA && detected.mSHA;
+        f.mVPCLMUL = enabled.mVPCLMUL && detected.mVPCLMUL;
+        f.mBMI2 = enabled.mBMI2 && detected.mBMI2;
+        f.mPOPCNT = enabled.mPOPCNT && detected.mPOPCNT;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// Compiles a single function for the listed instruction set extensions,
+// e.g. OC_TARGET("avx2,vaes"). The rest of the translation unit keeps the
+// baseline flags, so such a function may only be called after cpuFeatures()
+// reported the extensions as present.
+#if defined(__GNUC__) || defined(__clang__)
+#define OC_TARGET(x) __attribute__((target(x)))
+#else
+#define OC_TARGET(x)
+#endif
+
+// Defined if the compiler knows the VAES, VPCLMULQDQ and AVX-512 intrinsics.
+#if (defined(__clang__) && __clang_major__ >= 6) || \
+    (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8) || \
+    (defined(_MSC_VER) && _MSC_VER >= 1920)
+#define OC_HAVE_VAES
+#endif
+
+namespace osuCrypto
+{
+
+    // The instruction set extensions of the host CPU that the library
+    // has kernels for. A flag is only set if the OS also saves the
+    // corresponding register state.
+    struct CpuFeatures
+    {
+        bool mSSE41 = false;
+        bool mAES = false;
+        bool mPCLMUL = false;
+        bool mAVX2 = false;
+        bool mAVX512F = false;
+        bool mVAES = false;
+        bool mSHA = false;
+        bool mVPCLMUL = false;
+        bool mBMI2 = false;
+        bool mPOPCNT = false;
+    };
+
+    // Returns the features of the CPU that the process is running on.
+    // CPUID is queried on the first call.
+    const CpuFeatures& cpuFeatures();
+
+    // Restricts the features that the dispatching code will use to the
+    // intersection of enabled and the detected features. Passing the
+    // result of detectCpuFeatures() restores the default. Intended for
+    // testing the fallback paths; not thread safe.
+    void setCpuFeatures(const CpuFeatures& enabled);
+
+    // Queries CPUID for the features of the host CPU.
+    CpuFeatures detectCpuFeatures();
+
+    // A kernel with one implementation per instruction set. The variants
+    // are listed best first together with the features they need, e.g.
+    //
+    //     static const CpuDispatch<void(block*)> kernel{
+    //         { fooAvx2, { &CpuFeatures::mAVX2 } },
+    //         { fooSse, {} } };
+    //     kernel(data);
+    //
+    // A call goes to the first variant whose features cpuFeatures() reports,
+    // so setCpuFeatures() applies to later calls. The last variant should
+    // need nothing.
+    template<typename Fn>
+    class CpuDispatch
+    {
+    public:
+        struct Variant
+        {
+            Fn* mFn;
+            std::vector<bool CpuFeatures::*> mRequires;
+        };
+
+        CpuDispatch(std::initializer_list<Variant> variants)
+            : mVariants(variants)
+        {}
+
+        // The best variant that the CPU supports.
+        Fn* get() const
+        {
+            auto& cpu = cpuFeatures();
+            for (auto& v : mVariants)
+            {
+                if (std::all_of(v.mRequires.begin(), v.mRequires.end(),
+                    [&](bool CpuFeatures::* f) { return cpu.*f; }))
+                    return v.mFn;
+            }
+            throw std::runtime_error("the CPU supports no variant of the kernel. " LOCATION);
+        }
+
+        template<typename... Args>
+        auto operator()(Args&&... args) const
+            -> decltype(std::declval<Fn*>()(std::forward<Args>(args)...))
+        {
+            return get()(std::forward<Args>(args)...);
+        }
+
+    private:
+        std::vector<Variant> mVariants;
+    };
+}
@@ -214,12 +214,11 @@ namespace osuCrypto
 		{
 			auto min = std::min<u64>(items.size() - i, hashs.size());
 
-			hasher.ecbEncBlocks(items.data() + i, min, hashs.data());
+			hasher.hashBlocks(items.data() + i, min, hashs.data());
 
 			for (u64 j = 0, jj = i; j < min; ++j, ++jj)
 			{
 				idxs[j] = jj + startIdx;
-				hashs[j] = hashs[j] ^ items[jj];
 
 				//if(jj < 1) std::cout<< IoStream::lock << "item[" << jj << "] = " <<items[jj]<<" -> " << hashs[j] << std::endl << IoStream::unlock;
 			}
@@ -637,7 +636,7 @@ namespace osuCrypto
 		for (u64 i = 0; i < u64(inputs.size()); ++i)
 		{
 
-			block hash = hasher.ecbEncBlock(inputs[i]) ^ inputs[i];
+			block hash = hasher.hashBlock(inputs[i]);
 
 			if (neq(hash, mHashes[i]))
 				throw std::runtime_error(LOCATION);
@@ -0,0 +1,159 @@
+#include <cryptoTools/Common/RankSelect.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cstring>
+#include <immintrin.h>
+
+namespace osuCrypto
+{
+    namespace
+    {
+        inline u64 popcountPortable(u64 x)
+        {
+            x = x - ((x >> 1) & 0x5555555555555555ULL);
+            x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+            x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return (x * 0x0101010101010101ULL) >> 56;
+        }
+
+        OC_TARGET("popcnt")
+        u64 popcountHw(u64 x)
+        {
+            return _mm_popcnt_u64(x);
+        }
+
+        inline u64 popcount(u64 x)
+        {
+            return cpuFeatures().mPOPCNT ? popcountHw(x) : popcountPortable(x);
+        }
+
+        // The position of the lowest set bit of x != 0.
+        inline u64 lowestBit(u64 x)
+        {
+            return popcount((x & (0 - x)) - 1);
+        }
+
+        // The position of the k-th set bit of x, which has more than k.
+        // PDEP moves bit k of the mask to the k-th set bit of x.
+        OC_TARGET("bmi2")
+        u64 selectInWordBmi2(u64 x, u64 k)
+        {
+            return _pdep_u64(1ULL << k, x);
+        }
+
+        inline u64 selectInWord(u64 x, u64 k)
+        {
+            if (cpuFeatures().mBMI2)
+                return lowestBit(selectInWordBmi2(x, k));
+
+            for (u64 i = 0; i < k; ++i)
+                x &= x - 1;
+            return lowestBit(x);
+        }
+    }
+
+    void RankSelect::init(const BitVector& bits)
+    {
+        mData = bits.data();
+        mNumBits = bits.size();
+        mFullWords = mNumBits / 64;
+
+        // the last partial word is copied so that word() never reads past the
+        // bytes of the BitVector.
+        mLastWord = 0;
+        if (mNumBits & 63)
+        {
+            memcpy(&mLastWord, mData + 8 * mFullWords, bits.sizeBytes() - 8 * mFullWords);
+            mLastWord &= ~0ULL >> (64 - (mNumBits & 63));
+        }
+
+        u64 numWords = (mNumBits + 63) / 64;
+        u64 numBlocks = (numWords + 7) / 8;
+        mCounts.assign(2 * (numBlocks + 1), 0);
+        mSamples.clear();
+
+        u64 total = 0;
+        for (u64 b = 0; b < numBlocks; ++b)
+        {
+            mCounts[2 * b] = total;
+
+            u64 packed = 0, inBlock = 0;
+            for (u64 w = 0; w < 8; ++w)
+            {
+                if (w)
+                    packed |= inBlock << (9 * (w - 1));
+
+                u64 idx = 8 * b + w;
+                if (idx < numWords)
+                {
+                    u64 x = word(idx);
+                    u64 c = popcount(x);
+
+                    // the first set bit at a multiple of SampleRate.
+                    u64 next = (total + inBlock + SampleRate - 1) / SampleRate * SampleRate;
+                    if (next < total + inBlock + c)
+                        mSamples.push_back(b);
+
+                    inBlock += c;
+                }
+            }
+
+            mCounts[2 * b + 1] = packed;
+            total += inBlock;
+        }
+        mCounts[2 * numBlocks] = total;
+    }
+
+    u64 RankSelect::word(u64 w) const
+    {
+        if (w < mFullWords)
+        {
+            u64 x;
+            memcpy(&x, mData + 8 * w, 8);
+            return x;
+        }
+        return mLastWord;
+    }
+
+    u64 RankSelect::rank(u64 i) const
+    {
+        if (i > mNumBits)
+            throw std::runtime_error("rank index out of range. " LOCATION);
+
+        u64 b = i / 512, w = (i / 64) % 8;
+        u64 ret = mCounts[2 * b];
+        if (w)
+            ret += (mCounts[2 * b + 1] >> (9 * (w - 1))) & 511;
+        if (i & 63)
+            ret += popcount(word(i / 64) & (~0ULL >> (64 - (i & 63))));
+        return ret;
+    }
+
+    u64 RankSelect::select(u64 k) const
+    {
+        if (k >= count())
+            throw std::runtime_error("select index out of range. " LOCATION);
+
+        // the last block with fewer than k + 1 set bits before it lies
+        // between the blocks of the neighbouring samples.
+        u64 s = k / SampleRate;
+        u64 lo = mSamples[s];
+        u64 hi = s + 1 < mSamples.size() ? mSamples[s + 1] + 1 : mCounts.size() / 2 - 1;
+        while (hi - lo > 1)
+        {
+            u64 mid = (lo + hi) / 2;
+            if (mCounts[2 * mid] <= k)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        k -= mCounts[2 * lo];
+        u64 packed = mCounts[2 * lo + 1], w = 0;
+        while (w < 7 && ((packed >> (9 * w)) & 511) <= k)
+            ++w;
+        if (w)
+            k -= (packed >> (9 * (w - 1))) & 511;
+
+        return 512 * lo + 64 * w + selectInWord(word(8 * lo + w), k);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Common/BitVector.h>
+#include <vector>
+
+namespace osuCrypto
+{
+    // A rank/select directory over a BitVector. rank(i) is the number of set
+    // bits before position i and select(k) is the position of the k-th set
+    // bit, counting from zero, so that rank(select(k)) == k. This maps set
+    // bits to indices of a compacted array and back.
+    //
+    // For every 512 bits the directory keeps the number of set bits before
+    // them plus the counts before each of their 64 bit words, 9 bits each, so
+    // rank is two lookups and one popcount. select finds its 512 bit block by
+    // a binary search between samples taken every 512 set bits, then the word
+    // from the 9 bit counts, then the bit with PDEP when the CPU has BMI2.
+    // The directory takes 1/4 of the size of the BitVector, which must not
+    // change or be moved while the directory is in use.
+    class RankSelect
+    {
+    public:
+        RankSelect() = default;
+        RankSelect(const BitVector& bits) { init(bits); }
+
+        // Builds the directory for bits.
+        void init(const BitVector& bits);
+
+        // The number of bits.
+        u64 size() const { return mNumBits; }
+
+        // The number of set bits.
+        u64 count() const { return mCounts.size() ? mCounts[mCounts.size() - 2] : 0; }
+
+        // The number of set bits before position i, for i <= size().
+        u64 rank(u64 i) const;
+
+        // The position of the k-th set bit, for k < count().
+        u64 select(u64 k) const;
+
+    private:
+        static const u64 SampleRate = 512;
+
+        const u8* mData = nullptr;
+        u64 mNumBits = 0, mFullWords = 0, mLastWord = 0;
+
+        // For each block of 512 bits and a final empty one, the number of
+        // set bits before the block and the packed counts before its words
+        // 1 to 7.
+        std::vector<u64> mCounts;
+
+        // mSamples[j] is the block that holds set bit j * SampleRate.
+        std::vector<u64> mSamples;
+
+        u64 word(u64 w) const;
+    };
+}
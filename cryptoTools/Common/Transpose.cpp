@@ -0,0 +1,215 @@
+#include <cryptoTools/Common/Transpose.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <immintrin.h>
+
+namespace osuCrypto
+{
+    namespace
+    {
+        // Bit j of a 64 bit word is kept by masks[s] if (j & s) == 0.
+        const u64 masks[6] =
+        {
+            0x5555555555555555ULL, 0x3333333333333333ULL, 0x0F0F0F0F0F0F0F0FULL,
+            0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL
+        };
+
+        // Rows i and i + 64 swap their upper and lower 64 bit halves.
+        void swap64(block* inOut)
+        {
+            for (u64 i = 0; i < 64; ++i)
+            {
+                block a = inOut[i], b = inOut[i + 64];
+                inOut[i] = _mm_unpacklo_epi64(a, b);
+                inOut[i + 64] = _mm_unpackhi_epi64(a, b);
+            }
+        }
+
+        // For each pair of rows i and i + s, with (i & s) == 0, swaps the
+        // bits j + s of row i with the bits j of row i + s, where (j & s) == 0.
+        template<int S>
+        void swapSse(block* inOut, const block& mask)
+        {
+            for (u64 i = 0; i < 128; i += 2 * S)
+            {
+                for (u64 k = i; k < i + S; ++k)
+                {
+                    block a = inOut[k], b = inOut[k + S];
+                    block t = _mm_and_si128(_mm_xor_si128(_mm_srli_epi64(a, S), b), mask);
+                    inOut[k + S] = _mm_xor_si128(b, t);
+                    inOut[k] = _mm_xor_si128(a, _mm_slli_epi64(t, S));
+                }
+            }
+        }
+
+        void transpose128Sse(block* inOut)
+        {
+            swap64(inOut);
+            swapSse<32>(inOut, _mm_set1_epi64x(masks[5]));
+            swapSse<16>(inOut, _mm_set1_epi64x(masks[4]));
+            swapSse<8>(inOut, _mm_set1_epi64x(masks[3]));
+            swapSse<4>(inOut, _mm_set1_epi64x(masks[2]));
+            swapSse<2>(inOut, _mm_set1_epi64x(masks[1]));
+            swapSse<1>(inOut, _mm_set1_epi64x(masks[0]));
+        }
+
+        // The same with rows k and k + 1 in one register, for S >= 2.
+        template<int S>
+        OC_TARGET("avx2")
+        void swapAvx2(block* inOut, const __m256i& mask)
+        {
+            for (u64 i = 0; i < 128; i += 2 * S)
+            {
+                for (u64 k = i; k < i + S; k += 2)
+                {
+                    __m256i a = _mm256_loadu_si256((__m256i*)(inOut + k));
+                    __m256i b = _mm256_loadu_si256((__m256i*)(inOut + k + S));
+                    __m256i t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(a, S), b), mask);
+                    _mm256_storeu_si256((__m256i*)(inOut + k + S), _mm256_xor_si256(b, t));
+                    _mm256_storeu_si256((__m256i*)(inOut + k), _mm256_xor_si256(a, _mm256_slli_epi64(t, S)));
+                }
+            }
+        }
+
+        // For S = 1 the pairs are rows k, k + 1 and k + 2, k + 3, which are
+        // regrouped with unpack so that each register holds two rows of one side.
+        OC_TARGET("avx2")
+        void swapAvx2Adjacent(block* inOut, const __m256i& mask)
+        {
+            for (u64 k = 0; k < 128; k += 4)
+            {
+                __m256i x = _mm256_loadu_si256((__m256i*)(inOut + k));
+                __m256i y = _mm256_loadu_si256((__m256i*)(inOut + k + 2));
+                __m256i a = _mm256_permute2x128_si256(x, y, 0x20);
+                __m256i b = _mm256_permute2x128_si256(x, y, 0x31);
+                __m256i t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(a, 1), b), mask);
+                b = _mm256_xor_si256(b, t);
+                a = _mm256_xor_si256(a, _mm256_slli_epi64(t, 1));
+                _mm256_storeu_si256((__m256i*)(inOut + k), _mm256_permute2x128_si256(a, b, 0x20));
+                _mm256_storeu_si256((__m256i*)(inOut + k + 2), _mm256_permute2x128_si256(a, b, 0x31));
+            }
+        }
+
+        // unpack works within each 128 bit lane, so this is swap64 on two
+        // pairs of rows at once. Doing it with 128 bit stores would stall the
+        // 256 bit loads of the next level.
+        OC_TARGET("avx2")
+        void swap64Avx2(block* inOut)
+        {
+            for (u64 i = 0; i < 64; i += 2)
+            {
+                __m256i a = _mm256_loadu_si256((__m256i*)(inOut + i));
+                __m256i b = _mm256_loadu_si256((__m256i*)(inOut + i + 64));
+                _mm256_storeu_si256((__m256i*)(inOut + i), _mm256_unpacklo_epi64(a, b));
+                _mm256_storeu_si256((__m256i*)(inOut + i + 64), _mm256_unpackhi_epi64(a, b));
+            }
+        }
+
+        OC_TARGET("avx2")
+        void transpose128Avx2(block* inOut)
+        {
+            swap64Avx2(inOut);
+            swapAvx2<32>(inOut, _mm256_set1_epi64x(masks[5]));
+            swapAvx2<16>(inOut, _mm256_set1_epi64x(masks[4]));
+            swapAvx2<8>(inOut, _mm256_set1_epi64x(masks[3]));
+            swapAvx2<4>(inOut, _mm256_set1_epi64x(masks[2]));
+            swapAvx2<2>(inOut, _mm256_set1_epi64x(masks[1]));
+            swapAvx2Adjacent(inOut, _mm256_set1_epi64x(masks[0]));
+        }
+    }
+
+    void transpose128(block* inOut)
+    {
+        static const CpuDispatch<void(block*)> kernel{
+            { transpose128Avx2, { &CpuFeatures::mAVX2 } },
+            { transpose128Sse, {} } };
+        kernel(inOut);
+    }
+
+    void transpose128x1024(std::array<std::array<block, 8>, 128>& inOut)
+    {
+        std::array<block, 128> tile;
+        for (u64 k = 0; k < 8; ++k)
+        {
+            for (u64 i = 0; i < 128; ++i)
+                tile[i] = inOut[i][k];
+            transpose128(tile);
+            for (u64 i = 0; i < 128; ++i)
+                inOut[i][k] = tile[i];
+        }
+    }
+
+    void transpose(const MatrixView<u8>& in, const MatrixView<u8>& out, u64 numThreads)
+    {
+        u64 inRows = in.rows(), inCols = in.cols();
+        u64 outBytes = (inRows + 7) / 8;
+        if (out.rows() != 8 * inCols || out.cols() < outBytes)
+            throw std::runtime_error("out must have 8 * in.cols() rows of (in.rows() + 7) / 8 bytes. " LOCATION);
+
+        // tiles of 128 rows by 16 bytes, the last ones padded with zeros.
+        u64 rowTiles = (inRows + 127) / 128;
+        u64 colTiles = (inCols + 15) / 16;
+
+        auto routine = [&](u64 t)
+        {
+            std::array<block, 128> tile;
+            u64 begin = rowTiles * t / numThreads;
+            u64 end = rowTiles * (t + 1) / numThreads;
+            for (u64 r = begin; r < end; ++r)
+            {
+                u64 rows = std::min<u64>(128, inRows - 128 * r);
+                u64 bytes = std::min<u64>(16, outBytes - 16 * r);
+
+                for (u64 c = 0; c < colTiles; ++c)
+                {
+                    u64 cols = std::min<u64>(16, inCols - 16 * c);
+                    const u8* src = in.data() + 128 * r * inCols + 16 * c;
+
+                    if (rows == 128 && cols == 16)
+                    {
+                        for (u64 i = 0; i < 128; ++i)
+                            tile[i] = _mm_loadu_si128((const block*)(src + i * inCols));
+                    }
+                    else
+                    {
+                        memset(tile.data(), 0, sizeof(tile));
+                        for (u64 i = 0; i < rows; ++i)
+                            memcpy(&tile[i], src + i * inCols, cols);
+                    }
+
+                    transpose128(tile);
+
+                    u8* dest = out.data() + 128 * c * out.cols() + 16 * r;
+                    if (bytes == 16 && cols == 16)
+                    {
+                        for (u64 j = 0; j < 128; ++j)
+                            _mm_storeu_si128((block*)(dest + j * out.cols()), tile[j]);
+                    }
+                    else
+                    {
+                        for (u64 j = 0; j < 8 * cols; ++j)
+                            memcpy(dest + j * out.cols(), &tile[j], bytes);
+                    }
+                }
+            }
+        };
+
+        numThreads = std::max<u64>(1, std::min(numThreads, rowTiles));
+        std::vector<std::thread> thrds;
+        for (u64 t = 1; t < numThreads; ++t)
+            thrds.emplace_back(routine, t);
+        routine(0);
+        for (auto& thrd : thrds)
+            thrd.join();
+    }
+
+    void transpose(const MatrixView<block>& in, const MatrixView<block>& out, u64 numThreads)
+    {
+        transpose(
+            MatrixView<u8>((u8*)in.data(), in.rows(), in.cols() * sizeof(block)),
+            MatrixView<u8>((u8*)out.data(), out.rows(), out.cols() * sizeof(block)),
+            numThreads);
+    }
+}
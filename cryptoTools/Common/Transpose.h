@@ -0,0 +1,35 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Common/MatrixView.h>
+#include <array>
+
+namespace osuCrypto
+{
+    // Bit matrix transposes. Bit j of a row is bit j % 8 of its byte j / 8,
+    // so bit j of a block is bit j % 64 of its 64 bit word j / 64. The
+    // 128 x 128 kernel swaps ever smaller sub-blocks between pairs of rows,
+    // two pairs per instruction with AVX2 and one with SSE2.
+
+    // Transposes the 128 x 128 bit matrix whose row i is inOut[i] in place,
+    // so that bit j of row i becomes bit i of row j.
+    void transpose128(block* inOut);
+
+    inline void transpose128(std::array<block, 128>& inOut) { transpose128(inOut.data()); }
+
+    // Transposes the 128 x 1024 bit matrix whose row i is inOut[i] in place,
+    // as eight 128 x 128 tiles. Afterwards row 128 * k + j of the 1024 x 128
+    // result is inOut[j][k].
+    void transpose128x1024(std::array<std::array<block, 8>, 128>& inOut);
+
+    // Transposes the bit matrix in, with in.rows() rows of 8 * in.cols()
+    // bits, into out, which needs 8 * in.cols() rows of at least
+    // (in.rows() + 7) / 8 bytes. Bits of out past the last row of in are zero
+    // and bytes past those are not written. The work is split over the
+    // threads by tiles of 128 rows.
+    void transpose(const MatrixView<u8>& in, const MatrixView<u8>& out, u64 numThreads = 1);
+
+    // The same for matrices of blocks, e.g. N rows of one block into 128 rows
+    // of N / 128 blocks and back.
+    void transpose(const MatrixView<block>& in, const MatrixView<block>& out, u64 numThreads = 1);
+}
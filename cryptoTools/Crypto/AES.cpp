@@ -1,8 +1,68 @@
 #include <cryptoTools/Crypto/AES.h>
+#include <cryptoTools/Crypto/BitslicedAES.h>
+#include <cryptoTools/Common/CpuFeatures.h>
 
+#include <algorithm>
 #include <array>
+#include <cstring>
+#ifdef OC_HAVE_VAES
+#include <immintrin.h>
+#endif
+
 namespace osuCrypto {
 
+    // The round keys and their bitsliced form, which takes about as long to
+    // compute as encrypting 8 blocks and so is done once per key.
+    struct BitslicedKeySchedule
+    {
+        BitslicedKeySchedule(const block* roundKey, int rounds)
+            : mRounds(rounds), mAes(roundKey, rounds)
+        {
+            std::copy(roundKey, roundKey + rounds + 1, mRoundKey);
+        }
+
+        // Whether this was built from roundKey, which the caller may have
+        // changed through the public mRoundKey member.
+        bool matches(const block* roundKey, int rounds) const
+        {
+            return rounds == mRounds &&
+                memcmp(roundKey, mRoundKey, (rounds + 1) * sizeof(block)) == 0;
+        }
+
+        int mRounds;
+        block mRoundKey[BitslicedAES::MaxRounds + 1];
+        BitslicedAES mAes;
+    };
+
+    // The bitsliced round keys of 8 AES-128 keys, one per lane, and the round
+    // keys they were built from.
+    struct BitslicedLaneSchedule
+    {
+        BitslicedLaneSchedule(const block* const* roundKeys)
+        {
+            for (u64 l = 0; l < 8; ++l)
+                std::copy(roundKeys[l], roundKeys[l] + AES::Rounds + 1, mRoundKey[l]);
+            mAes.setRoundKeys(roundKeys, AES::Rounds);
+        }
+
+        bool matches(const block* const* roundKeys) const
+        {
+            for (u64 l = 0; l < 8; ++l)
+                if (memcmp(roundKeys[l], mRoundKey[l], sizeof(mRoundKey[l])))
+                    return false;
+            return true;
+        }
+
+        block mRoundKey[8][AES::Rounds + 1];
+        BitslicedAES mAes;
+    };
+
+    // Group g holds the keys 8g, ..., 8g + 7.
+    struct BitslicedLaneSchedules
+    {
+        std::vector<BitslicedLaneSchedule> mGroups;
+    };
+
     const AES mAesFixedKey(_mm_set_epi8(36, -100, 50, -22, 92, -26, 49, 9, -82, -86, -51, -96, 98, -20, 29, -13));
 
 
@@ -15,778 +75,1464 @@ namespace osuCrypto {
         return _mm_xor_si128(key, keyRcon);
     }
 
-    AES::AES(const block & userKey)
+    namespace
+    {
+        // The functions that use AES-NI are compiled for it with OC_TARGET
+        // and are only called if cpuFeatures().mAES is set. Otherwise the
+        // bitsliced software implementation is used.
+
+        // The 192 and 256 bit key schedules follow the Intel AES-NI white paper.
+
+        // Computes the next 192 bits of the schedule. t1 and the low half of t3
+        // hold the previous 192 bits.
+        void keyGenHelper192(block& t1, block keyRcon, block& t3)
+        {
+            keyRcon = _mm_shuffle_epi32(keyRcon, _MM_SHUFFLE(1, 1, 1, 1));
+            t1 = _mm_xor_si128(t1, _mm_slli_si128(t1, 4));
+            t1 = _mm_xor_si128(t1, _mm_slli_si128(t1, 4));
+            t1 = _mm_xor_si128(t1, _mm_slli_si128(t1, 4));
+            t1 = _mm_xor_si128(t1, keyRcon);
+            t3 = _mm_xor_si128(t3, _mm_slli_si128(t3, 4));
+            t3 = _mm_xor_si128(t3, _mm_shuffle_epi32(t1, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+
+        // The odd round keys of AES-256 use SubWord without the rotation or rcon.
+        OC_TARGET("aes")
+        block keyGenHelper256(block key, block prev)
+        {
+            block sub = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(prev, 0x00), _MM_SHUFFLE(2, 2, 2, 2));
+            key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+            key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+            key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+            return _mm_xor_si128(key, sub);
+        }
+
+        // {lo(a), lo(b)} and {hi(a), lo(b)}.
+        block unpackLoLo(block a, block b) { return _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 0)); }
+        block unpackHiLo(block a, block b) { return _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 1)); }
+
+        OC_TARGET("aes")
+        void expandKey(const block& userKey, block(&roundKey)[11])
+        {
+            roundKey[0] = userKey;
+            roundKey[1] = keyGenHelper(roundKey[0], _mm_aeskeygenassist_si128(roundKey[0], 0x01));
+            roundKey[2] = keyGenHelper(roundKey[1], _mm_aeskeygenassist_si128(roundKey[1], 0x02));
+            roundKey[3] = keyGenHelper(roundKey[2], _mm_aeskeygenassist_si128(roundKey[2], 0x04));
+            roundKey[4] = keyGenHelper(roundKey[3], _mm_aeskeygenassist_si128(roundKey[3], 0x08));
+            roundKey[5] = keyGenHelper(roundKey[4], _mm_aeskeygenassist_si128(roundKey[4], 0x10));
+            roundKey[6] = keyGenHelper(roundKey[5], _mm_aeskeygenassist_si128(roundKey[5], 0x20));
+            roundKey[7] = keyGenHelper(roundKey[6], _mm_aeskeygenassist_si128(roundKey[6], 0x40));
+            roundKey[8] = keyGenHelper(roundKey[7], _mm_aeskeygenassist_si128(roundKey[7], 0x80));
+            roundKey[9] = keyGenHelper(roundKey[8], _mm_aeskeygenassist_si128(roundKey[8], 0x1B));
+            roundKey[10] = keyGenHelper(roundKey[9], _mm_aeskeygenassist_si128(roundKey[9], 0x36));
+        }
+
+        OC_TARGET("aes")
+        void expandKey(const std::array<block, 2>& userKey, block(&roundKey)[13])
+        {
+            block t1 = userKey[0];
+            block t3 = _mm_move_epi64(userKey[1]);
+
+            roundKey[0] = t1;
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x01), t3);
+            roundKey[1] = unpackLoLo(userKey[1], t1);
+            roundKey[2] = unpackHiLo(t1, t3);
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x02), t3);
+            roundKey[3] = t1;
+            roundKey[4] = t3;
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x04), t3);
+            roundKey[4] = unpackLoLo(roundKey[4], t1);
+            roundKey[5] = unpackHiLo(t1, t3);
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x08), t3);
+            roundKey[6] = t1;
+            roundKey[7] = t3;
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x10), t3);
+            roundKey[7] = unpackLoLo(roundKey[7], t1);
+            roundKey[8] = unpackHiLo(t1, t3);
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x20), t3);
+            roundKey[9] = t1;
+            roundKey[10] = t3;
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x40), t3);
+            roundKey[10] = unpackLoLo(roundKey[10], t1);
+            roundKey[11] = unpackHiLo(t1, t3);
+            keyGenHelper192(t1, _mm_aeskeygenassist_si128(t3, 0x80), t3);
+            roundKey[12] = t1;
+        }
+
+        OC_TARGET("aes")
+        void expandKey(const std::array<block, 2>& userKey, block(&roundKey)[15])
+        {
+            roundKey[0] = userKey[0];
+            roundKey[1] = userKey[1];
+            roundKey[2] = keyGenHelper(roundKey[0], _mm_aeskeygenassist_si128(roundKey[1], 0x01));
+            roundKey[3] = keyGenHelper256(roundKey[1], roundKey[2]);
+            roundKey[4] = keyGenHelper(roundKey[2], _mm_aeskeygenassist_si128(roundKey[3], 0x02));
+            roundKey[5] = keyGenHelper256(roundKey[3], roundKey[4]);
+            roundKey[6] = keyGenHelper(roundKey[4], _mm_aeskeygenassist_si128(roundKey[5], 0x04));
+            roundKey[7] = keyGenHelper256(roundKey[5], roundKey[6]);
+            roundKey[8] = keyGenHelper(roundKey[6], _mm_aeskeygenassist_si128(roundKey[7], 0x08));
+            roundKey[9] = keyGenHelper256(roundKey[7], roundKey[8]);
+            roundKey[10] = keyGenHelper(roundKey[8], _mm_aeskeygenassist_si128(roundKey[9], 0x10));
+            roundKey[11] = keyGenHelper256(roundKey[9], roundKey[10]);
+            roundKey[12] = keyGenHelper(roundKey[10], _mm_aeskeygenassist_si128(roundKey[11], 0x20));
+            roundKey[13] = keyGenHelper256(roundKey[11], roundKey[12]);
+            roundKey[14] = keyGenHelper(roundKey[12], _mm_aeskeygenassist_si128(roundKey[13], 0x40));
+        }
+
+        // Encrypts N independent blocks. Both loop bounds are compile time
+        // constants and the round loop is the outer loop so that N aesenc
+        // instructions are issued back to back.
+        template<int Rounds, int N>
+        OC_TARGET("aes")
+        inline void ecbEncNBlocks(const block* roundKey, const block* plaintexts, block* ciphertext)
+        {
+            block temp[N];
+            for (int i = 0; i < N; ++i) temp[i] = _mm_xor_si128(plaintexts[i], roundKey[0]);
+            for (int j = 1; j < Rounds; ++j)
+                for (int i = 0; i < N; ++i) temp[i] = _mm_aesenc_si128(temp[i], roundKey[j]);
+            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenclast_si128(temp[i], roundKey[Rounds]);
+        }
+
+        template<int Rounds, int N>
+        OC_TARGET("aes")
+        inline void ecbDecNBlocks(const block* roundKey, const block* ciphertexts, block* plaintext)
+        {
+            block temp[N];
+            for (int i = 0; i < N; ++i) temp[i] = _mm_xor_si128(ciphertexts[i], roundKey[0]);
+            for (int j = 1; j < Rounds; ++j)
+                for (int i = 0; i < N; ++i) temp[i] = _mm_aesdec_si128(temp[i], roundKey[j]);
+            for (int i = 0; i < N; ++i) plaintext[i] = _mm_aesdeclast_si128(temp[i], roundKey[Rounds]);
+        }
+
+        // Encrypts the N counter blocks {baseIdx, ..., baseIdx + N - 1}.
+        template<int Rounds, int N>
+        OC_TARGET("aes")
+        inline void ecbEncNCounters(const block* roundKey, u64 baseIdx, block* ciphertext)
+        {
+            block temp[N];
+            for (int i = 0; i < N; ++i) temp[i] = _mm_set1_epi64x(baseIdx + i);
+            ecbEncNBlocks<Rounds, N>(roundKey, temp, ciphertext);
+        }
+
+        // Writes, or with Xor xors, the encryptions of {baseIdx, ..., baseIdx + N - 1}
+        // to the N possibly unaligned blocks at data.
+        template<int Rounds, int N, bool Xor>
+        OC_TARGET("aes")
+        inline void ecbEncNCountersUnaligned(const block* roundKey, u64 baseIdx, u8* data)
+        {
+            block temp[N];
+            ecbEncNCounters<Rounds, N>(roundKey, baseIdx, temp);
+            for (int i = 0; i < N; ++i)
+            {
+                block* d = (block*)(data + 16 * i);
+                _mm_storeu_si128(d, Xor ? _mm_xor_si128(_mm_loadu_si128(d), temp[i]) : temp[i]);
+            }
+        }
+
+        // sigma(xL || xR) = (xL ^ xR || xL), where xL is the high half.
+        inline block sigma(const block& x)
+        {
+            return _mm_xor_si128(_mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)), _mm_and_si128(x, _mm_set_epi64x(-1, 0)));
+        }
+
+        // The fused hash kernels: N independent blocks are encrypted back
+        // to back and the feed-forward is applied while they are still in
+        // registers.
+        template<int Rounds, int N>
+        OC_TARGET("aes")
+        inline void hashNBlocks(const block* roundKey, const block* x, block* out)
+        {
+            block temp[N];
+            ecbEncNBlocks<Rounds, N>(roundKey, x, temp);
+            for (int i = 0; i < N; ++i) out[i] = _mm_xor_si128(temp[i], x[i]);
+        }
+
+        template<int Rounds, int N>
+        OC_TARGET("aes")
+        inline void ccrHashNBlocks(const block* roundKey, const block* x, block* out)
+        {
+            block s[N], temp[N];
+            for (int i = 0; i < N; ++i) s[i] = sigma(x[i]);
+            ecbEncNBlocks<Rounds, N>(roundKey, s, temp);
+            for (int i = 0; i < N; ++i) out[i] = _mm_xor_si128(temp[i], s[i]);
+        }
+
+        template<int Rounds, int N>
+        OC_TARGET("aes")
+        inline void tccrHashNBlocks(const block* roundKey, const block* x, const block* tweaks, block* out)
+        {
+            block t[N], u[N];
+            ecbEncNBlocks<Rounds, N>(roundKey, x, t);
+            for (int i = 0; i < N; ++i) u[i] = _mm_xor_si128(t[i], tweaks[i]);
+            ecbEncNBlocks<Rounds, N>(roundKey, u, u);
+            for (int i = 0; i < N; ++i) out[i] = _mm_xor_si128(u[i], t[i]);
+        }
+
+        // The modes of the ECB kernels: the fused hashes xor the (optionally
+        // sigma transformed) input into the output.
+        enum class EcbMode { Plain, Mmo, Ccr };
+
+        template<int Rounds, EcbMode Mode, int N>
+        OC_TARGET("aes")
+        inline void ecbEncNBlocksMode(const block* roundKey, const block* x, block* out)
+        {
+            if (Mode == EcbMode::Plain)
+                ecbEncNBlocks<Rounds, N>(roundKey, x, out);
+            else if (Mode == EcbMode::Mmo)
+                hashNBlocks<Rounds, N>(roundKey, x, out);
+            else
+                ccrHashNBlocks<Rounds, N>(roundKey, x, out);
+        }
+
+        // Expands N AES-128 keys with their schedules interleaved.
+        // SubWord(RotWord(w3)) ^ rcon is computed as aesenclast of a block
+        // whose four columns all hold RotWord(w3), so ShiftRows is the
+        // identity. Unlike aeskeygenassist, which is microcoded on most
+        // cores, aesenclast pipelines across the N keys.
+        template<int N>
+        OC_TARGET("aes")
+        inline void expandKeysN(const block* keys, AES* aes)
+        {
+            const block rotWord = _mm_set1_epi32(0x0c0f0e0d);
+            block rcon = _mm_set1_epi32(1);
+
+            block k[N];
+            for (int i = 0; i < N; ++i) aes[i].mRoundKey[0] = k[i] = keys[i];
+
+            for (int j = 1; j <= AES::Rounds; ++j)
+            {
+                for (int i = 0; i < N; ++i)
+                {
+                    block t = _mm_aesenclast_si128(_mm_shuffle_epi8(k[i], rotWord), rcon);
+                    k[i] = _mm_xor_si128(k[i], _mm_slli_si128(k[i], 4));
+                    k[i] = _mm_xor_si128(k[i], _mm_slli_si128(k[i], 4));
+                    k[i] = _mm_xor_si128(k[i], _mm_slli_si128(k[i], 4));
+                    aes[i].mRoundKey[j] = k[i] = _mm_xor_si128(k[i], t);
+                }
+
+                rcon = j == 8 ? _mm_set1_epi32(0x1b) : _mm_slli_epi32(rcon, 1);
+            }
+        }
+
+        // Encrypts in[l] under the round keys roundKeys[l] for each of the N lanes.
+        template<int N>
+        OC_TARGET("aes")
+        inline void ecbEncNLanes(const block* const* roundKeys, const block* in, block* out)
+        {
+            block temp[N];
+            for (int l = 0; l < N; ++l) temp[l] = _mm_xor_si128(in[l], roundKeys[l][0]);
+            for (int j = 1; j < AES::Rounds; ++j)
+                for (int l = 0; l < N; ++l) temp[l] = _mm_aesenc_si128(temp[l], roundKeys[l][j]);
+            for (int l = 0; l < N; ++l) out[l] = _mm_aesenclast_si128(temp[l], roundKeys[l][AES::Rounds]);
+        }
+    }
+
+#ifdef OC_HAVE_VAES
+// GCC 12 implements _mm512_broadcast_i32x4, _mm512_shuffle_epi32 and
+// _mm512_extracti32x4_epi32 with an _mm*_undefined_* pass-through operand
+// (x = x in avx512fintrin.h), which -Wuninitialized reports once inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    namespace
+    {
+        // The wide kernels below keep 8 independent vector registers in
+        // flight so that the pipelined aesenc units stay busy. They
+        // return how many of the blocks they processed; the caller
+        // finishes the remainder with the 128 bit code.
+
+        // The ECB kernels also implement the fused hashes.
+        template<int Rounds, EcbMode Mode>
+        OC_TARGET("avx512f,vaes")
+        u64 ecbEncBlocksVaes512(const block* roundKey, const block* plaintexts, u64 blockLength, block* ciphertext)
+        {
+            const u64 step = 32;
+            u64 length = blockLength - blockLength % step;
+
+            __m512i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm512_broadcast_i32x4(roundKey[j]);
+
+            const __m512i highMask = _mm512_set_epi64(-1, 0, -1, 0, -1, 0, -1, 0);
+            __m512i in[8], temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    in[i] = _mm512_loadu_si512(plaintexts + idx + 4 * i);
+                    if (Mode == EcbMode::Ccr)
+                        in[i] = _mm512_xor_si512(_mm512_shuffle_epi32(in[i], (_MM_PERM_ENUM)_MM_SHUFFLE(1, 0, 3, 2)), _mm512_and_si512(in[i], highMask));
+                    temp[i] = _mm512_xor_si512(in[i], rk[0]);
+                }
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm512_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm512_aesenclast_epi128(temp[i], rk[Rounds]);
+                    if (Mode != EcbMode::Plain)
+                        temp[i] = _mm512_xor_si512(temp[i], in[i]);
+                    _mm512_storeu_si512(ciphertext + idx + 4 * i, temp[i]);
+                }
+            }
+            return length;
+        }
+
+        template<int Rounds, EcbMode Mode>
+        OC_TARGET("avx2,vaes")
+        u64 ecbEncBlocksVaes256(const block* roundKey, const block* plaintexts, u64 blockLength, block* ciphertext)
+        {
+            const u64 step = 16;
+            u64 length = blockLength - blockLength % step;
+
+            __m256i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm256_broadcastsi128_si256(roundKey[j]);
+
+            const __m256i highMask = _mm256_set_epi64x(-1, 0, -1, 0);
+            __m256i in[8], temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    in[i] = _mm256_loadu_si256((const __m256i*)(plaintexts + idx + 2 * i));
+                    if (Mode == EcbMode::Ccr)
+                        in[i] = _mm256_xor_si256(_mm256_shuffle_epi32(in[i], _MM_SHUFFLE(1, 0, 3, 2)), _mm256_and_si256(in[i], highMask));
+                    temp[i] = _mm256_xor_si256(in[i], rk[0]);
+                }
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm256_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm256_aesenclast_epi128(temp[i], rk[Rounds]);
+                    if (Mode != EcbMode::Plain)
+                        temp[i] = _mm256_xor_si256(temp[i], in[i]);
+                    _mm256_storeu_si256((__m256i*)(ciphertext + idx + 2 * i), temp[i]);
+                }
+            }
+            return length;
+        }
+
+        // H(x, tweak) = AES(AES(x) ^ tweak) ^ AES(x). The first pass is kept
+        // in registers for the feed-forward of the second.
+        template<int Rounds>
+        OC_TARGET("avx512f,vaes")
+        u64 tccrHashVaes512(const block* roundKey, const block* x, const block* tweaks, u64 blockLength, block* out)
+        {
+            const u64 step = 32;
+            u64 length = blockLength - blockLength % step;
+
+            __m512i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm512_broadcast_i32x4(roundKey[j]);
+
+            __m512i t[8], temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                for (u64 i = 0; i < 8; ++i)
+                    t[i] = _mm512_xor_si512(_mm512_loadu_si512(x + idx + 4 * i), rk[0]);
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        t[i] = _mm512_aesenc_epi128(t[i], rk[j]);
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    t[i] = _mm512_aesenclast_epi128(t[i], rk[Rounds]);
+                    temp[i] = _mm512_xor_si512(_mm512_xor_si512(t[i], _mm512_loadu_si512(tweaks + idx + 4 * i)), rk[0]);
+                }
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm512_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                    _mm512_storeu_si512(out + idx + 4 * i, _mm512_xor_si512(_mm512_aesenclast_epi128(temp[i], rk[Rounds]), t[i]));
+            }
+            return length;
+        }
+
+        template<int Rounds>
+        OC_TARGET("avx2,vaes")
+        u64 tccrHashVaes256(const block* roundKey, const block* x, const block* tweaks, u64 blockLength, block* out)
+        {
+            const u64 step = 16;
+            u64 length = blockLength - blockLength % step;
+
+            __m256i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm256_broadcastsi128_si256(roundKey[j]);
+
+            __m256i t[8], temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                for (u64 i = 0; i < 8; ++i)
+                    t[i] = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(x + idx + 2 * i)), rk[0]);
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        t[i] = _mm256_aesenc_epi128(t[i], rk[j]);
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    t[i] = _mm256_aesenclast_epi128(t[i], rk[Rounds]);
+                    temp[i] = _mm256_xor_si256(_mm256_xor_si256(t[i], _mm256_loadu_si256((const __m256i*)(tweaks + idx + 2 * i))), rk[0]);
+                }
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm256_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                    _mm256_storeu_si256((__m256i*)(out + idx + 2 * i), _mm256_xor_si256(_mm256_aesenclast_epi128(temp[i], rk[Rounds]), t[i]));
+            }
+            return length;
+        }
+
+        // The counter block for index i is _mm_set1_epi64x(i), the same as
+        // the 128 bit code uses. With Xor the keystream is xored into the
+        // (possibly unaligned) output instead of overwriting it.
+        template<int Rounds, bool Xor = false>
+        OC_TARGET("avx512f,vaes")
+        u64 ecbEncCounterModeVaes512(const block* roundKey, u64 baseIdx, u64 blockLength, block* ciphertext)
+        {
+            const u64 step = 32;
+            u64 length = blockLength - blockLength % step;
+
+            __m512i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm512_broadcast_i32x4(roundKey[j]);
+
+            const __m512i four = _mm512_set1_epi64(4);
+            const __m512i thirtyTwo = _mm512_set1_epi64(32);
+            __m512i ctr = _mm512_add_epi64(_mm512_set1_epi64(baseIdx), _mm512_set_epi64(3, 3, 2, 2, 1, 1, 0, 0));
+
+            __m512i temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                __m512i c = ctr;
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm512_xor_si512(c, rk[0]);
+                    c = _mm512_add_epi64(c, four);
+                }
+                ctr = _mm512_add_epi64(ctr, thirtyTwo);
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm512_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm512_aesenclast_epi128(temp[i], rk[Rounds]);
+                    if (Xor)
+                        temp[i] = _mm512_xor_si512(temp[i], _mm512_loadu_si512(ciphertext + idx + 4 * i));
+                    _mm512_storeu_si512(ciphertext + idx + 4 * i, temp[i]);
+                }
+            }
+            return length;
+        }
+
+        template<int Rounds, bool Xor = false>
+        OC_TARGET("avx2,vaes")
+        u64 ecbEncCounterModeVaes256(const block* roundKey, u64 baseIdx, u64 blockLength, block* ciphertext)
+        {
+            const u64 step = 16;
+            u64 length = blockLength - blockLength % step;
+
+            __m256i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm256_broadcastsi128_si256(roundKey[j]);
+
+            const __m256i two = _mm256_set1_epi64x(2);
+            const __m256i sixteen = _mm256_set1_epi64x(16);
+            __m256i ctr = _mm256_add_epi64(_mm256_set1_epi64x(baseIdx), _mm256_set_epi64x(1, 1, 0, 0));
+
+            __m256i temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                __m256i c = ctr;
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm256_xor_si256(c, rk[0]);
+                    c = _mm256_add_epi64(c, two);
+                }
+                ctr = _mm256_add_epi64(ctr, sixteen);
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm256_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm256_aesenclast_epi128(temp[i], rk[Rounds]);
+                    if (Xor)
+                        temp[i] = _mm256_xor_si256(temp[i], _mm256_loadu_si256((const __m256i*)(ciphertext + idx + 2 * i)));
+                    _mm256_storeu_si256((__m256i*)(ciphertext + idx + 2 * i), temp[i]);
+                }
+            }
+            return length;
+        }
+
+        // Scattered counter mode: the encryption of baseIdx + i is written to
+        // ciphertext[destIdxs[i]]. The next iteration's destinations are prefetched.
+        template<int Rounds>
+        OC_TARGET("avx512f,vaes")
+        u64 ecbEncCounterModeScatterVaes512(const block* roundKey, u64 baseIdx, u64 blockLength, block* ciphertext, const u64* destIdxs)
+        {
+            const u64 step = 32;
+            u64 length = blockLength - blockLength % step;
+
+            __m512i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm512_broadcast_i32x4(roundKey[j]);
+
+            const __m512i four = _mm512_set1_epi64(4);
+            const __m512i thirtyTwo = _mm512_set1_epi64(32);
+            __m512i ctr = _mm512_add_epi64(_mm512_set1_epi64(baseIdx), _mm512_set_epi64(3, 3, 2, 2, 1, 1, 0, 0));
+
+            __m512i temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                if (idx + 2 * step <= blockLength)
+                    for (u64 i = 0; i < step; ++i)
+                        _mm_prefetch((const char*)(ciphertext + destIdxs[idx + step + i]), _MM_HINT_T0);
+
+                __m512i c = ctr;
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm512_xor_si512(c, rk[0]);
+                    c = _mm512_add_epi64(c, four);
+                }
+                ctr = _mm512_add_epi64(ctr, thirtyTwo);
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm512_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm512_aesenclast_epi128(temp[i], rk[Rounds]);
+                    const u64* d = destIdxs + idx + 4 * i;
+                    _mm_storeu_si128(ciphertext + d[0], _mm512_castsi512_si128(temp[i]));
+                    _mm_storeu_si128(ciphertext + d[1], _mm512_extracti32x4_epi32(temp[i], 1));
+                    _mm_storeu_si128(ciphertext + d[2], _mm512_extracti32x4_epi32(temp[i], 2));
+                    _mm_storeu_si128(ciphertext + d[3], _mm512_extracti32x4_epi32(temp[i], 3));
+                }
+            }
+            return length;
+        }
+
+        template<int Rounds>
+        OC_TARGET("avx2,vaes")
+        u64 ecbEncCounterModeScatterVaes256(const block* roundKey, u64 baseIdx, u64 blockLength, block* ciphertext, const u64* destIdxs)
+        {
+            const u64 step = 16;
+            u64 length = blockLength - blockLength % step;
+
+            __m256i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm256_broadcastsi128_si256(roundKey[j]);
+
+            const __m256i two = _mm256_set1_epi64x(2);
+            const __m256i sixteen = _mm256_set1_epi64x(16);
+            __m256i ctr = _mm256_add_epi64(_mm256_set1_epi64x(baseIdx), _mm256_set_epi64x(1, 1, 0, 0));
+
+            __m256i temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                if (idx + 2 * step <= blockLength)
+                    for (u64 i = 0; i < step; ++i)
+                        _mm_prefetch((const char*)(ciphertext + destIdxs[idx + step + i]), _MM_HINT_T0);
+
+                __m256i c = ctr;
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm256_xor_si256(c, rk[0]);
+                    c = _mm256_add_epi64(c, two);
+                }
+                ctr = _mm256_add_epi64(ctr, sixteen);
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm256_aesenc_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                {
+                    temp[i] = _mm256_aesenclast_epi128(temp[i], rk[Rounds]);
+                    const u64* d = destIdxs + idx + 2 * i;
+                    _mm_storeu_si128(ciphertext + d[0], _mm256_castsi256_si128(temp[i]));
+                    _mm_storeu_si128(ciphertext + d[1], _mm256_extracti128_si256(temp[i], 1));
+                }
+            }
+            return length;
+        }
+
+        template<int Rounds>
+        OC_TARGET("avx512f,vaes")
+        u64 ecbDecBlocksVaes512(const block* roundKey, const block* ciphertexts, u64 blockLength, block* plaintext)
+        {
+            const u64 step = 32;
+            u64 length = blockLength - blockLength % step;
+
+            __m512i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm512_broadcast_i32x4(roundKey[j]);
+
+            __m512i temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                for (u64 i = 0; i < 8; ++i)
+                    temp[i] = _mm512_xor_si512(_mm512_loadu_si512(ciphertexts + idx + 4 * i), rk[0]);
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm512_aesdec_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                    _mm512_storeu_si512(plaintext + idx + 4 * i, _mm512_aesdeclast_epi128(temp[i], rk[Rounds]));
+            }
+            return length;
+        }
+
+        template<int Rounds>
+        OC_TARGET("avx2,vaes")
+        u64 ecbDecBlocksVaes256(const block* roundKey, const block* ciphertexts, u64 blockLength, block* plaintext)
+        {
+            const u64 step = 16;
+            u64 length = blockLength - blockLength % step;
+
+            __m256i rk[Rounds + 1];
+            for (u64 j = 0; j <= Rounds; ++j)
+                rk[j] = _mm256_broadcastsi128_si256(roundKey[j]);
+
+            __m256i temp[8];
+            for (u64 idx = 0; idx < length; idx += step)
+            {
+                for (u64 i = 0; i < 8; ++i)
+                    temp[i] = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(ciphertexts + idx + 2 * i)), rk[0]);
+
+                for (u64 j = 1; j < Rounds; ++j)
+                    for (u64 i = 0; i < 8; ++i)
+                        temp[i] = _mm256_aesdec_epi128(temp[i], rk[j]);
+
+                for (u64 i = 0; i < 8; ++i)
+                    _mm256_storeu_si256((__m256i*)(plaintext + idx + 2 * i), _mm256_aesdeclast_epi128(temp[i], rk[Rounds]));
+            }
+            return length;
+        }
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+    namespace
+    {
+        // The AES-NI drivers use the VAES kernels for the bulk of the blocks
+        // if the CPU has them, then 8 blocks at a time and finally single blocks.
+
+        template<int Rounds, EcbMode Mode>
+        OC_TARGET("aes")
+        void ecbEncBlocksAesNi(const block* roundKey, const block* x, u64 blockLength, block* out)
+        {
+            const u64 step = 8;
+            u64 idx = 0;
+
+#ifdef OC_HAVE_VAES
+            auto& cpu = cpuFeatures();
+            if (cpu.mVAES && cpu.mAVX512F)
+                idx += ecbEncBlocksVaes512<Rounds, Mode>(roundKey, x, blockLength, out);
+            if (cpu.mVAES && cpu.mAVX2)
+                idx += ecbEncBlocksVaes256<Rounds, Mode>(roundKey, x + idx, blockLength - idx, out + idx);
+#endif
+
+            u64 length = idx + (blockLength - idx) / step * step;
+            for (; idx < length; idx += step)
+                ecbEncNBlocksMode<Rounds, Mode, step>(roundKey, x + idx, out + idx);
+
+            for (; idx < blockLength; ++idx)
+                ecbEncNBlocksMode<Rounds, Mode, 1>(roundKey, x + idx, out + idx);
+        }
+
+        template<int Rounds>
+        OC_TARGET("aes")
+        void ecbEncCounterModeAesNi(const block* roundKey, u64 baseIdx, u64 blockLength, block* ciphertext)
+        {
+            const u64 step = 8;
+            u64 idx = 0;
+
+#ifdef OC_HAVE_VAES
+            auto& cpu = cpuFeatures();
+            if (cpu.mVAES && cpu.mAVX512F)
+                idx += ecbEncCounterModeVaes512<Rounds>(roundKey, baseIdx, blockLength, ciphertext);
+            if (cpu.mVAES && cpu.mAVX2)
+                idx += ecbEncCounterModeVaes256<Rounds>(roundKey, baseIdx + idx, blockLength - idx, ciphertext + idx);
+            baseIdx += idx;
+#endif
+
+            u64 length = idx + (blockLength - idx) / step * step;
+            for (; idx < length; idx += step, baseIdx += step)
+                ecbEncNCounters<Rounds, step>(roundKey, baseIdx, ciphertext + idx);
+
+            for (; idx < blockLength; ++idx, ++baseIdx)
+                ecbEncNCounters<Rounds, 1>(roundKey, baseIdx, ciphertext + idx);
+        }
+
+        template<int Rounds, bool Xor>
+        OC_TARGET("aes")
+        void ecbEncCounterModeUnalignedAesNi(const block* roundKey, u64 baseIdx, u64 blockLength, u8* data)
+        {
+            const u64 step = 8;
+            u64 idx = 0;
+
+#ifdef OC_HAVE_VAES
+            auto& cpu = cpuFeatures();
+            if (cpu.mVAES && cpu.mAVX512F)
+                idx += ecbEncCounterModeVaes512<Rounds, Xor>(roundKey, baseIdx, blockLength, (block*)data);
+            if (cpu.mVAES && cpu.mAVX2)
+                idx += ecbEncCounterModeVaes256<Rounds, Xor>(roundKey, baseIdx + idx, blockLength - idx, (block*)(data + 16 * idx));
+            baseIdx += idx;
+#endif
+
+            u64 length = idx + (blockLength - idx) / step * step;
+            for (; idx < length; idx += step, baseIdx += step)
+                ecbEncNCountersUnaligned<Rounds, step, Xor>(roundKey, baseIdx, data + 16 * idx);
+
+            for (; idx < blockLength; ++idx, ++baseIdx)
+                ecbEncNCountersUnaligned<Rounds, 1, Xor>(roundKey, baseIdx, data + 16 * idx);
+        }
+
+        template<int Rounds>
+        OC_TARGET("aes")
+        void ecbEncCounterModeAesNi(const block* roundKey, u64 baseIdx, u64 blockLength, block* ciphertext, const u64* destIdxs)
+        {
+            const u64 step = 8;
+            u64 idx = 0;
+
+#ifdef OC_HAVE_VAES
+            auto& cpu = cpuFeatures();
+            if (cpu.mVAES && cpu.mAVX512F)
+                idx += ecbEncCounterModeScatterVaes512<Rounds>(roundKey, baseIdx, blockLength, ciphertext, destIdxs);
+            if (cpu.mVAES && cpu.mAVX2)
+                idx += ecbEncCounterModeScatterVaes256<Rounds>(roundKey, baseIdx + idx, blockLength - idx, ciphertext, destIdxs + idx);
+            baseIdx += idx;
+#endif
+
+            // The destinations are typically random, so the ones two batches
+            // ahead are prefetched to overlap the cache misses with the encryption.
+            const u64 distance = 2 * step;
+            block temp[step];
+
+            u64 length = idx + (blockLength - idx) / step * step;
+            for (; idx < length; idx += step, baseIdx += step)
+            {
+                if (idx + distance + step <= blockLength)
+                    for (u64 i = 0; i < step; ++i)
+                        _mm_prefetch((const char*)(ciphertext + destIdxs[idx + distance + i]), _MM_HINT_T0);
+
+                ecbEncNCounters<Rounds, step>(roundKey, baseIdx, temp);
+                for (u64 i = 0; i < step; ++i)
+                    ciphertext[destIdxs[idx + i]] = temp[i];
+            }
+
+            for (; idx < blockLength; ++idx, ++baseIdx)
+                ecbEncNCounters<Rounds, 1>(roundKey, baseIdx, ciphertext + destIdxs[idx]);
+        }
+
+        template<int Rounds>
+        OC_TARGET("aes")
+        void tccrHashBlocksAesNi(const block* roundKey, const block* x, const block* tweaks, u64 blockLength, block* out)
+        {
+            const u64 step = 8;
+            u64 idx = 0;
+
+#ifdef OC_HAVE_VAES
+            auto& cpu = cpuFeatures();
+            if (cpu.mVAES && cpu.mAVX512F)
+                idx += tccrHashVaes512<Rounds>(roundKey, x, tweaks, blockLength, out);
+            if (cpu.mVAES && cpu.mAVX2)
+                idx += tccrHashVaes256<Rounds>(roundKey, x + idx, tweaks + idx, blockLength - idx, out + idx);
+#endif
+
+            u64 length = idx + (blockLength - idx) / step * step;
+            for (; idx < length; idx += step)
+                tccrHashNBlocks<Rounds, step>(roundKey, x + idx, tweaks + idx, out + idx);
+
+            for (; idx < blockLength; ++idx)
+                tccrHashNBlocks<Rounds, 1>(roundKey, x + idx, tweaks + idx, out + idx);
+        }
+
+        template<int Rounds>
+        OC_TARGET("aes")
+        void tccrHashBlocksAesNi(const block* roundKey, const block* x, u64 tweakIdx, u64 blockLength, block* out)
+        {
+            const u64 step = 8;
+            u64 idx = 0;
+            block tweaks[128];
+
+#ifdef OC_HAVE_VAES
+            // The wide kernels read the tweaks from memory, so they are
+            // generated a chunk at a time.
+            auto& cpu = cpuFeatures();
+            if (cpu.mVAES && cpu.mAVX2)
+            {
+                u64 length = blockLength - blockLength % 16;
+                while (idx < length)
+                {
+                    u64 min = std::min<u64>(128, length - idx);
+                    for (u64 i = 0; i < min; ++i)
+                        tweaks[i] = toBlock(tweakIdx + idx + i);
+
+                    u64 done = 0;
+                    if (cpu.mAVX512F)
+                        done += tccrHashVaes512<Rounds>(roundKey, x + idx, tweaks, min, out + idx);
+                    done += tccrHashVaes256<Rounds>(roundKey, x + idx + done, tweaks + done, min - done, out + idx + done);
+                    idx += done;
+                }
+            }
+#endif
+
+            u64 length = idx + (blockLength - idx) / step * step;
+            for (; idx < length; idx += step)
+            {
+                for (u64 i = 0; i < step; ++i)
+                    tweaks[i] = toBlock(tweakIdx + idx + i);
+                tccrHashNBlocks<Rounds, step>(roundKey, x + idx, tweaks, out + idx);
+            }
+
+            for (; idx < blockLength; ++idx)
+            {
+                tweaks[0] = toBlock(tweakIdx + idx);
+                tccrHashNBlocks<Rounds, 1>(roundKey, x + idx, tweaks, out + idx);
+            }
+        }
+
+        template<int Rounds>
+        OC_TARGET("aes")
+        void ecbDecBlocksAesNi(const block* roundKey, const block* ciphertexts, u64 blockLength, block* plaintext)
+        {
+            const u64 step = 8;
+            u64 idx = 0;
+
+#ifdef OC_HAVE_VAES
+            auto& cpu = cpuFeatures();
+            if (cpu.mVAES && cpu.mAVX512F)
+                idx += ecbDecBlocksVaes512<Rounds>(roundKey, ciphertexts, blockLength, plaintext);
+            if (cpu.mVAES && cpu.mAVX2)
+                idx += ecbDecBlocksVaes256<Rounds>(roundKey, ciphertexts + idx, blockLength - idx, plaintext + idx);
+#endif
+
+            u64 length = idx + (blockLength - idx) / step * step;
+            for (; idx < length; idx += step)
+                ecbDecNBlocks<Rounds, step>(roundKey, ciphertexts + idx, plaintext + idx);
+
+            for (; idx < blockLength; ++idx)
+                ecbDecNBlocks<Rounds, 1>(roundKey, ciphertexts + idx, plaintext + idx);
+        }
+
+        OC_TARGET("aes")
+        block aesImc(block x)
+        {
+            return _mm_aesimc_si128(x);
+        }
+
+        // The cached schedule if it was built from roundKey, and otherwise
+        // one built into tmp, whose default lives until the end of the
+        // caller's full expression.
+        const BitslicedAES& bitslicedKey(
+            const std::shared_ptr<const BitslicedKeySchedule>& cache,
+            const block* roundKey, int rounds, BitslicedAES&& tmp = BitslicedAES())
+        {
+            if (cache && cache->matches(roundKey, rounds))
+                return cache->mAes;
+
+            tmp.setRoundKeys(roundKey, rounds);
+            return tmp;
+        }
+
+        // The software drivers run the bitsliced cipher on 8 blocks at a
+        // time. load(idx, n, in) writes the inputs of blocks idx, ...,
+        // idx + n - 1 to in and store(idx, n, in, out) consumes the outputs.
+        // The unused lanes of the last batch are encrypted as well.
+        template<typename Load, typename Store>
+        void bitslicedEncBlocks(const BitslicedAES& aes, u64 blockLength, Load&& load, Store&& store)
+        {
+            const u64 step = 8;
+            block in[step], out[step];
+            for (u64 i = 0; i < step; ++i)
+                in[i] = ZeroBlock;
+
+            for (u64 idx = 0; idx < blockLength; idx += step)
+            {
+                u64 n = std::min<u64>(step, blockLength - idx);
+                load(idx, n, in);
+                aes.ecbEnc8Blocks(in, out);
+                store(idx, n, in, out);
+            }
+        }
+
+        template<EcbMode Mode>
+        void ecbEncBlocksBitsliced(const BitslicedAES& aes, const block* x, u64 blockLength, block* out)
+        {
+            bitslicedEncBlocks(aes, blockLength,
+                [&](u64 idx, u64 n, block* in) {
+                    for (u64 i = 0; i < n; ++i)
+                        in[i] = Mode == EcbMode::Ccr ? sigma(x[idx + i]) : x[idx + i];
+                },
+                [&](u64 idx, u64 n, const block* in, const block* c) {
+                    for (u64 i = 0; i < n; ++i)
+                        out[idx + i] = Mode == EcbMode::Plain ? c[i] : _mm_xor_si128(c[i], in[i]);
+                });
+        }
+
+        // store(idx, n, c) consumes the encryptions of baseIdx + idx, ..., baseIdx + idx + n - 1.
+        template<typename Store>
+        void ecbEncCounterModeBitsliced(const BitslicedAES& aes, u64 baseIdx, u64 blockLength, Store&& store)
+        {
+            bitslicedEncBlocks(aes, blockLength,
+                [&](u64 idx, u64 n, block* in) {
+                    for (u64 i = 0; i < n; ++i)
+                        in[i] = _mm_set1_epi64x(baseIdx + idx + i);
+                },
+                [&](u64 idx, u64 n, const block*, const block* c) { store(idx, n, c); });
+        }
+
+        // tweak(i) returns the tweak of block i.
+        template<typename Tweak>
+        void tccrHashBlocksBitsliced(const BitslicedAES& aes, const block* x, Tweak&& tweak, u64 blockLength, block* out)
+        {
+            block u[8] = {};
+            bitslicedEncBlocks(aes, blockLength,
+                [&](u64 idx, u64 n, block* in) {
+                    for (u64 i = 0; i < n; ++i)
+                        in[i] = x[idx + i];
+                },
+                [&](u64 idx, u64 n, const block*, const block* t) {
+                    for (u64 i = 0; i < n; ++i)
+                        u[i] = _mm_xor_si128(t[i], tweak(idx + i));
+                    aes.ecbEnc8Blocks(u, u);
+                    for (u64 i = 0; i < n; ++i)
+                        out[idx + i] = _mm_xor_si128(u[i], t[i]);
+                });
+        }
+
+        void ecbDecBlocksBitsliced(const BitslicedAES& aes, const block* ciphertexts, u64 blockLength, block* plaintext)
+        {
+            const u64 step = 8;
+            block temp[step];
+
+            u64 length = blockLength - blockLength % step;
+            for (u64 idx = 0; idx < length; idx += step)
+                aes.ecbDec8Blocks(ciphertexts + idx, plaintext + idx);
+
+            if (length < blockLength)
+            {
+                u64 n = blockLength - length;
+                std::copy(ciphertexts + length, ciphertexts + blockLength, temp);
+                std::fill(temp + n, temp + step, ZeroBlock);
+                aes.ecbDec8Blocks(temp, temp);
+                std::copy(temp, temp + n, plaintext + length);
+            }
+        }
+
+        // The schedule of the group of 8 keys that starts at key i, if any.
+        const BitslicedLaneSchedule* laneGroup(const BitslicedLaneSchedules* lanes, u64 i)
+        {
+            return lanes && i / 8 < lanes->mGroups.size() ? &lanes->mGroups[i / 8] : nullptr;
+        }
+
+        // Encrypts in[l] under roundKeys[l] for each of the 8 lanes. Without
+        // AES-NI the schedule group is used if it was built from roundKeys.
+        void ecbEnc8Lanes(const block* const* roundKeys, const BitslicedLaneSchedule* group,
+            const block* in, block* out)
+        {
+            if (cpuFeatures().mAES)
+                ecbEncNLanes<8>(roundKeys, in, out);
+            else if (group && group->matches(roundKeys))
+                group->mAes.ecbEnc8Blocks(in, out);
+            else
+            {
+                BitslicedAES aes;
+                aes.setRoundKeys(roundKeys, AES::Rounds);
+                aes.ecbEnc8Blocks(in, out);
+            }
+        }
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::setKey(const Key & userKey)
     {
-        setKey(userKey);
+        if (cpuFeatures().mAES)
+        {
+            expandKey(userKey, mRoundKey);
+            mBitsliced.reset();
+        }
+        else
+        {
+            BitslicedAES::expandKey((const u8*)&userKey, KeyBits / 32, Rounds, mRoundKey);
+            mBitsliced = std::make_shared<BitslicedKeySchedule>(mRoundKey, Rounds);
+        }
     }
 
-    void AES::setKey(const block & userKey)
+    template<int KeyBits>
+    void AESBase<KeyBits>::xorFirstRoundKey(const block& mask)
     {
-        mRoundKey[0] = userKey;
-        mRoundKey[1] = keyGenHelper(mRoundKey[0], _mm_aeskeygenassist_si128(mRoundKey[0], 0x01));
-        mRoundKey[2] = keyGenHelper(mRoundKey[1], _mm_aeskeygenassist_si128(mRoundKey[1], 0x02));
-        mRoundKey[3] = keyGenHelper(mRoundKey[2], _mm_aeskeygenassist_si128(mRoundKey[2], 0x04));
-        mRoundKey[4] = keyGenHelper(mRoundKey[3], _mm_aeskeygenassist_si128(mRoundKey[3], 0x08));
-        mRoundKey[5] = keyGenHelper(mRoundKey[4], _mm_aeskeygenassist_si128(mRoundKey[4], 0x10));
-        mRoundKey[6] = keyGenHelper(mRoundKey[5], _mm_aeskeygenassist_si128(mRoundKey[5], 0x20));
-        mRoundKey[7] = keyGenHelper(mRoundKey[6], _mm_aeskeygenassist_si128(mRoundKey[6], 0x40));
-        mRoundKey[8] = keyGenHelper(mRoundKey[7], _mm_aeskeygenassist_si128(mRoundKey[7], 0x80));
-        mRoundKey[9] = keyGenHelper(mRoundKey[8], _mm_aeskeygenassist_si128(mRoundKey[8], 0x1B));
-        mRoundKey[10] = keyGenHelper(mRoundKey[9], _mm_aeskeygenassist_si128(mRoundKey[9], 0x36));
+        mRoundKey[0] = mRoundKey[0] ^ mask;
+        if (mBitsliced)
+            mBitsliced = std::make_shared<BitslicedKeySchedule>(mRoundKey, Rounds);
     }
 
-    void  AES::ecbEncBlock(const block & plaintext, block & cyphertext) const
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncBlock(const block & plaintext, block & cyphertext) const
     {
-        cyphertext = _mm_xor_si128(plaintext, mRoundKey[0]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[1]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[2]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[3]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[4]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[5]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[6]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[7]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[8]);
-        cyphertext = _mm_aesenc_si128(cyphertext, mRoundKey[9]);
-        cyphertext = _mm_aesenclast_si128(cyphertext, mRoundKey[10]);
+        if (cpuFeatures().mAES)
+            ecbEncNBlocks<Rounds, 1>(mRoundKey, &plaintext, &cyphertext);
+        else
+            ecbEncBlocksBitsliced<EcbMode::Plain>(bitslicedKey(mBitsliced, mRoundKey, Rounds), &plaintext, 1, &cyphertext);
     }
 
-    block AES::ecbEncBlock(const block & plaintext) const
+    template<int KeyBits>
+    block AESBase<KeyBits>::ecbEncBlock(const block & plaintext) const
     {
         block ret;
         ecbEncBlock(plaintext, ret);
         return ret;
     }
 
-    void AES::ecbEncBlocks(const block * plaintexts, u64 blockLength, block * cyphertext) const
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncBlocks(const block * plaintexts, u64 blockLength, block * cyphertext) const
     {
-        const u64 step = 8;
-        u64 idx = 0;
-        u64 length = blockLength - blockLength % step;
-
-        //std::array<block, step> temp;
-		block temp[step];
-
-        for (; idx < length; idx += step)
-        {
-            temp[0] = _mm_xor_si128(plaintexts[idx + 0], mRoundKey[0]);
-            temp[1] = _mm_xor_si128(plaintexts[idx + 1], mRoundKey[0]);
-            temp[2] = _mm_xor_si128(plaintexts[idx + 2], mRoundKey[0]);
-            temp[3] = _mm_xor_si128(plaintexts[idx + 3], mRoundKey[0]);
-            temp[4] = _mm_xor_si128(plaintexts[idx + 4], mRoundKey[0]);
-            temp[5] = _mm_xor_si128(plaintexts[idx + 5], mRoundKey[0]);
-            temp[6] = _mm_xor_si128(plaintexts[idx + 6], mRoundKey[0]);
-            temp[7] = _mm_xor_si128(plaintexts[idx + 7], mRoundKey[0]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[1]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[1]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[1]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[1]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[1]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[1]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[1]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[1]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[2]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[2]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[2]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[2]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[2]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[2]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[2]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[2]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[3]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[3]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[3]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[3]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[3]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[3]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[3]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[3]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[4]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[4]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[4]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[4]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[4]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[4]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[4]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[4]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[5]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[5]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[5]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[5]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[5]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[5]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[5]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[5]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[6]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[6]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[6]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[6]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[6]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[6]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[6]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[6]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[7]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[7]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[7]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[7]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[7]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[7]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[7]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[7]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[8]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[8]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[8]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[8]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[8]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[8]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[8]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[8]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[9]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[9]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[9]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[9]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[9]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[9]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[9]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[9]);
-
-            cyphertext[idx + 0] = _mm_aesenclast_si128(temp[0], mRoundKey[10]);
-            cyphertext[idx + 1] = _mm_aesenclast_si128(temp[1], mRoundKey[10]);
-            cyphertext[idx + 2] = _mm_aesenclast_si128(temp[2], mRoundKey[10]);
-            cyphertext[idx + 3] = _mm_aesenclast_si128(temp[3], mRoundKey[10]);
-            cyphertext[idx + 4] = _mm_aesenclast_si128(temp[4], mRoundKey[10]);
-            cyphertext[idx + 5] = _mm_aesenclast_si128(temp[5], mRoundKey[10]);
-            cyphertext[idx + 6] = _mm_aesenclast_si128(temp[6], mRoundKey[10]);
-            cyphertext[idx + 7] = _mm_aesenclast_si128(temp[7], mRoundKey[10]);
-        }
-
-        for (; idx < blockLength; ++idx)
-        {
-            cyphertext[idx] = _mm_xor_si128(plaintexts[idx], mRoundKey[0]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[1]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[2]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[3]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[4]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[5]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[6]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[7]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[8]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[9]);
-            cyphertext[idx] = _mm_aesenclast_si128(cyphertext[idx], mRoundKey[10]);
-        }
-    }
-
-
-    void AES::ecbEncTwoBlocks(const block * plaintexts, block * cyphertext) const
-    {
-        cyphertext[0] = _mm_xor_si128(plaintexts[0], mRoundKey[0]);
-        cyphertext[1] = _mm_xor_si128(plaintexts[1], mRoundKey[0]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[1]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[1]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[2]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[2]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[3]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[3]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[4]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[4]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[5]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[5]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[6]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[6]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[7]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[7]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[8]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[8]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[9]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[9]);
-
-        cyphertext[0] = _mm_aesenclast_si128(cyphertext[0], mRoundKey[10]);
-        cyphertext[1] = _mm_aesenclast_si128(cyphertext[1], mRoundKey[10]);
-    }
-
-    void AES::ecbEncFourBlocks(const block * plaintexts, block * cyphertext) const
-    {
-        cyphertext[0] = _mm_xor_si128(plaintexts[0], mRoundKey[0]);
-        cyphertext[1] = _mm_xor_si128(plaintexts[1], mRoundKey[0]);
-        cyphertext[2] = _mm_xor_si128(plaintexts[2], mRoundKey[0]);
-        cyphertext[3] = _mm_xor_si128(plaintexts[3], mRoundKey[0]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[1]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[1]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[1]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[1]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[2]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[2]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[2]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[2]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[3]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[3]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[3]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[3]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[4]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[4]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[4]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[4]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[5]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[5]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[5]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[5]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[6]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[6]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[6]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[6]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[7]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[7]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[7]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[7]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[8]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[8]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[8]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[8]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[9]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[9]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[9]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[9]);
-
-        cyphertext[0] = _mm_aesenclast_si128(cyphertext[0], mRoundKey[10]);
-        cyphertext[1] = _mm_aesenclast_si128(cyphertext[1], mRoundKey[10]);
-        cyphertext[2] = _mm_aesenclast_si128(cyphertext[2], mRoundKey[10]);
-        cyphertext[3] = _mm_aesenclast_si128(cyphertext[3], mRoundKey[10]);
-    }
-
-    void AES::ecbEnc16Blocks(const block * plaintexts, block * cyphertext) const
-    {
-        cyphertext[0] = _mm_xor_si128(plaintexts[0], mRoundKey[0]);
-        cyphertext[1] = _mm_xor_si128(plaintexts[1], mRoundKey[0]);
-        cyphertext[2] = _mm_xor_si128(plaintexts[2], mRoundKey[0]);
-        cyphertext[3] = _mm_xor_si128(plaintexts[3], mRoundKey[0]);
-        cyphertext[4] = _mm_xor_si128(plaintexts[4], mRoundKey[0]);
-        cyphertext[5] = _mm_xor_si128(plaintexts[5], mRoundKey[0]);
-        cyphertext[6] = _mm_xor_si128(plaintexts[6], mRoundKey[0]);
-        cyphertext[7] = _mm_xor_si128(plaintexts[7], mRoundKey[0]);
-        cyphertext[8] = _mm_xor_si128(plaintexts[8], mRoundKey[0]);
-        cyphertext[9] = _mm_xor_si128(plaintexts[9], mRoundKey[0]);
-        cyphertext[10] = _mm_xor_si128(plaintexts[10], mRoundKey[0]);
-        cyphertext[11] = _mm_xor_si128(plaintexts[11], mRoundKey[0]);
-        cyphertext[12] = _mm_xor_si128(plaintexts[12], mRoundKey[0]);
-        cyphertext[13] = _mm_xor_si128(plaintexts[13], mRoundKey[0]);
-        cyphertext[14] = _mm_xor_si128(plaintexts[14], mRoundKey[0]);
-        cyphertext[15] = _mm_xor_si128(plaintexts[15], mRoundKey[0]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[1]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[1]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[1]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[1]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[1]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[1]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[1]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[1]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[1]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[1]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[1]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[1]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[1]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[1]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[1]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[1]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[2]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[2]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[2]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[2]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[2]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[2]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[2]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[2]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[2]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[2]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[2]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[2]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[2]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[2]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[2]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[2]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[3]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[3]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[3]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[3]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[3]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[3]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[3]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[3]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[3]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[3]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[3]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[3]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[3]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[3]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[3]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[3]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[4]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[4]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[4]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[4]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[4]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[4]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[4]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[4]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[4]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[4]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[4]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[4]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[4]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[4]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[4]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[4]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[5]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[5]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[5]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[5]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[5]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[5]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[5]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[5]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[5]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[5]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[5]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[5]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[5]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[5]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[5]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[5]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[6]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[6]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[6]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[6]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[6]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[6]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[6]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[6]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[6]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[6]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[6]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[6]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[6]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[6]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[6]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[6]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[7]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[7]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[7]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[7]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[7]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[7]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[7]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[7]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[7]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[7]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[7]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[7]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[7]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[7]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[7]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[7]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[8]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[8]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[8]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[8]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[8]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[8]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[8]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[8]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[8]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[8]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[8]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[8]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[8]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[8]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[8]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[8]);
-
-        cyphertext[0] = _mm_aesenc_si128(cyphertext[0], mRoundKey[9]);
-        cyphertext[1] = _mm_aesenc_si128(cyphertext[1], mRoundKey[9]);
-        cyphertext[2] = _mm_aesenc_si128(cyphertext[2], mRoundKey[9]);
-        cyphertext[3] = _mm_aesenc_si128(cyphertext[3], mRoundKey[9]);
-        cyphertext[4] = _mm_aesenc_si128(cyphertext[4], mRoundKey[9]);
-        cyphertext[5] = _mm_aesenc_si128(cyphertext[5], mRoundKey[9]);
-        cyphertext[6] = _mm_aesenc_si128(cyphertext[6], mRoundKey[9]);
-        cyphertext[7] = _mm_aesenc_si128(cyphertext[7], mRoundKey[9]);
-        cyphertext[8] = _mm_aesenc_si128(cyphertext[8], mRoundKey[9]);
-        cyphertext[9] = _mm_aesenc_si128(cyphertext[9], mRoundKey[9]);
-        cyphertext[10] = _mm_aesenc_si128(cyphertext[10], mRoundKey[9]);
-        cyphertext[11] = _mm_aesenc_si128(cyphertext[11], mRoundKey[9]);
-        cyphertext[12] = _mm_aesenc_si128(cyphertext[12], mRoundKey[9]);
-        cyphertext[13] = _mm_aesenc_si128(cyphertext[13], mRoundKey[9]);
-        cyphertext[14] = _mm_aesenc_si128(cyphertext[14], mRoundKey[9]);
-        cyphertext[15] = _mm_aesenc_si128(cyphertext[15], mRoundKey[9]);
-
-        cyphertext[0] = _mm_aesenclast_si128(cyphertext[0], mRoundKey[10]);
-        cyphertext[1] = _mm_aesenclast_si128(cyphertext[1], mRoundKey[10]);
-        cyphertext[2] = _mm_aesenclast_si128(cyphertext[2], mRoundKey[10]);
-        cyphertext[3] = _mm_aesenclast_si128(cyphertext[3], mRoundKey[10]);
-        cyphertext[4] = _mm_aesenclast_si128(cyphertext[4], mRoundKey[10]);
-        cyphertext[5] = _mm_aesenclast_si128(cyphertext[5], mRoundKey[10]);
-        cyphertext[6] = _mm_aesenclast_si128(cyphertext[6], mRoundKey[10]);
-        cyphertext[7] = _mm_aesenclast_si128(cyphertext[7], mRoundKey[10]);
-        cyphertext[8] = _mm_aesenclast_si128(cyphertext[8], mRoundKey[10]);
-        cyphertext[9] = _mm_aesenclast_si128(cyphertext[9], mRoundKey[10]);
-        cyphertext[10] = _mm_aesenclast_si128(cyphertext[10], mRoundKey[10]);
-        cyphertext[11] = _mm_aesenclast_si128(cyphertext[11], mRoundKey[10]);
-        cyphertext[12] = _mm_aesenclast_si128(cyphertext[12], mRoundKey[10]);
-        cyphertext[13] = _mm_aesenclast_si128(cyphertext[13], mRoundKey[10]);
-        cyphertext[14] = _mm_aesenclast_si128(cyphertext[14], mRoundKey[10]);
-        cyphertext[15] = _mm_aesenclast_si128(cyphertext[15], mRoundKey[10]);
-
-    }
-
-    void AES::ecbEncCounterMode(u64 baseIdx, u64 blockLength, block * cyphertext) const 
-    {
-        const i32 step = 8;
-        i32 idx = 0;
-        i32 length = i32(blockLength - blockLength % step);
-
-        //std::array<block, step> temp;
-		block temp[step];
-
-        for (; idx < length; idx += step, baseIdx += step)
-        {
-            temp[0] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 0), mRoundKey[0]);
-            temp[1] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 1), mRoundKey[0]);
-            temp[2] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 2), mRoundKey[0]);
-            temp[3] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 3), mRoundKey[0]);
-            temp[4] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 4), mRoundKey[0]);
-            temp[5] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 5), mRoundKey[0]);
-            temp[6] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 6), mRoundKey[0]);
-            temp[7] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 7), mRoundKey[0]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[1]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[1]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[1]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[1]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[1]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[1]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[1]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[1]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[2]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[2]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[2]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[2]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[2]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[2]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[2]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[2]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[3]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[3]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[3]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[3]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[3]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[3]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[3]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[3]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[4]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[4]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[4]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[4]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[4]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[4]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[4]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[4]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[5]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[5]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[5]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[5]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[5]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[5]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[5]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[5]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[6]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[6]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[6]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[6]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[6]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[6]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[6]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[6]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[7]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[7]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[7]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[7]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[7]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[7]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[7]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[7]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[8]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[8]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[8]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[8]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[8]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[8]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[8]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[8]);
-
-            temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[9]);
-            temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[9]);
-            temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[9]);
-            temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[9]);
-            temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[9]);
-            temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[9]);
-            temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[9]);
-            temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[9]);
-
-            cyphertext[idx + 0] = _mm_aesenclast_si128(temp[0], mRoundKey[10]);
-            cyphertext[idx + 1] = _mm_aesenclast_si128(temp[1], mRoundKey[10]);
-            cyphertext[idx + 2] = _mm_aesenclast_si128(temp[2], mRoundKey[10]);
-            cyphertext[idx + 3] = _mm_aesenclast_si128(temp[3], mRoundKey[10]);
-            cyphertext[idx + 4] = _mm_aesenclast_si128(temp[4], mRoundKey[10]);
-            cyphertext[idx + 5] = _mm_aesenclast_si128(temp[5], mRoundKey[10]);
-            cyphertext[idx + 6] = _mm_aesenclast_si128(temp[6], mRoundKey[10]);
-            cyphertext[idx + 7] = _mm_aesenclast_si128(temp[7], mRoundKey[10]);
-        }
-
-        for (; idx < static_cast<i32>(blockLength); ++idx, ++baseIdx)
-        {
-            cyphertext[idx] = _mm_xor_si128(_mm_set1_epi64x(baseIdx), mRoundKey[0]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[1]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[2]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[3]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[4]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[5]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[6]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[7]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[8]);
-            cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[9]);
-            cyphertext[idx] = _mm_aesenclast_si128(cyphertext[idx], mRoundKey[10]);
-        }
-
-    }
-
-
-    //void AES::ecbEncCounterMode(u64 baseIdx, u64 blockLength, block* cyphertext, const u64* destIdxs)
-    //{
-    //    const u64 step = 8;
-    //    u64 idx = 0;
-    //    u64 length = blockLength - blockLength % step;
-
-    //    std::array<block, step> temp;
-
-    //    for (; idx < length; idx += step, baseIdx += step)
-    //    {
-    //        temp[0] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 0), mRoundKey[0]);
-    //        temp[1] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 1), mRoundKey[0]);
-    //        temp[2] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 2), mRoundKey[0]);
-    //        temp[3] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 3), mRoundKey[0]);
-    //        temp[4] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 4), mRoundKey[0]);
-    //        temp[5] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 5), mRoundKey[0]);
-    //        temp[6] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 6), mRoundKey[0]);
-    //        temp[7] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 7), mRoundKey[0]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[1]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[1]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[1]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[1]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[1]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[1]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[1]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[1]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[2]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[2]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[2]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[2]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[2]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[2]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[2]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[2]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[3]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[3]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[3]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[3]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[3]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[3]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[3]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[3]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[4]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[4]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[4]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[4]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[4]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[4]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[4]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[4]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[5]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[5]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[5]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[5]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[5]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[5]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[5]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[5]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[6]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[6]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[6]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[6]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[6]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[6]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[6]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[6]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[7]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[7]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[7]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[7]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[7]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[7]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[7]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[7]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[8]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[8]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[8]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[8]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[8]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[8]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[8]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[8]);
-
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[9]);
-    //        temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[9]);
-    //        temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[9]);
-    //        temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[9]);
-    //        temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[9]);
-    //        temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[9]);
-    //        temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[9]);
-    //        temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[9]);
-
-    //        cyphertext[destIdxs[idx + 0]] = _mm_aesenclast_si128(temp[0], mRoundKey[10]);
-    //        cyphertext[destIdxs[idx + 1]] = _mm_aesenclast_si128(temp[1], mRoundKey[10]);
-    //        cyphertext[destIdxs[idx + 2]] = _mm_aesenclast_si128(temp[2], mRoundKey[10]);
-    //        cyphertext[destIdxs[idx + 3]] = _mm_aesenclast_si128(temp[3], mRoundKey[10]);
-    //        cyphertext[destIdxs[idx + 4]] = _mm_aesenclast_si128(temp[4], mRoundKey[10]);
-    //        cyphertext[destIdxs[idx + 5]] = _mm_aesenclast_si128(temp[5], mRoundKey[10]);
-    //        cyphertext[destIdxs[idx + 6]] = _mm_aesenclast_si128(temp[6], mRoundKey[10]);
-    //        cyphertext[destIdxs[idx + 7]] = _mm_aesenclast_si128(temp[7], mRoundKey[10]);
-    //    }
-
-
-    //    for (; idx < blockLength; ++idx, ++baseIdx)
-    //    {
-    //        temp[0] = _mm_xor_si128(_mm_set1_epi64x(baseIdx), mRoundKey[0]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[1]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[2]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[3]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[4]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[5]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[6]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[7]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[8]);
-    //        temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[9]);
-    //        cyphertext[destIdxs[idx]] = _mm_aesenclast_si128(temp[0], mRoundKey[10]);
-    //    }
-
-    //}
-
-    AESDec::AESDec()
-    {
-    }
-
-    AESDec::AESDec(const block & userKey)
-    {
-        setKey(userKey);
-    }
-
-    void AESDec::setKey(const block & userKey)
-    {
-        const block& v0 = userKey;
-        const block  v1 = keyGenHelper(v0, _mm_aeskeygenassist_si128(v0, 0x01));
-        const block  v2 = keyGenHelper(v1, _mm_aeskeygenassist_si128(v1, 0x02));
-        const block  v3 = keyGenHelper(v2, _mm_aeskeygenassist_si128(v2, 0x04));
-        const block  v4 = keyGenHelper(v3, _mm_aeskeygenassist_si128(v3, 0x08));
-        const block  v5 = keyGenHelper(v4, _mm_aeskeygenassist_si128(v4, 0x10));
-        const block  v6 = keyGenHelper(v5, _mm_aeskeygenassist_si128(v5, 0x20));
-        const block  v7 = keyGenHelper(v6, _mm_aeskeygenassist_si128(v6, 0x40));
-        const block  v8 = keyGenHelper(v7, _mm_aeskeygenassist_si128(v7, 0x80));
-        const block  v9 = keyGenHelper(v8, _mm_aeskeygenassist_si128(v8, 0x1B));
-        const block  v10 = keyGenHelper(v9, _mm_aeskeygenassist_si128(v9, 0x36));
-
-
-        _mm_storeu_si128(mRoundKey, v10);
-        _mm_storeu_si128(mRoundKey + 1, _mm_aesimc_si128(v9));
-        _mm_storeu_si128(mRoundKey + 2, _mm_aesimc_si128(v8));
-        _mm_storeu_si128(mRoundKey + 3, _mm_aesimc_si128(v7));
-        _mm_storeu_si128(mRoundKey + 4, _mm_aesimc_si128(v6));
-        _mm_storeu_si128(mRoundKey + 5, _mm_aesimc_si128(v5));
-        _mm_storeu_si128(mRoundKey + 6, _mm_aesimc_si128(v4));
-        _mm_storeu_si128(mRoundKey + 7, _mm_aesimc_si128(v3));
-        _mm_storeu_si128(mRoundKey + 8, _mm_aesimc_si128(v2));
-        _mm_storeu_si128(mRoundKey + 9, _mm_aesimc_si128(v1));
-        _mm_storeu_si128(mRoundKey + 10, v0);
-
-    }
-
-    void  AESDec::ecbDecBlock(const block & cyphertext, block & plaintext)
-    {
-        plaintext = _mm_xor_si128(cyphertext, mRoundKey[0]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[1]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[2]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[3]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[4]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[5]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[6]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[7]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[8]);
-        plaintext = _mm_aesdec_si128(plaintext, mRoundKey[9]);
-        plaintext = _mm_aesdeclast_si128(plaintext, mRoundKey[10]);
-
-    }
-
-    block AESDec::ecbDecBlock(const block & plaintext)
+        if (cpuFeatures().mAES)
+            ecbEncBlocksAesNi<Rounds, EcbMode::Plain>(mRoundKey, plaintexts, blockLength, cyphertext);
+        else
+            ecbEncBlocksBitsliced<EcbMode::Plain>(bitslicedKey(mBitsliced, mRoundKey, Rounds), plaintexts, blockLength, cyphertext);
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncTwoBlocks(const block * plaintexts, block * cyphertext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncNBlocks<Rounds, 2>(mRoundKey, plaintexts, cyphertext);
+        else
+            ecbEncBlocksBitsliced<EcbMode::Plain>(bitslicedKey(mBitsliced, mRoundKey, Rounds), plaintexts, 2, cyphertext);
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncFourBlocks(const block * plaintexts, block * cyphertext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncNBlocks<Rounds, 4>(mRoundKey, plaintexts, cyphertext);
+        else
+            ecbEncBlocksBitsliced<EcbMode::Plain>(bitslicedKey(mBitsliced, mRoundKey, Rounds), plaintexts, 4, cyphertext);
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEnc8Blocks(const block * plaintexts, block * cyphertext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncNBlocks<Rounds, 8>(mRoundKey, plaintexts, cyphertext);
+        else
+            bitslicedKey(mBitsliced, mRoundKey, Rounds).ecbEnc8Blocks(plaintexts, cyphertext);
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEnc16Blocks(const block * plaintexts, block * cyphertext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncNBlocks<Rounds, 16>(mRoundKey, plaintexts, cyphertext);
+        else
+            ecbEncBlocksBitsliced<EcbMode::Plain>(bitslicedKey(mBitsliced, mRoundKey, Rounds), plaintexts, 16, cyphertext);
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncCounterMode(u64 baseIdx, u64 blockLength, block * cyphertext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncCounterModeAesNi<Rounds>(mRoundKey, baseIdx, blockLength, cyphertext);
+        else
+            ecbEncCounterModeBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), baseIdx, blockLength,
+                [&](u64 idx, u64 n, const block* c) { std::copy(c, c + n, cyphertext + idx); });
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncCounterMode(u64 baseIdx, u64 blockLength, u8 * cyphertext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncCounterModeUnalignedAesNi<Rounds, false>(mRoundKey, baseIdx, blockLength, cyphertext);
+        else
+            ecbEncCounterModeBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), baseIdx, blockLength,
+                [&](u64 idx, u64 n, const block* c) { memcpy(cyphertext + 16 * idx, c, 16 * n); });
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncCounterModeXor(u64 baseIdx, u64 blockLength, u8 * data) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncCounterModeUnalignedAesNi<Rounds, true>(mRoundKey, baseIdx, blockLength, data);
+        else
+            ecbEncCounterModeBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), baseIdx, blockLength,
+                [&](u64 idx, u64 n, const block* c) {
+                    for (u64 i = 0; i < n; ++i)
+                    {
+                        block* d = (block*)(data + 16 * (idx + i));
+                        _mm_storeu_si128(d, _mm_xor_si128(_mm_loadu_si128(d), c[i]));
+                    }
+                });
+    }
+
+    template<int KeyBits>
+    block AESBase<KeyBits>::hashBlock(const block & x) const
+    {
+        block ret;
+        if (cpuFeatures().mAES)
+            hashNBlocks<Rounds, 1>(mRoundKey, &x, &ret);
+        else
+            hashBlocks(&x, 1, &ret);
+        return ret;
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::hashBlocks(const block * x, u64 blockLength, block * out) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncBlocksAesNi<Rounds, EcbMode::Mmo>(mRoundKey, x, blockLength, out);
+        else
+            ecbEncBlocksBitsliced<EcbMode::Mmo>(bitslicedKey(mBitsliced, mRoundKey, Rounds), x, blockLength, out);
+    }
+
+    template<int KeyBits>
+    block AESBase<KeyBits>::ccrHashBlock(const block & x) const
+    {
+        block ret;
+        if (cpuFeatures().mAES)
+            ccrHashNBlocks<Rounds, 1>(mRoundKey, &x, &ret);
+        else
+            ccrHashBlocks(&x, 1, &ret);
+        return ret;
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ccrHashBlocks(const block * x, u64 blockLength, block * out) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncBlocksAesNi<Rounds, EcbMode::Ccr>(mRoundKey, x, blockLength, out);
+        else
+            ecbEncBlocksBitsliced<EcbMode::Ccr>(bitslicedKey(mBitsliced, mRoundKey, Rounds), x, blockLength, out);
+    }
+
+    template<int KeyBits>
+    block AESBase<KeyBits>::tccrHashBlock(const block & x, const block & tweak) const
+    {
+        block ret;
+        if (cpuFeatures().mAES)
+            tccrHashNBlocks<Rounds, 1>(mRoundKey, &x, &tweak, &ret);
+        else
+            tccrHashBlocks(&x, &tweak, 1, &ret);
+        return ret;
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::tccrHashBlocks(const block * x, const block * tweaks, u64 blockLength, block * out) const
+    {
+        if (cpuFeatures().mAES)
+            tccrHashBlocksAesNi<Rounds>(mRoundKey, x, tweaks, blockLength, out);
+        else
+            tccrHashBlocksBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), x,
+                [&](u64 i) { return tweaks[i]; }, blockLength, out);
+    }
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::tccrHashBlocks(const block * x, u64 tweakIdx, u64 blockLength, block * out) const
+    {
+        if (cpuFeatures().mAES)
+            tccrHashBlocksAesNi<Rounds>(mRoundKey, x, tweakIdx, blockLength, out);
+        else
+            tccrHashBlocksBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), x,
+                [&](u64 i) { return toBlock(tweakIdx + i); }, blockLength, out);
+    }
+
+
+    template<int KeyBits>
+    void AESBase<KeyBits>::ecbEncCounterMode(u64 baseIdx, u64 blockLength, block * cyphertext, const u64 * destIdxs) const
+    {
+        if (cpuFeatures().mAES)
+            ecbEncCounterModeAesNi<Rounds>(mRoundKey, baseIdx, blockLength, cyphertext, destIdxs);
+        else
+            ecbEncCounterModeBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), baseIdx, blockLength,
+                [&](u64 idx, u64 n, const block* c) {
+                    for (u64 i = 0; i < n; ++i)
+                        cyphertext[destIdxs[idx + i]] = c[i];
+                });
+    }
+
+
+    template<int KeyBits>
+    void AESDecBase<KeyBits>::setKey(const Key & userKey)
+    {
+        // The equivalent inverse cipher: the encryption round keys in
+        // reverse order with InvMixColumns applied to the middle ones.
+        AESBase<KeyBits> enc(userKey);
+        bool aesNi = cpuFeatures().mAES;
+
+        mRoundKey[0] = enc.mRoundKey[Rounds];
+        for (int i = 1; i < Rounds; ++i)
+            mRoundKey[i] = aesNi
+                ? aesImc(enc.mRoundKey[Rounds - i])
+                : BitslicedAES::invMixColumns(enc.mRoundKey[Rounds - i]);
+        mRoundKey[Rounds] = enc.mRoundKey[0];
+
+        if (aesNi)
+            mBitsliced.reset();
+        else
+            mBitsliced = std::make_shared<BitslicedKeySchedule>(mRoundKey, Rounds);
+    }
+
+    template<int KeyBits>
+    void AESDecBase<KeyBits>::ecbDecBlock(const block & cyphertext, block & plaintext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbDecNBlocks<Rounds, 1>(mRoundKey, &cyphertext, &plaintext);
+        else
+            ecbDecBlocksBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), &cyphertext, 1, &plaintext);
+    }
+
+    template<int KeyBits>
+    block AESDecBase<KeyBits>::ecbDecBlock(const block & plaintext) const
     {
         block ret;
         ecbDecBlock(plaintext, ret);
         return ret;
     }
 
+    template<int KeyBits>
+    void AESDecBase<KeyBits>::ecbDecBlocks(const block * cyphertexts, u64 blockLength, block * plaintext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbDecBlocksAesNi<Rounds>(mRoundKey, cyphertexts, blockLength, plaintext);
+        else
+            ecbDecBlocksBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), cyphertexts, blockLength, plaintext);
+    }
+
+    template<int KeyBits>
+    void AESDecBase<KeyBits>::ecbDecTwoBlocks(const block * cyphertexts, block * plaintext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbDecNBlocks<Rounds, 2>(mRoundKey, cyphertexts, plaintext);
+        else
+            ecbDecBlocksBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), cyphertexts, 2, plaintext);
+    }
+
+    template<int KeyBits>
+    void AESDecBase<KeyBits>::ecbDecFourBlocks(const block * cyphertexts, block * plaintext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbDecNBlocks<Rounds, 4>(mRoundKey, cyphertexts, plaintext);
+        else
+            ecbDecBlocksBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), cyphertexts, 4, plaintext);
+    }
+
+    template<int KeyBits>
+    void AESDecBase<KeyBits>::ecbDec8Blocks(const block * cyphertexts, block * plaintext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbDecNBlocks<Rounds, 8>(mRoundKey, cyphertexts, plaintext);
+        else
+            bitslicedKey(mBitsliced, mRoundKey, Rounds).ecbDec8Blocks(cyphertexts, plaintext);
+    }
+
+    template<int KeyBits>
+    void AESDecBase<KeyBits>::ecbDec16Blocks(const block * cyphertexts, block * plaintext) const
+    {
+        if (cpuFeatures().mAES)
+            ecbDecNBlocks<Rounds, 16>(mRoundKey, cyphertexts, plaintext);
+        else
+            ecbDecBlocksBitsliced(bitslicedKey(mBitsliced, mRoundKey, Rounds), cyphertexts, 16, plaintext);
+    }
+
+    void expandAESKeys(span<const block> keys, span<AES> aes)
+    {
+        if (keys.size() != aes.size())
+            throw RTE_LOC;
+
+        const u64 step = 8;
+        u64 n = keys.size(), i = 0;
+        if (cpuFeatures().mAES)
+            for (; i + step <= n; i += step)
+                expandKeysN<step>(keys.data() + i, aes.data() + i);
+        for (; i < n; ++i)
+            aes[i].setKey(keys[i]);
+    }
+
+    std::shared_ptr<const BitslicedLaneSchedules> bitsliceLanes(const AES* aes, u64 n)
+    {
+        if (cpuFeatures().mAES)
+            return nullptr;
+
+        const u64 step = 8;
+        const block* rk[step];
+        auto lanes = std::make_shared<BitslicedLaneSchedules>();
+        lanes->mGroups.reserve(n / step);
+        for (u64 i = 0; i + step <= n; i += step)
+        {
+            for (u64 l = 0; l < step; ++l) rk[l] = aes[i + l].mRoundKey;
+            lanes->mGroups.emplace_back(rk);
+        }
+        return lanes;
+    }
+
+    void ecbEncBlocksMultiKey(const AES* aes, u64 n, const block* plaintexts, block* ciphertext,
+        const BitslicedLaneSchedules* lanes)
+    {
+        const u64 step = 8;
+        const block* rk[step];
+
+        u64 i = 0;
+        for (; i + step <= n; i += step)
+        {
+            for (u64 l = 0; l < step; ++l) rk[l] = aes[i + l].mRoundKey;
+            ecbEnc8Lanes(rk, laneGroup(lanes, i), plaintexts + i, ciphertext + i);
+        }
+        for (; i < n; ++i)
+            aes[i].ecbEncBlock(plaintexts[i], ciphertext[i]);
+    }
+
+    void DynamicMultiKeyAES::setKeys(span<const block> keys)
+    {
+        mAESs.resize(keys.size());
+        expandAESKeys(keys, mAESs);
+        mBitsliced = bitsliceLanes(mAESs.data(), size());
+    }
+
+    void DynamicMultiKeyAES::ecbEncBlock(const block & plaintext, block * ciphertext) const
+    {
+        const u64 step = 8;
+        const block* rk[step];
+        block in[step];
+        for (u64 l = 0; l < step; ++l) in[l] = plaintext;
+
+        u64 i = 0, n = size();
+        for (; i + step <= n; i += step)
+        {
+            for (u64 l = 0; l < step; ++l) rk[l] = mAESs[i + l].mRoundKey;
+            ecbEnc8Lanes(rk, laneGroup(mBitsliced.get(), i), in, ciphertext + i);
+        }
+        for (; i < n; ++i)
+            ciphertext[i] = mAESs[i].ecbEncBlock(plaintext);
+    }
+
+    void DynamicMultiKeyAES::ecbEncBlocks(const block * plaintexts, u64 blocksPerKey, block * ciphertext) const
+    {
+        const u64 step = 8;
+
+        // Enough blocks per key to fill the pipeline with a single key.
+        if (blocksPerKey >= step)
+        {
+            for (u64 i = 0; i < size(); ++i)
+                mAESs[i].ecbEncBlocks(plaintexts + i * blocksPerKey, blocksPerKey, ciphertext + i * blocksPerKey);
+            return;
+        }
+
+        const block* rk[step];
+
+        // Without AES-NI the lanes hold 8 keys, whose schedule is bitsliced
+        // once by setKeys, and block j of each of them.
+        if (cpuFeatures().mAES == false)
+        {
+            block in[step], out[step];
+            u64 i = 0;
+            for (; i + step <= size(); i += step)
+            {
+                for (u64 l = 0; l < step; ++l) rk[l] = mAESs[i + l].mRoundKey;
+                for (u64 j = 0; j < blocksPerKey; ++j)
+                {
+                    for (u64 l = 0; l < step; ++l) in[l] = plaintexts[(i + l) * blocksPerKey + j];
+                    ecbEnc8Lanes(rk, laneGroup(mBitsliced.get(), i), in, out);
+                    for (u64 l = 0; l < step; ++l) ciphertext[(i + l) * blocksPerKey + j] = out[l];
+                }
+            }
+            for (; i < size(); ++i)
+                mAESs[i].ecbEncBlocks(plaintexts + i * blocksPerKey, blocksPerKey, ciphertext + i * blocksPerKey);
+            return;
+        }
+
+        // Otherwise each group of 8 consecutive blocks spans several keys.
+        u64 total = size() * blocksPerKey, t = 0, key = 0, j = 0;
+        for (; t + step <= total; t += step)
+        {
+            for (u64 l = 0; l < step; ++l)
+            {
+                rk[l] = mAESs[key].mRoundKey;
+                if (++j == blocksPerKey) { j = 0; ++key; }
+            }
+            ecbEnc8Lanes(rk, nullptr, plaintexts + t, ciphertext + t);
+        }
+        for (; t < total; ++t)
+        {
+            mAESs[key].ecbEncBlock(plaintexts[t], ciphertext[t]);
+            if (++j == blocksPerKey) { j = 0; ++key; }
+        }
+    }
+
+    void DynamicMultiKeyAES::ecbEncCounterMode(u64 baseIdx, u64 blocksPerKey, block * ciphertext) const
+    {
+        const u64 step = 8;
+        if (blocksPerKey >= step)
+        {
+            for (u64 i = 0; i < size(); ++i)
+                mAESs[i].ecbEncCounterMode(baseIdx, blocksPerKey, ciphertext + i * blocksPerKey);
+            return;
+        }
+
+        const block* rk[step];
+        block in[step];
+
+        // As in ecbEncBlocks, without AES-NI the lanes hold 8 keys and counter j.
+        if (cpuFeatures().mAES == false)
+        {
+            block out[step];
+            u64 i = 0;
+            for (; i + step <= size(); i += step)
+            {
+                for (u64 l = 0; l < step; ++l) rk[l] = mAESs[i + l].mRoundKey;
+                for (u64 j = 0; j < blocksPerKey; ++j)
+                {
+                    for (u64 l = 0; l < step; ++l) in[l] = _mm_set1_epi64x(baseIdx + j);
+                    ecbEnc8Lanes(rk, laneGroup(mBitsliced.get(), i), in, out);
+                    for (u64 l = 0; l < step; ++l) ciphertext[(i + l) * blocksPerKey + j] = out[l];
+                }
+            }
+            for (; i < size(); ++i)
+                mAESs[i].ecbEncCounterMode(baseIdx, blocksPerKey, ciphertext + i * blocksPerKey);
+            return;
+        }
+
+        u64 total = size() * blocksPerKey, t = 0, key = 0, j = 0;
+        for (; t + step <= total; t += step)
+        {
+            for (u64 l = 0; l < step; ++l)
+            {
+                rk[l] = mAESs[key].mRoundKey;
+                in[l] = _mm_set1_epi64x(baseIdx + j);
+                if (++j == blocksPerKey) { j = 0; ++key; }
+            }
+            ecbEnc8Lanes(rk, nullptr, in, ciphertext + t);
+        }
+        for (; t < total; ++t)
+        {
+            mAESs[key].ecbEncBlock(_mm_set1_epi64x(baseIdx + j), ciphertext[t]);
+            if (++j == blocksPerKey) { j = 0; ++key; }
+        }
+    }
+
+    template class AESBase<128>;
+    template class AESBase<192>;
+    template class AESBase<256>;
 
+    template class AESDecBase<128>;
+    template class AESDecBase<192>;
+    template class AESDecBase<256>;
 }
@@ -2,25 +2,50 @@
 // This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
 #include <cryptoTools/Common/Defines.h>
 #include <wmmintrin.h>
+#include <array>
+#include <memory>
+#include <vector>
+#include <type_traits>
 
 namespace osuCrypto {
 
+    // The bitsliced round keys used on CPUs without AES-NI, see AES.cpp.
+    struct BitslicedKeySchedule;
 
-    // An AES-NI implemenation of AES encryption. 
-    class AES
+    // The bitsliced round keys of groups of 8 keys, one key per lane.
+    struct BitslicedLaneSchedules;
+
+    // An implemenation of AES encryption with a KeyBits bit key, where
+    // KeyBits is 128, 192 or 256. AES-NI is used if the CPU has it and the
+    // constant time BitslicedAES otherwise. The number of rounds is a compile
+    // time constant so that the round loops are fully unrolled.
+    template<int KeyBits>
+    class AESBase
     {
     public:
+        static_assert(KeyBits == 128 || KeyBits == 192 || KeyBits == 256, "AES keys are 128, 192 or 256 bits.");
+
+        // The number of rounds: 10, 12 or 14.
+        static const int Rounds = KeyBits / 32 + 6;
+
+        // The key type. A single block for AES-128 and two blocks for AES-192
+        // and AES-256. For AES-192 only the low 64 bits of the second block are used.
+        typedef typename std::conditional<KeyBits == 128, block, std::array<block, 2>>::type Key;
 
         // Default constructor leave the class in an invalid state
         // until setKey(...) is called.
-        AES() {};
-        AES(const AES&) = default;
+        AESBase() {};
+        AESBase(const AESBase&) = default;
 
         // Constructor to initialize the class with the given key
-        AES(const block& userKey);
+        AESBase(const Key& userKey) { setKey(userKey); }
 
         // Set the key to be used for encryption.
-        void setKey(const block& userKey);
+        void setKey(const Key& userKey);
+
+        // Xors mask into the first round key, after which the cipher computes
+        // AES_key(x ^ mask). The bitsliced schedule is rebuilt to match.
+        void xorFirstRoundKey(const block& mask);
 
         // Encrypts the plaintext block and stores the result in ciphertext
         void ecbEncBlock(const block& plaintext, block& ciphertext) const;
@@ -29,7 +54,7 @@ namespace osuCrypto {
         block ecbEncBlock(const block& plaintext) const;
 
         // Encrypts blockLength starting at the plaintexts pointer and writes the result
-        // to the ciphertext pointer
+        // to the ciphertext pointer. Uses the VAES kernels if the CPU supports them.
         void ecbEncBlocks(const block* plaintexts, u64 blockLength, block* ciphertext) const;
 
         void ecbEncBlocks(span<const block> plaintexts, span<block> ciphertext) const
@@ -46,11 +71,14 @@ namespace osuCrypto {
         // Encrypts 4 blocks pointer to by plaintexts and writes the result to ciphertext
         void ecbEncFourBlocks(const block* plaintexts, block* ciphertext) const;
 
+        // Encrypts 8 blocks pointer to by plaintexts and writes the result to ciphertext
+        void ecbEnc8Blocks(const block* plaintexts, block* ciphertext) const;
+
         // Encrypts 16 blocks pointer to by plaintexts and writes the result to ciphertext
         void ecbEnc16Blocks(const block* plaintexts, block* ciphertext) const;
 
         // Encrypts the vector of blocks {baseIdx, baseIdx + 1, ..., baseIdx + length - 1} 
-        // and writes the result to ciphertext.
+        // and writes the result to ciphertext. Uses the VAES kernels if the CPU supports them.
         void ecbEncCounterMode(u64 baseIdx, u64 length, block* ciphertext) const;
 
         void ecbEncCounterMode(u64 baseIdx, span<block> ciphertext) const
@@ -58,13 +86,114 @@ namespace osuCrypto {
             ecbEncCounterMode(baseIdx, ciphertext.size(), ciphertext.data());
         }
 
-        // Returns the current key.
-        const block& getKey() const { return mRoundKey[0]; }
+        // The same, but ciphertext does not need to be aligned.
+        void ecbEncCounterMode(u64 baseIdx, u64 length, u8* ciphertext) const;
+
+        // Xors the encryption of baseIdx + i into the 16 bytes at data + 16 * i
+        // for i < length, i.e. applies the counter mode keystream in place. The
+        // keystream stays in registers and data does not need to be aligned.
+        void ecbEncCounterModeXor(u64 baseIdx, u64 length, u8* data) const;
+
+        // Encrypts the blocks {baseIdx, ..., baseIdx + length - 1} and writes the
+        // encryption of baseIdx + i to ciphertext[destIdxs[i]], e.g. directly into
+        // cuckoo bins or a permuted table. The destinations of the next blocks are
+        // prefetched while the current ones are encrypted.
+        void ecbEncCounterMode(u64 baseIdx, u64 length, block* ciphertext, const u64* destIdxs) const;
+
+        void ecbEncCounterMode(u64 baseIdx, span<const u64> destIdxs, span<block> ciphertext) const
+        {
+#ifndef NDEBUG
+            for (auto d : destIdxs)
+                if (d >= u64(ciphertext.size()))
+                    throw RTE_LOC;
+#endif
+            ecbEncCounterMode(baseIdx, destIdxs.size(), ciphertext.data(), destIdxs.data());
+        }
+
+        // The correlation robust hash H(x) = AES(x) ^ x (Matyas-Meyer-Oseas).
+        // The encryption and the feed-forward xor are fused into one pass.
+        block hashBlock(const block& x) const;
+
+        // Computes out[i] = H(x[i]) for blockLength blocks. x and out may alias.
+        void hashBlocks(const block* x, u64 blockLength, block* out) const;
+
+        void hashBlocks(span<const block> x, span<block> out) const
+        {
+            if (x.size() != out.size())
+                throw RTE_LOC;
+            hashBlocks(x.data(), x.size(), out.data());
+        }
+
+        // The circular correlation robust hash H(x) = AES(sigma(x)) ^ sigma(x)
+        // where sigma(xL || xR) = (xL ^ xR || xL) is a linear orthomorphism.
+        block ccrHashBlock(const block& x) const;
+
+        // Computes out[i] = H(x[i]) for blockLength blocks. x and out may alias.
+        void ccrHashBlocks(const block* x, u64 blockLength, block* out) const;
+
+        void ccrHashBlocks(span<const block> x, span<block> out) const
+        {
+            if (x.size() != out.size())
+                throw RTE_LOC;
+            ccrHashBlocks(x.data(), x.size(), out.data());
+        }
+
+        // The tweakable circular correlation robust hash
+        // H(x, tweak) = AES(AES(x) ^ tweak) ^ AES(x).
+        block tccrHashBlock(const block& x, const block& tweak) const;
+
+        // Computes out[i] = H(x[i], tweaks[i]) for blockLength blocks.
+        void tccrHashBlocks(const block* x, const block* tweaks, u64 blockLength, block* out) const;
+
+        void tccrHashBlocks(span<const block> x, span<const block> tweaks, span<block> out) const
+        {
+            if (x.size() != out.size() || x.size() != tweaks.size())
+                throw RTE_LOC;
+            tccrHashBlocks(x.data(), tweaks.data(), x.size(), out.data());
+        }
+
+        // Computes out[i] = H(x[i], toBlock(tweakIdx + i)), e.g. with the gate index as the tweak.
+        void tccrHashBlocks(const block* x, u64 tweakIdx, u64 blockLength, block* out) const;
+
+        void tccrHashBlocks(span<const block> x, u64 tweakIdx, span<block> out) const
+        {
+            if (x.size() != out.size())
+                throw RTE_LOC;
+            tccrHashBlocks(x.data(), tweakIdx, x.size(), out.data());
+        }
+
+        // Returns the current key. For AES-192 the high 64 bits of the
+        // second block hold round key material and are ignored by setKey.
+        const Key& getKey() const { return *reinterpret_cast<const Key*>(mRoundKey); }
 
         // The expanded key.
-        block mRoundKey[11];
+        block mRoundKey[Rounds + 1];
+
+        // The bitsliced form of mRoundKey, built by setKey when the CPU has no
+        // AES-NI. It is only used while it still matches mRoundKey.
+        std::shared_ptr<const BitslicedKeySchedule> mBitsliced;
     };
 
+    typedef AESBase<128> AES;
+    typedef AESBase<192> AES192;
+    typedef AESBase<256> AES256;
+
+    extern template class AESBase<128>;
+    extern template class AESBase<192>;
+    extern template class AESBase<256>;
+
+    // Expands keys[i] into aes[i] for all i. Eight of the independent key
+    // schedules are computed at a time so that their latency overlaps.
+    void expandAESKeys(span<const block> keys, span<AES> aes);
+
+    // Bitslices the keys aes[8g], ..., aes[8g + 7] of each whole group g of 8,
+    // or returns null if the CPU has AES-NI.
+    std::shared_ptr<const BitslicedLaneSchedules> bitsliceLanes(const AES* aes, u64 n);
+
+    // Encrypts plaintexts[i] under aes[i] for i < n, 8 keys at a time. lanes
+    // may hold bitsliceLanes(aes, n) and is only used while it still matches.
+    void ecbEncBlocksMultiKey(const AES* aes, u64 n, const block* plaintexts, block* ciphertext,
+        const BitslicedLaneSchedules* lanes = nullptr);
 
     // Specialization of the AES class to support encryption of N values under N different keys
     template<int N>
@@ -80,57 +209,151 @@ namespace osuCrypto {
         // Constructor to initialize the class with the given key
         MultiKeyAES(span<block> keys) { setKeys(keys); }
 
+        // The bitsliced lanes of mAESs, built by setKeys when the CPU has no AES-NI.
+        std::shared_ptr<const BitslicedLaneSchedules> mBitsliced;
+
         // Set the N keys to be used for encryption.
         void setKeys(span<block> keys)
         {
-            for (u64 i = 0; i < N; ++i)
-            {
-                mAESs[i].setKey(keys[i]);
-            }
+            expandAESKeys(keys.subspan(0, N), mAESs);
+            mBitsliced = bitsliceLanes(mAESs.data(), N);
         }
 
         // Computes the encrpytion of N blocks pointed to by plaintext 
         // and stores the result at ciphertext.
         void ecbEncNBlocks(const block* plaintext, block* ciphertext) const
         {
-
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_xor_si128(plaintext[i], mAESs[i].mRoundKey[0]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[1]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[2]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[3]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[4]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[5]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[6]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[7]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[8]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenc_si128(ciphertext[i], mAESs[i].mRoundKey[9]);
-            for (int i = 0; i < N; ++i) ciphertext[i] = _mm_aesenclast_si128(ciphertext[i], mAESs[i].mRoundKey[10]);
+            ecbEncBlocksMultiKey(mAESs.data(), N, plaintext, ciphertext, mBitsliced.get());
         }
 
         // Utility to compare the keys.
         const MultiKeyAES<N>& operator=(const MultiKeyAES<N>& rhs)
         {
             for (u64 i = 0; i < N; ++i)
-                for (u64 j = 0; j < 11; ++j)
-                    mAESs[i].mRoundKey[j] = rhs.mAESs[i].mRoundKey[j];
+                mAESs[i] = rhs.mAESs[i];
+            mBitsliced = rhs.mBitsliced;
 
             return rhs;
         }
     };
 
+    // AES under a number of keys that is only known at runtime. All of the
+    // operations interleave up to 8 independent keys so that the aesenc
+    // pipeline stays full even when there is one block per key.
+    class DynamicMultiKeyAES
+    {
+    public:
+        std::vector<AES> mAESs;
+
+        // The bitsliced lanes of mAESs, built by setKeys when the CPU has no AES-NI.
+        std::shared_ptr<const BitslicedLaneSchedules> mBitsliced;
+
+        DynamicMultiKeyAES() = default;
+
+        // Constructor to initialize the class with the given keys
+        DynamicMultiKeyAES(span<const block> keys) { setKeys(keys); }
+
+        // Set the keys to be used for encryption.
+        void setKeys(span<const block> keys);
+
+        // The number of keys.
+        u64 size() const { return mAESs.size(); }
+
+        const AES& operator[](u64 i) const { return mAESs[i]; }
+
+        // Encrypts plaintext under every key: ciphertext[i] = AES_i(plaintext).
+        void ecbEncBlock(const block& plaintext, block* ciphertext) const;
+
+        void ecbEncBlock(const block& plaintext, span<block> ciphertext) const
+        {
+            if (u64(ciphertext.size()) != size())
+                throw RTE_LOC;
+            ecbEncBlock(plaintext, ciphertext.data());
+        }
+
+        // Encrypts blocksPerKey blocks under each key. The blocks of key i are
+        // plaintexts[i * blocksPerKey, ..., (i + 1) * blocksPerKey - 1].
+        void ecbEncBlocks(const block* plaintexts, u64 blocksPerKey, block* ciphertext) const;
+
+        void ecbEncBlocks(span<const block> plaintexts, span<block> ciphertext) const
+        {
+            if (plaintexts.size() != ciphertext.size() ||
+                (size() ? plaintexts.size() % size() : plaintexts.size()))
+                throw RTE_LOC;
+            ecbEncBlocks(plaintexts.data(), size() ? plaintexts.size() / size() : 0, ciphertext.data());
+        }
+
+        // Encrypts the counters {baseIdx, ..., baseIdx + blocksPerKey - 1} under each
+        // key and writes the blocks of key i to ciphertext[i * blocksPerKey, ...].
+        void ecbEncCounterMode(u64 baseIdx, u64 blocksPerKey, block* ciphertext) const;
+
+        void ecbEncCounterMode(u64 baseIdx, span<block> ciphertext) const
+        {
+            if (size() ? ciphertext.size() % size() : ciphertext.size())
+                throw RTE_LOC;
+            ecbEncCounterMode(baseIdx, size() ? ciphertext.size() / size() : 0, ciphertext.data());
+        }
+    };
+
     // An AES instance with a fixed and public key.
     extern const AES mAesFixedKey;
 
-    // A class to perform AES decryption.
-    class AESDec
+    // A class to perform AES decryption with a KeyBits bit key.
+    template<int KeyBits>
+    class AESDecBase
     {
     public:
-        AESDec();
-        AESDec(const block& userKey);
-        void setKey(const block& userKey);
-        void ecbDecBlock(const block& ciphertext, block& plaintext);
-        block ecbDecBlock(const block& ciphertext);
-        block mRoundKey[11];
+        static const int Rounds = AESBase<KeyBits>::Rounds;
+        typedef typename AESBase<KeyBits>::Key Key;
+
+        AESDecBase() {};
+        AESDecBase(const AESDecBase&) = default;
+        AESDecBase(const Key& userKey) { setKey(userKey); }
+        void setKey(const Key& userKey);
+
+        // Decrypts the ciphertext block and stores the result in plaintext
+        void ecbDecBlock(const block& ciphertext, block& plaintext) const;
+
+        // Decrypts the ciphertext block and returns the result
+        block ecbDecBlock(const block& ciphertext) const;
+
+        // Decrypts blockLength starting at the ciphertexts pointer and writes the result
+        // to the plaintext pointer. Independent blocks are interleaved so that the
+        // aesdec latency is hidden. Uses the VAES kernels if the CPU supports them.
+        void ecbDecBlocks(const block* ciphertexts, u64 blockLength, block* plaintext) const;
+
+        void ecbDecBlocks(span<const block> ciphertexts, span<block> plaintext) const
+        {
+            if (ciphertexts.size() != plaintext.size())
+                throw RTE_LOC;
+            ecbDecBlocks(ciphertexts.data(), ciphertexts.size(), plaintext.data());
+        }
+
+        // Decrypts 2 blocks pointer to by ciphertexts and writes the result to plaintext
+        void ecbDecTwoBlocks(const block* ciphertexts, block* plaintext) const;
+
+        // Decrypts 4 blocks pointer to by ciphertexts and writes the result to plaintext
+        void ecbDecFourBlocks(const block* ciphertexts, block* plaintext) const;
+
+        // Decrypts 8 blocks pointer to by ciphertexts and writes the result to plaintext
+        void ecbDec8Blocks(const block* ciphertexts, block* plaintext) const;
+
+        // Decrypts 16 blocks pointer to by ciphertexts and writes the result to plaintext
+        void ecbDec16Blocks(const block* ciphertexts, block* plaintext) const;
+
+        // The expanded decryption key, in the order it is applied.
+        block mRoundKey[Rounds + 1];
+
+        // The bitsliced form of mRoundKey, as for AESBase.
+        std::shared_ptr<const BitslicedKeySchedule> mBitsliced;
     };
 
+    typedef AESDecBase<128> AESDec;
+    typedef AESDecBase<192> AESDec192;
+    typedef AESDecBase<256> AESDec256;
+
+    extern template class AESDecBase<128>;
+    extern template class AESDecBase<192>;
+    extern template class AESDecBase<256>;
+
 }
@@ -0,0 +1,52 @@
+#include <cryptoTools/Crypto/AESStream.h>
+
+#include <algorithm>
+
+namespace osuCrypto
+{
+    void AESStream::setKey(const block& key, const block& nonce)
+    {
+        mAes.setKey(key);
+        mAes.xorFirstRoundKey(nonce);
+        seek(0);
+    }
+
+    void AESStream::xorKeystream(u8* data, u64 length)
+    {
+        const u64 blockSize = sizeof(block);
+
+        // the rest of the partial block.
+        u64 head = std::min(length, blockSize - mPartialIdx);
+        for (u64 i = 0; i < head; ++i)
+            data[i] ^= ((u8*)&mPartial)[mPartialIdx + i];
+        mPartialIdx += head;
+        data += head;
+        length -= head;
+
+        u64 blocks = length / blockSize;
+        mAes.ecbEncCounterModeXor(mBlockIdx, blocks, data);
+        mBlockIdx += blocks;
+        data += blocks * blockSize;
+        length -= blocks * blockSize;
+
+        if (length)
+        {
+            mAes.ecbEncCounterMode(mBlockIdx++, 1, &mPartial);
+            for (u64 i = 0; i < length; ++i)
+                data[i] ^= ((u8*)&mPartial)[i];
+            mPartialIdx = length;
+        }
+    }
+
+    void AESStream::seek(u64 bytePos)
+    {
+        const u64 blockSize = sizeof(block);
+        mBlockIdx = bytePos / blockSize;
+        mPartialIdx = bytePos % blockSize;
+
+        if (mPartialIdx)
+            mAes.ecbEncCounterMode(mBlockIdx++, 1, &mPartial);
+        else
+            mPartialIdx = blockSize;
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/AES.h>
+
+namespace osuCrypto
+{
+    // AES-128 in counter mode as a stream cipher. Byte j of the keystream is
+    // byte j % 16 of AES_key(_mm_set1_epi64x(j / 16) ^ nonce). With a zero
+    // nonce this is the same stream as PRNG(key) produces. A key and nonce
+    // pair must not be used to encrypt two different messages.
+    class AESStream
+    {
+    public:
+        // Default constructor leave the class in an invalid state
+        // until setKey(...) is called.
+        AESStream() = default;
+
+        AESStream(const block& key, const block& nonce = ZeroBlock) { setKey(key, nonce); }
+
+        // Sets the key and nonce and moves to the start of the stream.
+        void setKey(const block& key, const block& nonce = ZeroBlock);
+
+        // Xors the next length bytes of the keystream into data, which
+        // encrypts or decrypts it. Whole blocks are processed by
+        // AES::ecbEncCounterModeXor without an intermediate buffer; the
+        // keystream of a trailing partial block is kept for the next call.
+        void xorKeystream(u8* data, u64 length);
+
+        void xorKeystream(span<u8> data)
+        {
+            xorKeystream(data.data(), data.size());
+        }
+
+        // Moves to byte bytePos of the stream.
+        void seek(u64 bytePos);
+
+        // The current byte position in the stream.
+        u64 position() const { return mBlockIdx * sizeof(block) - (sizeof(block) - mPartialIdx); }
+
+        // The cipher, with the nonce xored into the first round key by
+        // AES::xorFirstRoundKey. This is the same as xoring it into the
+        // counter block and keeps the counter mode kernels unchanged.
+        AES mAes;
+
+        // The index of the next counter block.
+        u64 mBlockIdx = 0;
+
+        // The keystream of the current partial block, of which the first
+        // mPartialIdx bytes are used.
+        block mPartial = ZeroBlock;
+        u64 mPartialIdx = sizeof(block);
+    };
+}
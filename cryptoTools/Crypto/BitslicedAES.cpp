@@ -0,0 +1,452 @@
+#include <cryptoTools/Crypto/BitslicedAES.h>
+
+#include <cstring>
+
+namespace osuCrypto
+{
+    namespace
+    {
+        // The bitsliced representation is the one of BearSSL's aes_ct64,
+        // with one of its 64 bit words in each lane: q[i] holds bit i of
+        // every byte, lane 0 for blocks 0 to 3 and lane 1 for blocks 4 to 7.
+        // Within a lane, the 16 bits of row r are bits 16r to 16r + 15 and
+        // each nibble is one column of the four blocks.
+
+        template<int S>
+        inline void swapN(block& x, block& y, const block& lo, const block& hi)
+        {
+            block a = x, b = y;
+            x = (a & lo) | _mm_slli_epi64(b & lo, S);
+            y = _mm_srli_epi64(a & hi, S) | (b & hi);
+        }
+
+        // Transposes the 8x8 bit matrices formed by the registers and the
+        // bits of each byte. It is its own inverse.
+        inline void ortho(block* q)
+        {
+            const block lo1 = _mm_set1_epi8(0x55), hi1 = _mm_set1_epi8(-0x56);
+            const block lo2 = _mm_set1_epi8(0x33), hi2 = _mm_set1_epi8(-0x34);
+            const block lo4 = _mm_set1_epi8(0x0f), hi4 = _mm_set1_epi8(-0x10);
+
+            swapN<1>(q[0], q[1], lo1, hi1);
+            swapN<1>(q[2], q[3], lo1, hi1);
+            swapN<1>(q[4], q[5], lo1, hi1);
+            swapN<1>(q[6], q[7], lo1, hi1);
+
+            swapN<2>(q[0], q[2], lo2, hi2);
+            swapN<2>(q[1], q[3], lo2, hi2);
+            swapN<2>(q[4], q[6], lo2, hi2);
+            swapN<2>(q[5], q[7], lo2, hi2);
+
+            swapN<4>(q[0], q[4], lo4, hi4);
+            swapN<4>(q[1], q[5], lo4, hi4);
+            swapN<4>(q[2], q[6], lo4, hi4);
+            swapN<4>(q[3], q[7], lo4, hi4);
+        }
+
+        inline void bitslice(const block* in, block* q)
+        {
+            // Interleaves the bytes of the two halves of each block.
+            const block perm = _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15);
+            for (int i = 0; i < 4; ++i)
+            {
+                block a = _mm_shuffle_epi8(in[i], perm);
+                block b = _mm_shuffle_epi8(in[i + 4], perm);
+                q[i] = _mm_unpacklo_epi64(a, b);
+                q[i + 4] = _mm_unpackhi_epi64(a, b);
+            }
+            ortho(q);
+        }
+
+        inline void unbitslice(block* q, block* out)
+        {
+            const block perm = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+            ortho(q);
+            for (int i = 0; i < 4; ++i)
+            {
+                out[i] = _mm_shuffle_epi8(_mm_unpacklo_epi64(q[i], q[i + 4]), perm);
+                out[i + 4] = _mm_shuffle_epi8(_mm_unpackhi_epi64(q[i], q[i + 4]), perm);
+            }
+        }
+
+        // The S-box circuit of Boyar and Peralta, "A new combinational logic
+        // minimization technique with applications to cryptology". The
+        // x and s variables are numbered from the high bit.
+        inline void sbox(block* q)
+        {
+            const block ones = _mm_set1_epi32(-1);
+            block x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4];
+            block x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+            // Top linear transformation.
+            block y14 = x3 ^ x5;
+            block y13 = x0 ^ x6;
+            block y9 = x0 ^ x3;
+            block y8 = x0 ^ x5;
+            block t0 = x1 ^ x2;
+            block y1 = t0 ^ x7;
+            block y4 = y1 ^ x3;
+            block y12 = y13 ^ y14;
+            block y2 = y1 ^ x0;
+            block y5 = y1 ^ x6;
+            block y3 = y5 ^ y8;
+            block t1 = x4 ^ y12;
+            block y15 = t1 ^ x5;
+            block y20 = t1 ^ x1;
+            block y6 = y15 ^ x7;
+            block y10 = y15 ^ t0;
+            block y11 = y20 ^ y9;
+            block y7 = x7 ^ y11;
+            block y17 = y10 ^ y11;
+            block y19 = y10 ^ y8;
+            block y16 = t0 ^ y11;
+            block y21 = y13 ^ y16;
+            block y18 = x0 ^ y16;
+
+            // Non-linear section.
+            block t2 = y12 & y15;
+            block t3 = y3 & y6;
+            block t4 = t3 ^ t2;
+            block t5 = y4 & x7;
+            block t6 = t5 ^ t2;
+            block t7 = y13 & y16;
+            block t8 = y5 & y1;
+            block t9 = t8 ^ t7;
+            block t10 = y2 & y7;
+            block t11 = t10 ^ t7;
+            block t12 = y9 & y11;
+            block t13 = y14 & y17;
+            block t14 = t13 ^ t12;
+            block t15 = y8 & y10;
+            block t16 = t15 ^ t12;
+            block t17 = t4 ^ t14;
+            block t18 = t6 ^ t16;
+            block t19 = t9 ^ t14;
+            block t20 = t11 ^ t16;
+            block t21 = t17 ^ y20;
+            block t22 = t18 ^ y19;
+            block t23 = t19 ^ y21;
+            block t24 = t20 ^ y18;
+
+            block t25 = t21 ^ t22;
+            block t26 = t21 & t23;
+            block t27 = t24 ^ t26;
+            block t28 = t25 & t27;
+            block t29 = t28 ^ t22;
+            block t30 = t23 ^ t24;
+            block t31 = t22 ^ t26;
+            block t32 = t31 & t30;
+            block t33 = t32 ^ t24;
+            block t34 = t23 ^ t33;
+            block t35 = t27 ^ t33;
+            block t36 = t24 & t35;
+            block t37 = t36 ^ t34;
+            block t38 = t27 ^ t36;
+            block t39 = t29 & t38;
+            block t40 = t25 ^ t39;
+
+            block t41 = t40 ^ t37;
+            block t42 = t29 ^ t33;
+            block t43 = t29 ^ t40;
+            block t44 = t33 ^ t37;
+            block t45 = t42 ^ t41;
+            block z0 = t44 & y15;
+            block z1 = t37 & y6;
+            block z2 = t33 & x7;
+            block z3 = t43 & y16;
+            block z4 = t40 & y1;
+            block z5 = t29 & y7;
+            block z6 = t42 & y11;
+            block z7 = t45 & y17;
+            block z8 = t41 & y10;
+            block z9 = t44 & y12;
+            block z10 = t37 & y3;
+            block z11 = t33 & y4;
+            block z12 = t43 & y13;
+            block z13 = t40 & y5;
+            block z14 = t29 & y2;
+            block z15 = t42 & y9;
+            block z16 = t45 & y14;
+            block z17 = t41 & y8;
+
+            // Bottom linear transformation.
+            block t46 = z15 ^ z16;
+            block t47 = z10 ^ z11;
+            block t48 = z5 ^ z13;
+            block t49 = z9 ^ z10;
+            block t50 = z2 ^ z12;
+            block t51 = z2 ^ z5;
+            block t52 = z7 ^ z8;
+            block t53 = z0 ^ z3;
+            block t54 = z6 ^ z7;
+            block t55 = z16 ^ z17;
+            block t56 = z12 ^ t48;
+            block t57 = t50 ^ t53;
+            block t58 = z4 ^ t46;
+            block t59 = z3 ^ t54;
+            block t60 = t46 ^ t57;
+            block t61 = z14 ^ t57;
+            block t62 = t52 ^ t58;
+            block t63 = t49 ^ t58;
+            block t64 = z4 ^ t59;
+            block t65 = t61 ^ t62;
+            block t66 = z1 ^ t63;
+            block s0 = t59 ^ t63;
+            block s6 = t56 ^ t62 ^ ones;
+            block s7 = t48 ^ t60 ^ ones;
+            block t67 = t64 ^ t65;
+            block s3 = t53 ^ t66;
+            block s4 = t51 ^ t66;
+            block s5 = t47 ^ t65;
+            block s1 = t64 ^ s3 ^ ones;
+            block s2 = t55 ^ t67 ^ ones;
+
+            q[7] = s0;
+            q[6] = s1;
+            q[5] = s2;
+            q[4] = s3;
+            q[3] = s4;
+            q[2] = s5;
+            q[1] = s6;
+            q[0] = s7;
+        }
+
+        // The inverse of the affine map of the S-box.
+        inline void invAffine(block* q)
+        {
+            const block ones = _mm_set1_epi32(-1);
+            block q0 = q[0] ^ ones, q1 = q[1] ^ ones, q2 = q[2], q3 = q[3];
+            block q4 = q[4], q5 = q[5] ^ ones, q6 = q[6] ^ ones, q7 = q[7];
+            q[7] = q1 ^ q4 ^ q6;
+            q[6] = q0 ^ q3 ^ q5;
+            q[5] = q7 ^ q2 ^ q4;
+            q[4] = q6 ^ q1 ^ q3;
+            q[3] = q5 ^ q0 ^ q2;
+            q[2] = q4 ^ q7 ^ q1;
+            q[1] = q3 ^ q6 ^ q0;
+            q[0] = q2 ^ q5 ^ q7;
+        }
+
+        // The inverse S-box is the S-box conjugated by the inverse of its affine map.
+        inline void invSbox(block* q)
+        {
+            invAffine(q);
+            sbox(q);
+            invAffine(q);
+        }
+
+        // Rotates each 16 bit row right by S bits, i.e. by S / 4 columns.
+        template<int S>
+        inline block rotateRow(const block& x)
+        {
+            return _mm_srli_epi16(x, S) | _mm_slli_epi16(x, 16 - S);
+        }
+
+        template<>
+        inline block rotateRow<8>(const block& x)
+        {
+            const block perm = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+            return _mm_shuffle_epi8(x, perm);
+        }
+
+        inline void shiftRows(block* q)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                block x = _mm_blend_epi16(q[i], rotateRow<4>(q[i]), 0x22);
+                x = _mm_blend_epi16(x, rotateRow<8>(q[i]), 0x44);
+                q[i] = _mm_blend_epi16(x, rotateRow<12>(q[i]), 0x88);
+            }
+        }
+
+        inline void invShiftRows(block* q)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                block x = _mm_blend_epi16(q[i], rotateRow<12>(q[i]), 0x22);
+                x = _mm_blend_epi16(x, rotateRow<8>(q[i]), 0x44);
+                q[i] = _mm_blend_epi16(x, rotateRow<4>(q[i]), 0x88);
+            }
+        }
+
+        // Moves row r + 1 of each column to row r.
+        inline block nextRow(const block& x)
+        {
+            const block perm = _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+            return _mm_shuffle_epi8(x, perm);
+        }
+
+        // Moves row r + 2 of each column to row r.
+        inline block nextRow2(const block& x)
+        {
+            return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+
+        // out_r = 2 a_r ^ 3 a_{r+1} ^ a_{r+2} ^ a_{r+3}
+        //       = 2 (a_r ^ a_{r+1}) ^ a_{r+1} ^ (a_{r+2} ^ a_{r+3}).
+        inline void mixColumns(block* q)
+        {
+            block r[8], s[8];
+            for (int i = 0; i < 8; ++i)
+            {
+                r[i] = nextRow(q[i]);
+                s[i] = q[i] ^ r[i];
+            }
+
+            q[0] = s[7] ^ r[0] ^ nextRow2(s[0]);
+            q[1] = s[0] ^ s[7] ^ r[1] ^ nextRow2(s[1]);
+            q[2] = s[1] ^ r[2] ^ nextRow2(s[2]);
+            q[3] = s[2] ^ s[7] ^ r[3] ^ nextRow2(s[3]);
+            q[4] = s[3] ^ s[7] ^ r[4] ^ nextRow2(s[4]);
+            q[5] = s[4] ^ r[5] ^ nextRow2(s[5]);
+            q[6] = s[5] ^ r[6] ^ nextRow2(s[6]);
+            q[7] = s[6] ^ r[7] ^ nextRow2(s[7]);
+        }
+
+        // Multiplication of every byte by x modulo x^8 + x^4 + x^3 + x + 1.
+        inline void mulX(block* q)
+        {
+            block t = q[7];
+            q[7] = q[6];
+            q[6] = q[5];
+            q[5] = q[4];
+            q[4] = q[3] ^ t;
+            q[3] = q[2] ^ t;
+            q[2] = q[1];
+            q[1] = q[0] ^ t;
+            q[0] = t;
+        }
+
+        // InvMixColumns = MixColumns o M, where M maps a_r to
+        // a_r ^ 4 (a_r ^ a_{r+2}).
+        inline void invMixColumnsSliced(block* q)
+        {
+            block t[8];
+            for (int i = 0; i < 8; ++i)
+                t[i] = q[i] ^ nextRow2(q[i]);
+            mulX(t);
+            mulX(t);
+            for (int i = 0; i < 8; ++i)
+                q[i] = q[i] ^ t[i];
+            mixColumns(q);
+        }
+
+        inline void addRoundKey(block* q, const block* rk)
+        {
+            for (int i = 0; i < 8; ++i)
+                q[i] = q[i] ^ rk[i];
+        }
+    }
+
+    void BitslicedAES::setRoundKeys(const block* roundKey, int rounds)
+    {
+        block keys[8];
+        mRounds = rounds;
+        for (int j = 0; j <= rounds; ++j)
+        {
+            for (int l = 0; l < 8; ++l)
+                keys[l] = roundKey[j];
+            bitslice(keys, mRoundKey[j]);
+        }
+    }
+
+    void BitslicedAES::setRoundKeys(const block* const* roundKeys, int rounds)
+    {
+        block keys[8];
+        mRounds = rounds;
+        for (int j = 0; j <= rounds; ++j)
+        {
+            for (int l = 0; l < 8; ++l)
+                keys[l] = roundKeys[l][j];
+            bitslice(keys, mRoundKey[j]);
+        }
+    }
+
+    void BitslicedAES::ecbEnc8Blocks(const block* plaintexts, block* ciphertext) const
+    {
+        block q[8];
+        bitslice(plaintexts, q);
+
+        addRoundKey(q, mRoundKey[0]);
+        for (int j = 1; j < mRounds; ++j)
+        {
+            sbox(q);
+            shiftRows(q);
+            mixColumns(q);
+            addRoundKey(q, mRoundKey[j]);
+        }
+        sbox(q);
+        shiftRows(q);
+        addRoundKey(q, mRoundKey[mRounds]);
+
+        unbitslice(q, ciphertext);
+    }
+
+    void BitslicedAES::ecbDec8Blocks(const block* ciphertexts, block* plaintext) const
+    {
+        block q[8];
+        bitslice(ciphertexts, q);
+
+        addRoundKey(q, mRoundKey[0]);
+        for (int j = 1; j < mRounds; ++j)
+        {
+            invShiftRows(q);
+            invSbox(q);
+            invMixColumnsSliced(q);
+            addRoundKey(q, mRoundKey[j]);
+        }
+        invShiftRows(q);
+        invSbox(q);
+        addRoundKey(q, mRoundKey[mRounds]);
+
+        unbitslice(q, plaintext);
+    }
+
+    void BitslicedAES::expandKey(const u8* userKey, int keyWords, int rounds, block* roundKey)
+    {
+        // The words are little endian, so RotWord is a right rotation by 8.
+        u32 w[4 * (MaxRounds + 1)];
+        int n = 4 * (rounds + 1);
+        u32 rcon = 1;
+
+        memcpy(w, userKey, 4 * keyWords);
+        for (int i = keyWords; i < n; ++i)
+        {
+            u32 t = w[i - 1];
+            if (i % keyWords == 0)
+            {
+                t = subWord((t >> 8) | (t << 24)) ^ rcon;
+                rcon = (rcon << 1) ^ (0x11b & (0 - (rcon >> 7)));
+            }
+            else if (keyWords > 6 && i % keyWords == 4)
+                t = subWord(t);
+            w[i] = w[i - keyWords] ^ t;
+        }
+        memcpy(roundKey, w, 4 * n);
+    }
+
+    block BitslicedAES::invMixColumns(const block& x)
+    {
+        block q[8], out[8];
+        for (int l = 0; l < 8; ++l)
+            out[l] = x;
+        bitslice(out, q);
+        invMixColumnsSliced(q);
+        unbitslice(q, out);
+        return out[0];
+    }
+
+    u32 BitslicedAES::subWord(u32 x)
+    {
+        // Only the bytes of x are transposed by ortho; the S-box of the
+        // other, zero, bytes is discarded.
+        block q[8];
+        q[0] = _mm_cvtsi32_si128(int(x));
+        for (int i = 1; i < 8; ++i)
+            q[i] = _mm_setzero_si128();
+        ortho(q);
+        sbox(q);
+        ortho(q);
+        return u32(_mm_cvtsi128_si32(q[0]));
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+
+namespace osuCrypto
+{
+    // A constant time software AES for CPUs without AES-NI. The state of 8
+    // blocks is bitsliced over 8 registers so that the S-box is a boolean
+    // circuit; no branch or memory access depends on the key or the data.
+    // The round keys have the same layout as those of AES and AESDec.
+    class BitslicedAES
+    {
+    public:
+        static const int MaxRounds = 14;
+
+        BitslicedAES() = default;
+
+        // Bitslices the rounds + 1 round keys, shared by all 8 lanes.
+        BitslicedAES(const block* roundKey, int rounds) { setRoundKeys(roundKey, rounds); }
+
+        void setRoundKeys(const block* roundKey, int rounds);
+
+        // Lane l uses the round keys roundKeys[l].
+        void setRoundKeys(const block* const* roundKeys, int rounds);
+
+        // The same as xoring the first round key followed by aesenc for the
+        // middle rounds and aesenclast for the last one, for 8 blocks.
+        void ecbEnc8Blocks(const block* plaintexts, block* ciphertext) const;
+
+        // The same with aesdec and aesdeclast, i.e. the equivalent inverse cipher.
+        void ecbDec8Blocks(const block* ciphertexts, block* plaintext) const;
+
+        // Expands the keyWords 32 bit words at userKey into rounds + 1 round keys.
+        static void expandKey(const u8* userKey, int keyWords, int rounds, block* roundKey);
+
+        // InvMixColumns, as computed by aesimc.
+        static block invMixColumns(const block& x);
+
+        // The S-box applied to each byte of x.
+        static u32 subWord(u32 x);
+
+        int mRounds = 0;
+
+        // The bitsliced round keys.
+        block mRoundKey[MaxRounds + 1][8];
+    };
+}
@@ -1,4 +1,6 @@
 #include <cryptoTools/Crypto/Blake2.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <immintrin.h>
 
 namespace osuCrypto
 {
@@ -10,4 +12,439 @@ namespace osuCrypto
         state = src.state;
         return *this;
     }
+
+    namespace
+    {
+        const u64 blake2bIV[8] =
+        {
+            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+            0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+            0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+        };
+
+        const u8 blake2bSigma[12][16] =
+        {
+            {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+            { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+            { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+            {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+            {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+            {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+            { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+            { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+            {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+            { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+            {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+            { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+        };
+
+        // Word i of lane l is at h[i][l] and m[i][l]. t is the number of
+        // message bytes up to and including this block.
+        template<u64 Lanes>
+        using CompressFn = void(*)(u64(&h)[8][Lanes], const u64(&m)[16][Lanes], u64 t, bool last);
+
+        OC_TARGET("avx2")
+        inline void g4(__m256i& a, __m256i& b, __m256i& c, __m256i& d, const __m256i& x, const __m256i& y)
+        {
+            const __m256i r16 = _mm256_setr_epi8(
+                2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+            const __m256i r24 = _mm256_setr_epi8(
+                3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+
+            a = _mm256_add_epi64(_mm256_add_epi64(a, b), x);
+            d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), _MM_SHUFFLE(2, 3, 0, 1));
+            c = _mm256_add_epi64(c, d);
+            b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), r24);
+            a = _mm256_add_epi64(_mm256_add_epi64(a, b), y);
+            d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), r16);
+            c = _mm256_add_epi64(c, d);
+            b = _mm256_xor_si256(b, c);
+            b = _mm256_xor_si256(_mm256_srli_epi64(b, 63), _mm256_add_epi64(b, b));
+        }
+
+        OC_TARGET("avx2")
+        void compress4(u64(&h)[8][4], const u64(&m)[16][4], u64 t, bool last)
+        {
+            __m256i v[16], w[16];
+            for (u64 i = 0; i < 16; ++i)
+                w[i] = _mm256_loadu_si256((const __m256i*)m[i]);
+            for (u64 i = 0; i < 8; ++i)
+            {
+                v[i] = _mm256_loadu_si256((const __m256i*)h[i]);
+                v[i + 8] = _mm256_set1_epi64x(blake2bIV[i]);
+            }
+            v[12] = _mm256_xor_si256(v[12], _mm256_set1_epi64x(t));
+            v[14] = _mm256_xor_si256(v[14], _mm256_set1_epi64x(last ? -1 : 0));
+
+            for (u64 r = 0; r < 12; ++r)
+            {
+                const u8* s = blake2bSigma[r];
+                g4(v[0], v[4], v[8], v[12], w[s[0]], w[s[1]]);
+                g4(v[1], v[5], v[9], v[13], w[s[2]], w[s[3]]);
+                g4(v[2], v[6], v[10], v[14], w[s[4]], w[s[5]]);
+                g4(v[3], v[7], v[11], v[15], w[s[6]], w[s[7]]);
+                g4(v[0], v[5], v[10], v[15], w[s[8]], w[s[9]]);
+                g4(v[1], v[6], v[11], v[12], w[s[10]], w[s[11]]);
+                g4(v[2], v[7], v[8], v[13], w[s[12]], w[s[13]]);
+                g4(v[3], v[4], v[9], v[14], w[s[14]], w[s[15]]);
+            }
+
+            for (u64 i = 0; i < 8; ++i)
+            {
+                __m256i hi = _mm256_loadu_si256((const __m256i*)h[i]);
+                hi = _mm256_xor_si256(hi, _mm256_xor_si256(v[i], v[i + 8]));
+                _mm256_storeu_si256((__m256i*)h[i], hi);
+            }
+        }
+
+#ifdef OC_HAVE_VAES
+// GCC 12 implements _mm512_ror_epi64 with an _mm512_undefined_epi32
+// pass-through operand (x = x in avx512fintrin.h), which -Wuninitialized
+// reports once inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+        OC_TARGET("avx512f")
+        inline void g8(__m512i& a, __m512i& b, __m512i& c, __m512i& d, const __m512i& x, const __m512i& y)
+        {
+            a = _mm512_add_epi64(_mm512_add_epi64(a, b), x);
+            d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 32);
+            c = _mm512_add_epi64(c, d);
+            b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 24);
+            a = _mm512_add_epi64(_mm512_add_epi64(a, b), y);
+            d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 16);
+            c = _mm512_add_epi64(c, d);
+            b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 63);
+        }
+
+        OC_TARGET("avx512f")
+        void compress8(u64(&h)[8][8], const u64(&m)[16][8], u64 t, bool last)
+        {
+            __m512i v[16], w[16];
+            for (u64 i = 0; i < 16; ++i)
+                w[i] = _mm512_loadu_si512(m[i]);
+            for (u64 i = 0; i < 8; ++i)
+            {
+                v[i] = _mm512_loadu_si512(h[i]);
+                v[i + 8] = _mm512_set1_epi64(blake2bIV[i]);
+            }
+            v[12] = _mm512_xor_si512(v[12], _mm512_set1_epi64(t));
+            v[14] = _mm512_xor_si512(v[14], _mm512_set1_epi64(last ? -1 : 0));
+
+            for (u64 r = 0; r < 12; ++r)
+            {
+                const u8* s = blake2bSigma[r];
+                g8(v[0], v[4], v[8], v[12], w[s[0]], w[s[1]]);
+                g8(v[1], v[5], v[9], v[13], w[s[2]], w[s[3]]);
+                g8(v[2], v[6], v[10], v[14], w[s[4]], w[s[5]]);
+                g8(v[3], v[7], v[11], v[15], w[s[6]], w[s[7]]);
+                g8(v[0], v[5], v[10], v[15], w[s[8]], w[s[9]]);
+                g8(v[1], v[6], v[11], v[12], w[s[10]], w[s[11]]);
+                g8(v[2], v[7], v[8], v[13], w[s[12]], w[s[13]]);
+                g8(v[3], v[4], v[9], v[14], w[s[14]], w[s[15]]);
+            }
+
+            for (u64 i = 0; i < 8; ++i)
+            {
+                __m512i hi = _mm512_loadu_si512(h[i]);
+                hi = _mm512_xor_si512(hi, _mm512_xor_si512(v[i], v[i + 8]));
+                _mm512_storeu_si512(h[i], hi);
+            }
+        }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+        // Hashes count messages, a multiple of Lanes, in groups of Lanes.
+        // The message words are transposed so that each register holds the
+        // same word of every message.
+        template<u64 Lanes, CompressFn<Lanes> Compress>
+        void hashLanes(const u8* in, u64 msgLength, u64 count, u8* out, u64 outLength)
+        {
+            u64 numBlocks = std::max<u64>(1, (msgLength + BLAKE2B_BLOCKBYTES - 1) / BLAKE2B_BLOCKBYTES);
+            u64 h[8][Lanes], m[16][Lanes], words[16];
+
+            for (u64 i = 0; i < count; i += Lanes)
+            {
+                for (u64 j = 0; j < 8; ++j)
+                    for (u64 l = 0; l < Lanes; ++l)
+                        h[j][l] = blake2bIV[j];
+#ifdef TRUE_BLAKE2_INIT
+                for (u64 l = 0; l < Lanes; ++l)
+                    h[0][l] ^= 0x01010000 ^ outLength;
+#endif
+
+                for (u64 b = 0; b < numBlocks; ++b)
+                {
+                    u64 begin = b * BLAKE2B_BLOCKBYTES;
+                    u64 size = std::min<u64>(BLAKE2B_BLOCKBYTES, msgLength - begin);
+                    if (size < BLAKE2B_BLOCKBYTES)
+                        memset(words, 0, sizeof(words));
+
+                    for (u64 l = 0; l < Lanes; ++l)
+                    {
+                        memcpy(words, in + (i + l) * msgLength + begin, size);
+                        for (u64 j = 0; j < 16; ++j)
+                            m[j][l] = words[j];
+                    }
+
+                    Compress(h, m, begin + size, b + 1 == numBlocks);
+                }
+
+                for (u64 l = 0; l < Lanes; ++l)
+                {
+                    for (u64 j = 0; j < 8; ++j)
+                        words[j] = h[j][l];
+                    memcpy(out + (i + l) * outLength, words, outLength);
+                }
+            }
+        }
+    }
+
+    namespace
+    {
+        // The BLAKE2Xb output nodes [begin, begin + count) in groups of Lanes.
+        // Each is a single compression of the root with the node parameters.
+        template<u64 Lanes, CompressFn<Lanes> Compress>
+        void xofNodeLanes(const blake2b_param& param, const u8* root, u64 begin, u64 count, u8* out)
+        {
+            u64 p[8], h[8][Lanes], m[16][Lanes];
+            memcpy(p, &param, sizeof(p));
+            memset(m, 0, sizeof(m));
+            for (u64 j = 0; j < 8; ++j)
+            {
+                u64 w;
+                memcpy(&w, root + 8 * j, 8);
+                for (u64 l = 0; l < Lanes; ++l)
+                    m[j][l] = w;
+            }
+
+            for (u64 i = 0; i < count; i += Lanes)
+            {
+                for (u64 j = 0; j < 8; ++j)
+                    for (u64 l = 0; l < Lanes; ++l)
+                        h[j][l] = blake2bIV[j] ^ p[j];
+
+                // the node offset is the low half of the second word.
+                for (u64 l = 0; l < Lanes; ++l)
+                    h[1][l] ^= begin + i + l;
+
+                Compress(h, m, BLAKE2B_OUTBYTES, true);
+
+                for (u64 l = 0; l < Lanes; ++l)
+                    for (u64 j = 0; j < 8; ++j)
+                        memcpy(out + (i + l) * BLAKE2B_OUTBYTES + 8 * j, &h[j][l], 8);
+            }
+        }
+
+        // Compresses stripes 4 * 128 byte blocks, one to each leaf of a
+        // BLAKE2bp state with an empty buffer, as blake2bp_update does. The
+        // leaves keep their last block buffered until the next one is known.
+        OC_TARGET("avx2")
+        void blake2bpLanes(blake2bp_state& state, const u8* in, u64 stripes)
+        {
+            const u64 stripeSize = 4 * BLAKE2B_BLOCKBYTES;
+            u64 h[8][4], m[16][4];
+            for (u64 j = 0; j < 8; ++j)
+                for (u64 l = 0; l < 4; ++l)
+                    h[j][l] = state.S[l]->h[j];
+
+            auto compress = [&](const u8* const* blocks)
+            {
+                for (u64 l = 0; l < 4; ++l)
+                    for (u64 j = 0; j < 16; ++j)
+                        memcpy(&m[j][l], blocks[l] + 8 * j, 8);
+
+                for (u64 l = 0; l < 4; ++l)
+                    state.S[l]->t[0] += BLAKE2B_BLOCKBYTES;
+                compress4(h, m, state.S[0]->t[0], false);
+            };
+
+            if (state.S[0]->buflen)
+            {
+                const u8* blocks[4];
+                for (u64 l = 0; l < 4; ++l)
+                    blocks[l] = state.S[l]->buf;
+                compress(blocks);
+            }
+
+            for (u64 s = 0; s + 1 < stripes; ++s)
+            {
+                const u8* blocks[4];
+                for (u64 l = 0; l < 4; ++l)
+                    blocks[l] = in + s * stripeSize + l * BLAKE2B_BLOCKBYTES;
+                compress(blocks);
+            }
+
+            for (u64 l = 0; l < 4; ++l)
+            {
+                for (u64 j = 0; j < 8; ++j)
+                    state.S[l]->h[j] = h[j][l];
+                memcpy(state.S[l]->buf, in + (stripes - 1) * stripeSize + l * BLAKE2B_BLOCKBYTES, BLAKE2B_BLOCKBYTES);
+                state.S[l]->buflen = BLAKE2B_BLOCKBYTES;
+            }
+        }
+    }
+
+    void Blake2::hashMany(const u8* in, u64 msgLength, u64 count, u8* out, u64 outLength)
+    {
+        if (outLength == 0 || outLength > MaxHashSize)
+            throw std::runtime_error("invalid output length " LOCATION);
+
+        auto& cpu = cpuFeatures();
+        u64 i = 0;
+#ifdef OC_HAVE_VAES
+        if (cpu.mAVX512F)
+        {
+            u64 size = count / 8 * 8;
+            hashLanes<8, compress8>(in, msgLength, size, out, outLength);
+            i = size;
+        }
+#endif
+        if (cpu.mAVX2)
+        {
+            u64 size = (count - i) / 4 * 4;
+            hashLanes<4, compress4>(in + i * msgLength, msgLength, size, out + i * outLength, outLength);
+            i += size;
+        }
+
+        Blake2 hasher(outLength);
+        for (; i < count; ++i)
+        {
+            hasher.Reset();
+            hasher.Update(in + i * msgLength, msgLength);
+            hasher.Final(out + i * outLength);
+        }
+    }
+
+    void Blake2bp::update(const u8* dataIn, u64 length)
+    {
+        const u64 stripeSize = sizeof(state.buf);
+
+        // the counters of the leaves are assumed to fit in 64 bits.
+        if (cpuFeatures().mAVX2 == false || length < stripeSize + (state.buflen ? stripeSize - state.buflen : 0))
+        {
+            Expects(blake2bp_update(&state, dataIn, length) == 0);
+            return;
+        }
+
+        if (state.buflen)
+        {
+            u64 fill = stripeSize - state.buflen;
+            Expects(blake2bp_update(&state, dataIn, fill) == 0);
+            dataIn += fill;
+            length -= fill;
+        }
+
+        u64 stripes = length / stripeSize;
+        blake2bpLanes(state, dataIn, stripes);
+        Expects(blake2bp_update(&state, dataIn + stripes * stripeSize, length % stripeSize) == 0);
+    }
+
+    void Blake2Xb::Reset(u64 outputLength, const u8* key, u64 keyLength)
+    {
+        Expects(blake2xb_init_key(&mState, outputLength, key, keyLength) == 0);
+        mFinal = false;
+        mOutputIdx = 0;
+    }
+
+    void Blake2Xb::Final()
+    {
+        if (mFinal)
+            throw std::runtime_error("Final was already called. " LOCATION);
+
+        Expects(blake2b_final(mState.S, mRoot, BLAKE2B_OUTBYTES) == 0);
+
+        // the same as blake2xb_final.
+        mNodeParam = mState.P[0];
+        mNodeParam.digest_length = BLAKE2B_OUTBYTES;
+        mNodeParam.key_length = 0;
+        mNodeParam.fanout = 0;
+        mNodeParam.depth = 0;
+        mNodeParam.leaf_length = BLAKE2B_OUTBYTES;
+        mNodeParam.node_offset = 0;
+        mNodeParam.inner_length = BLAKE2B_OUTBYTES;
+        mNodeParam.node_depth = 0;
+        mFinal = true;
+    }
+
+    u64 Blake2Xb::outputLength() const
+    {
+        u64 xofLength = mState.P->xof_length;
+        return xofLength == UnknownOutputLength ? u64(BLAKE2B_OUTBYTES) << 32 : xofLength;
+    }
+
+    void Blake2Xb::outputNodes(u64 begin, u64 end, u8* out) const
+    {
+        // only the last node of a known output length can be short.
+        u64 full = std::min(end, outputLength() / BLAKE2B_OUTBYTES);
+        u64 i = begin;
+        auto& cpu = cpuFeatures();
+#ifdef OC_HAVE_VAES
+        if (cpu.mAVX512F && i < full)
+        {
+            u64 size = (full - i) / 8 * 8;
+            xofNodeLanes<8, compress8>(mNodeParam, mRoot, i, size, out);
+            i += size;
+        }
+#endif
+        if (cpu.mAVX2 && i < full)
+        {
+            u64 size = (full - i) / 4 * 4;
+            xofNodeLanes<4, compress4>(mNodeParam, mRoot, i, size, out + (i - begin) * BLAKE2B_OUTBYTES);
+            i += size;
+        }
+
+        blake2b_param param = mNodeParam;
+        blake2b_state state;
+        for (; i < end; ++i)
+        {
+            u64 size = std::min<u64>(BLAKE2B_OUTBYTES, outputLength() - i * BLAKE2B_OUTBYTES);
+            param.digest_length = u8(size);
+            param.node_offset = u32(i);
+            blake2b_init_param(&state, &param);
+            blake2b_update(&state, mRoot, BLAKE2B_OUTBYTES);
+            blake2b_final(&state, out + (i - begin) * BLAKE2B_OUTBYTES, size);
+        }
+    }
+
+    void Blake2Xb::Output(u64 offset, u8* out, u64 length) const
+    {
+        if (mFinal == false)
+            throw std::runtime_error("Final must be called before the output is read. " LOCATION);
+        if (offset > outputLength() || length > outputLength() - offset)
+            throw std::runtime_error("Reading past the output length. " LOCATION);
+
+        u8 node[BLAKE2B_OUTBYTES];
+        u64 begin = offset / BLAKE2B_OUTBYTES;
+        u64 skip = offset % BLAKE2B_OUTBYTES;
+
+        // a node that is not read from its start.
+        if (skip && length)
+        {
+            outputNodes(begin, begin + 1, node);
+            u64 size = std::min(length, BLAKE2B_OUTBYTES - skip);
+            memcpy(out, node + skip, size);
+            out += size;
+            length -= size;
+            ++begin;
+        }
+
+        u64 whole = length / BLAKE2B_OUTBYTES;
+        outputNodes(begin, begin + whole, out);
+        out += whole * BLAKE2B_OUTBYTES;
+        length -= whole * BLAKE2B_OUTBYTES;
+
+        if (length)
+        {
+            outputNodes(begin + whole, begin + whole + 1, node);
+            memcpy(out, node, length);
+        }
+    }
 }
@@ -76,7 +76,7 @@ class Commit
         }
 
 		// Utility function to test if two commitments are equal.
-        bool operator==(const Commit& rhs)
+        bool operator==(const Commit& rhs) const
         {
             for (u64 i = 0; i < COMMIT_BUFF_u32_SIZE; ++i)
             {
@@ -87,7 +87,7 @@ class Commit
         }
 
 		// Utility function to test if two commitments are not equal.
-		bool operator!=(const Commit& rhs)
+		bool operator!=(const Commit& rhs) const
         {
             return !(*this == rhs);
         }
@@ -0,0 +1,317 @@
+#include <cryptoTools/Crypto/GF128.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <immintrin.h>
+
+namespace osuCrypto
+{
+    namespace
+    {
+        // The 128 bit carry-less product of a and b, four bits of b at a time.
+        void clmul64(u64 a, u64 b, u64& lo, u64& hi)
+        {
+            u64 tableLo[16], tableHi[16];
+            tableLo[0] = tableHi[0] = 0;
+            for (u64 j = 1; j < 16; ++j)
+            {
+                // a * j, as a * (j / 2) shifted once, plus a if j is odd.
+                u64 l = tableLo[j / 2], h = tableHi[j / 2];
+                tableLo[j] = (l << 1) ^ (j & 1 ? a : 0);
+                tableHi[j] = (h << 1) | (l >> 63);
+            }
+
+            lo = hi = 0;
+            for (int i = 60; i >= 0; i -= 4)
+            {
+                hi = (hi << 4) | (lo >> 60);
+                lo <<= 4;
+                u64 j = (b >> i) & 15;
+                lo ^= tableLo[j];
+                hi ^= tableHi[j];
+            }
+        }
+
+        void mulUnreducedPortable(const block& a, const block& b, block& lo, block& hi)
+        {
+            u64 a0 = _mm_cvtsi128_si64(a), a1 = _mm_extract_epi64(a, 1);
+            u64 b0 = _mm_cvtsi128_si64(b), b1 = _mm_extract_epi64(b, 1);
+
+            u64 l0, l1, h0, h1, m0, m1, n0, n1;
+            clmul64(a0, b0, l0, l1);
+            clmul64(a1, b1, h0, h1);
+            clmul64(a0, b1, m0, m1);
+            clmul64(a1, b0, n0, n1);
+            m0 ^= n0;
+            m1 ^= n1;
+
+            lo = toBlock(l1 ^ m0, l0);
+            hi = toBlock(h1, h0 ^ m1);
+        }
+
+        block reducePortable(const block& lo, const block& hi)
+        {
+            const u64 r = 0x87;
+            u64 x0 = _mm_cvtsi128_si64(lo), x1 = _mm_extract_epi64(lo, 1);
+            u64 x2 = _mm_cvtsi128_si64(hi), x3 = _mm_extract_epi64(hi, 1);
+
+            // x^192 = x^64 * r, whose product spills 7 bits into x^128.
+            u64 t0, t1;
+            clmul64(x3, r, t0, t1);
+            x1 ^= t0;
+            x2 ^= t1;
+
+            clmul64(x2, r, t0, t1);
+            x0 ^= t0;
+            x1 ^= t1;
+            return toBlock(x1, x0);
+        }
+
+        OC_TARGET("pclmul")
+        inline void mulUnreducedPclmul(const block& a, const block& b, block& lo, block& hi)
+        {
+            block mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x01), _mm_clmulepi64_si128(a, b, 0x10));
+            lo = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x00), _mm_slli_si128(mid, 8));
+            hi = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x11), _mm_srli_si128(mid, 8));
+        }
+
+        OC_TARGET("pclmul")
+        inline block reducePclmul(const block& lo, const block& hi)
+        {
+            const block r = _mm_set_epi64x(0, 0x87);
+            block t = _mm_clmulepi64_si128(hi, r, 0x01);
+            block x1 = _mm_xor_si128(hi, _mm_srli_si128(t, 8));
+            block x0 = _mm_xor_si128(lo, _mm_slli_si128(t, 8));
+            return _mm_xor_si128(x0, _mm_clmulepi64_si128(x1, r, 0x00));
+        }
+
+        OC_TARGET("pclmul")
+        block mulPclmul(const block& a, const block& b)
+        {
+            block lo, hi;
+            mulUnreducedPclmul(a, b, lo, hi);
+            return reducePclmul(lo, hi);
+        }
+
+        // Adds the Karatsuba terms a0 b0, a1 b1 and (a0 + a1)(b0 + b1) of
+        // a * b to lo, hi and mid. The middle term of the sum of products is
+        // then mid + lo + hi, which is only computed once at the end.
+        OC_TARGET("pclmul")
+        inline void karatsubaAccumulate(const block& a, const block& b, block& lo, block& hi, block& mid)
+        {
+            block aa = _mm_xor_si128(a, _mm_srli_si128(a, 8));
+            block bb = _mm_xor_si128(b, _mm_srli_si128(b, 8));
+            lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+            hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+            mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(aa, bb, 0x00));
+        }
+
+        block innerProductPortable(const block* a, const block* b, u64 n)
+        {
+            block lo = ZeroBlock, hi = ZeroBlock;
+            for (u64 i = 0; i < n; ++i)
+            {
+                block l, h;
+                mulUnreducedPortable(a[i], b[i], l, h);
+                lo = lo ^ l;
+                hi = hi ^ h;
+            }
+            return reducePortable(lo, hi);
+        }
+
+        OC_TARGET("pclmul")
+        block innerProductPclmul(const block* a, const block* b, u64 n)
+        {
+            block lo0 = ZeroBlock, hi0 = ZeroBlock, mid0 = ZeroBlock;
+            block lo1 = ZeroBlock, hi1 = ZeroBlock, mid1 = ZeroBlock;
+            u64 i = 0;
+            for (; i + 1 < n; i += 2)
+            {
+                karatsubaAccumulate(a[i], b[i], lo0, hi0, mid0);
+                karatsubaAccumulate(a[i + 1], b[i + 1], lo1, hi1, mid1);
+            }
+            if (i < n)
+                karatsubaAccumulate(a[i], b[i], lo0, hi0, mid0);
+
+            block l = _mm_xor_si128(lo0, lo1);
+            block h = _mm_xor_si128(hi0, hi1);
+            block m = _mm_xor_si128(_mm_xor_si128(mid0, mid1), _mm_xor_si128(l, h));
+            return reducePclmul(_mm_xor_si128(l, _mm_slli_si128(m, 8)), _mm_xor_si128(h, _mm_srli_si128(m, 8)));
+        }
+
+        OC_TARGET("pclmul")
+        void mulManyPclmul(const block* a, const block& b, block* out, u64 n)
+        {
+            for (u64 i = 0; i < n; ++i)
+                out[i] = mulPclmul(a[i], b);
+        }
+
+#ifdef OC_HAVE_VAES
+// GCC 12 implements _mm512_shuffle_epi32 with an _mm512_undefined_epi32
+// pass-through operand (x = x in avx512fintrin.h), which
+// -Wmaybe-uninitialized reports once inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+        // The same with four elements in each register.
+        OC_TARGET("avx512f,vpclmulqdq,pclmul")
+        block innerProductVpclmul(const block* a, const block* b, u64 n)
+        {
+            __m512i lo = _mm512_setzero_si512(), hi = lo, mid = lo;
+            u64 main = n / 4 * 4;
+            for (u64 i = 0; i < main; i += 4)
+            {
+                __m512i va = _mm512_loadu_si512(a + i);
+                __m512i vb = _mm512_loadu_si512(b + i);
+                __m512i aa = _mm512_xor_si512(va, _mm512_shuffle_epi32(va, _MM_PERM_BADC));
+                __m512i bb = _mm512_xor_si512(vb, _mm512_shuffle_epi32(vb, _MM_PERM_BADC));
+                lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(va, vb, 0x00));
+                hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(va, vb, 0x11));
+                mid = _mm512_xor_si512(mid, _mm512_clmulepi64_epi128(aa, bb, 0x00));
+            }
+
+            block l = ZeroBlock, h = ZeroBlock, m = ZeroBlock;
+            alignas(64) block lanes[3][4];
+            _mm512_store_si512(lanes[0], lo);
+            _mm512_store_si512(lanes[1], hi);
+            _mm512_store_si512(lanes[2], mid);
+            for (u64 j = 0; j < 4; ++j)
+            {
+                l = _mm_xor_si128(l, lanes[0][j]);
+                h = _mm_xor_si128(h, lanes[1][j]);
+                m = _mm_xor_si128(m, lanes[2][j]);
+            }
+            m = _mm_xor_si128(m, _mm_xor_si128(l, h));
+            l = _mm_xor_si128(l, _mm_slli_si128(m, 8));
+            h = _mm_xor_si128(h, _mm_srli_si128(m, 8));
+
+            for (u64 i = main; i < n; ++i)
+            {
+                block pl, ph;
+                mulUnreducedPclmul(a[i], b[i], pl, ph);
+                l = _mm_xor_si128(l, pl);
+                h = _mm_xor_si128(h, ph);
+            }
+            return reducePclmul(l, h);
+        }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+    }
+
+    void gf128MulUnreduced(const block& a, const block& b, block& lo, block& hi)
+    {
+        if (cpuFeatures().mPCLMUL)
+            mulUnreducedPclmul(a, b, lo, hi);
+        else
+            mulUnreducedPortable(a, b, lo, hi);
+    }
+
+    block gf128Reduce(const block& lo, const block& hi)
+    {
+        if (cpuFeatures().mPCLMUL)
+            return reducePclmul(lo, hi);
+        else
+            return reducePortable(lo, hi);
+    }
+
+    block gf128Mul(const block& a, const block& b)
+    {
+        if (cpuFeatures().mPCLMUL)
+            return mulPclmul(a, b);
+
+        block lo, hi;
+        mulUnreducedPortable(a, b, lo, hi);
+        return reducePortable(lo, hi);
+    }
+
+    block gf128Square(const block& a)
+    {
+        return gf128Mul(a, a);
+    }
+
+    block gf128Pow(const block& a, u64 e)
+    {
+        block ret = OneBlock, base = a;
+        for (; e; e >>= 1)
+        {
+            if (e & 1)
+                ret = gf128Mul(ret, base);
+            base = gf128Square(base);
+        }
+        return ret;
+    }
+
+    block gf128Inverse(const block& a)
+    {
+        if (eq(a, ZeroBlock))
+            throw std::runtime_error("zero has no inverse. " LOCATION);
+
+        // a^-1 = a^(2^128 - 2) = (a^(2^127 - 1))^2. With b_k = a^(2^k - 1),
+        // b_2k = b_k^(2^k) b_k and b_k+1 = b_k^2 a walk the bits of 127.
+        block b = a;
+        u64 k = 1;
+        for (int bit = 5; bit >= 0; --bit)
+        {
+            block t = b;
+            for (u64 i = 0; i < k; ++i)
+                t = gf128Square(t);
+            b = gf128Mul(t, b);
+            k *= 2;
+
+            if ((127 >> bit) & 1)
+            {
+                b = gf128Mul(gf128Square(b), a);
+                ++k;
+            }
+        }
+        return gf128Square(b);
+    }
+
+    block gf128InnerProduct(span<const block> a, span<const block> b)
+    {
+        if (a.size() != b.size())
+            throw RTE_LOC;
+
+        static const CpuDispatch<block(const block*, const block*, u64)> kernel{
+#ifdef OC_HAVE_VAES
+            { innerProductVpclmul, { &CpuFeatures::mVPCLMUL, &CpuFeatures::mAVX512F, &CpuFeatures::mPCLMUL } },
+#endif
+            { innerProductPclmul, { &CpuFeatures::mPCLMUL } },
+            { innerProductPortable, {} } };
+        return kernel(a.data(), b.data(), a.size());
+    }
+
+    void gf128Mul(span<const block> a, const block& b, span<block> out)
+    {
+        if (a.size() != out.size())
+            throw RTE_LOC;
+
+        if (cpuFeatures().mPCLMUL)
+            mulManyPclmul(a.data(), b, out.data(), a.size());
+        else
+            for (u64 i = 0; i < u64(a.size()); ++i)
+                out[i] = gf128Mul(a[i], b);
+    }
+
+    void gf128Powers(const block& x, span<block> powers)
+    {
+        // the first 8 one after the other, then each from the one 8 before
+        // so that the products are independent.
+        const u64 step = 8;
+        u64 n = powers.size();
+        for (u64 i = 0; i < std::min(n, step); ++i)
+            powers[i] = i ? gf128Mul(powers[i - 1], x) : OneBlock;
+
+        if (n > step)
+        {
+            block xStep = gf128Mul(powers[step - 1], x);
+            for (u64 i = step; i < n; i += step)
+            {
+                u64 size = std::min(step, n - i);
+                gf128Mul(powers.subspan(i - step, size), xStep, powers.subspan(i, size));
+            }
+        }
+    }
+}
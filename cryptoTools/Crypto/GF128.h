@@ -0,0 +1,41 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+
+namespace osuCrypto
+{
+    // Arithmetic in GF(2^128) = GF(2)[x] / (x^128 + x^7 + x^2 + x + 1). Bit i
+    // of a block, i.e. bit i % 64 of its 64 bit word i / 64, is the
+    // coefficient of x^i, so OneBlock is 1 and toBlock(1, 0) is x^64. Addition
+    // is xor. The products use PCLMULQDQ when the CPU has it and the batched
+    // ones VPCLMULQDQ on four elements at a time with AVX-512.
+
+    // Returns a * b.
+    block gf128Mul(const block& a, const block& b);
+
+    // Returns a * a.
+    block gf128Square(const block& a);
+
+    // Returns a^e.
+    block gf128Pow(const block& a, u64 e);
+
+    // Returns the inverse of a, which must not be zero.
+    block gf128Inverse(const block& a);
+
+    // The 256 bit product of a and b as polynomials, lo holding the
+    // coefficients of x^0 to x^127 and hi those of x^128 to x^255. Sums of
+    // such products can be reduced once at the end with gf128Reduce.
+    void gf128MulUnreduced(const block& a, const block& b, block& lo, block& hi);
+
+    // Returns lo + hi * x^128 reduced modulo the field polynomial.
+    block gf128Reduce(const block& lo, const block& hi);
+
+    // Returns sum_i a[i] * b[i], with a single reduction at the end.
+    block gf128InnerProduct(span<const block> a, span<const block> b);
+
+    // Sets out[i] = a[i] * b for all i. in and out may alias.
+    void gf128Mul(span<const block> a, const block& b, span<block> out);
+
+    // Sets powers[i] = x^i for all i, where x is any field element.
+    void gf128Powers(const block& x, span<block> powers);
+}
@@ -0,0 +1,142 @@
+#include <cryptoTools/Crypto/GgmTree.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace osuCrypto
+{
+    const std::array<AES, 2> GgmTree::Aes = { {
+        AES(toBlock(0x7b2c1d5e9a3f4861, 0x0f1e2d3c4b5a6978)),
+        AES(toBlock(0x3c9d2e8f1a6b5c47, 0x8796a5b4c3d2e1f0)) } };
+
+    namespace
+    {
+        // The number of levels of a subtree that fits into the L1 cache.
+        const u64 cacheLevels = 10;
+
+        // Replaces the n parents at data with their 2n children. The parents are
+        // read a batch at a time from the back, so no unread parent is overwritten.
+        void expandLevel(block* data, u64 n)
+        {
+            const u64 batch = 64;
+            std::array<block, batch> left, right;
+
+            for (u64 end = n; end; )
+            {
+                u64 size = std::min(batch, end);
+                u64 begin = end - size;
+
+                GgmTree::Aes[0].hashBlocks(data + begin, size, left.data());
+                GgmTree::Aes[1].hashBlocks(data + begin, size, right.data());
+
+                for (u64 i = 0; i < size; ++i)
+                {
+                    data[2 * (begin + i)] = left[i];
+                    data[2 * (begin + i) + 1] = right[i];
+                }
+                end = begin;
+            }
+        }
+
+        void expandBreadthFirst(block* data, u64 n, u64 levels)
+        {
+            for (u64 i = 0; i < levels; ++i)
+                expandLevel(data, n << i);
+        }
+
+        // Moves the n nodes at data to data[s * 2^levels], the first leaf of
+        // their subtrees, from the back so that no node is overwritten.
+        void spreadRoots(block* data, u64 n, u64 levels)
+        {
+            for (u64 s = n; s-- > 1; )
+                data[s << levels] = data[s];
+        }
+
+        void expandDepthFirst(block* data, u64 n, u64 levels)
+        {
+            if (levels <= cacheLevels)
+                return expandBreadthFirst(data, n, levels);
+
+            u64 top = levels - cacheLevels;
+            expandBreadthFirst(data, n, top);
+
+            n <<= top;
+            spreadRoots(data, n, cacheLevels);
+            for (u64 s = 0; s < n; ++s)
+                expandBreadthFirst(data + (s << cacheLevels), 1, cacheLevels);
+        }
+    }
+
+    void GgmTree::expand(span<const block> roots, u64 depth, span<block> leaves,
+        Layout layout, u64 numThreads)
+    {
+        u64 n = roots.size();
+        if (depth >= 64 || u64(leaves.size()) != (n << depth))
+            throw std::runtime_error("leaves must have size roots.size() * 2^depth " LOCATION);
+
+        auto expandSubtrees = layout == Layout::DepthFirst ? expandDepthFirst : expandBreadthFirst;
+        std::copy(roots.begin(), roots.end(), leaves.begin());
+
+        // a thread is not worth starting for fewer than 2^cacheLevels leaves.
+        numThreads = std::min(numThreads, u64(leaves.size()) >> cacheLevels);
+        if (numThreads < 2)
+            return expandSubtrees(leaves.data(), n, depth);
+
+        // expand the first levels until every thread gets a few subtrees.
+        u64 top = 0;
+        while (top < depth && (n << top) < 4 * numThreads)
+            ++top;
+        expandBreadthFirst(leaves.data(), n, top);
+
+        n <<= top;
+        u64 levels = depth - top;
+        spreadRoots(leaves.data(), n, levels);
+
+        auto routine = [&](u64 t)
+        {
+            for (u64 s = n * t / numThreads; s < n * (t + 1) / numThreads; ++s)
+                expandSubtrees(leaves.data() + (s << levels), 1, levels);
+        };
+
+        std::vector<std::thread> thrds;
+        for (u64 t = 1; t < numThreads; ++t)
+            thrds.emplace_back(routine, t);
+        routine(0);
+        for (auto& thrd : thrds)
+            thrd.join();
+    }
+
+    void GgmTree::puncture(const block& root, u64 depth, u64 point, span<block> copath)
+    {
+        if (u64(copath.size()) != depth || (depth < 64 && (point >> depth)))
+            throw RTE_LOC;
+
+        block node = root;
+        for (u64 i = 0; i < depth; ++i)
+        {
+            u64 bit = (point >> (depth - 1 - i)) & 1;
+            copath[i] = Aes[bit ^ 1].hashBlock(node);
+            node = Aes[bit].hashBlock(node);
+        }
+    }
+
+    void GgmTree::expandPunctured(span<const block> copath, u64 point, span<block> leaves,
+        Layout layout, u64 numThreads)
+    {
+        u64 depth = copath.size();
+        if (depth >= 64 || u64(leaves.size()) != (u64(1) << depth) || (point >> depth))
+            throw RTE_LOC;
+
+        // the sibling at level i + 1 is the root of a subtree of depth - 1 - i levels.
+        for (u64 i = 0; i < depth; ++i)
+        {
+            u64 levels = depth - 1 - i;
+            u64 sibling = (point >> levels) ^ 1;
+            expand(copath.subspan(i, 1), levels, leaves.subspan(sibling << levels, u64(1) << levels),
+                layout, numThreads);
+        }
+
+        leaves[point] = ZeroBlock;
+    }
+}
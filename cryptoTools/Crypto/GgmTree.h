@@ -0,0 +1,45 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/AES.h>
+
+namespace osuCrypto
+{
+    // Expands seeds into the leaves of GGM trees. The length doubling PRG is
+    // G(s) = (H_0(s), H_1(s)) where H_b(s) = AES_b(s) ^ s for two fixed keys.
+    // The children of the nodes of a level are computed with AES::hashBlocks
+    // in batches, so that 8 or more AES are in flight. Leaf j of a tree of
+    // the given depth is reached by the bits of j, most significant first.
+    class GgmTree
+    {
+    public:
+        enum class Layout
+        {
+            // One level of the whole tree after the other.
+            BreadthFirst,
+
+            // Breadth first down to subtrees that fit into the L1 cache, each
+            // of which is then expanded on its own.
+            DepthFirst
+        };
+
+        // The keys of H_0 and H_1.
+        static const std::array<AES, 2> Aes;
+
+        // Expands each root into the 2^depth leaves of its tree. The leaves of
+        // roots[t] are leaves[t * 2^depth, (t + 1) * 2^depth). With numThreads > 1
+        // the subtrees below the first few levels are divided over the threads.
+        static void expand(span<const block> roots, u64 depth, span<block> leaves,
+            Layout layout = Layout::DepthFirst, u64 numThreads = 1);
+
+        // Writes to copath[i] the sibling of the node at level i + 1 on the path
+        // from root to leaf point, for i < depth. This punctures the tree at point.
+        static void puncture(const block& root, u64 depth, u64 point, span<block> copath);
+
+        // Expands the tree punctured at point given its co-path, see puncture(...).
+        // All leaves but leaves[point], which is set to zero, are the same as for
+        // the full tree.
+        static void expandPunctured(span<const block> copath, u64 point, span<block> leaves,
+            Layout layout = Layout::DepthFirst, u64 numThreads = 1);
+    };
+}
@@ -0,0 +1,437 @@
+#include <cryptoTools/Crypto/Mersenne.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <immintrin.h>
+
+namespace osuCrypto
+{
+    namespace
+    {
+        const u64 mask63 = ~0ULL >> 1;
+
+        // Returns the low 64 bits of a * b and sets hi to the high 64 bits.
+        inline u64 mul64(u64 a, u64 b, u64& hi)
+        {
+#ifdef _MSC_VER
+            return _umul128(a, b, &hi);
+#else
+            unsigned __int128 p = (unsigned __int128)a * b;
+            hi = u64(p >> 64);
+            return u64(p);
+#endif
+        }
+
+        // x += y + carry, returning the new carry.
+        inline u64 addCarry(u64& x, u64 y, u64 carry)
+        {
+            unsigned long long s;
+            u64 c = _addcarry_u64((unsigned char)carry, x, y, &s);
+            x = s;
+            return c;
+        }
+
+        // ---------------------------- 2^61 - 1 ----------------------------
+
+        const u64 p61 = Mersenne61::Modulus;
+
+        // x mod p for x < 2^63, as the 4 lanes of x.
+        OC_TARGET("avx2")
+        inline __m256i reduce61Avx2(__m256i x)
+        {
+            const __m256i p = _mm256_set1_epi64x(p61);
+            x = _mm256_add_epi64(_mm256_and_si256(x, p), _mm256_srli_epi64(x, 61));
+            __m256i t = _mm256_sub_epi64(x, p);
+            __m256i neg = _mm256_cmpgt_epi64(_mm256_setzero_si256(), t);
+            return _mm256_add_epi64(t, _mm256_and_si256(p, neg));
+        }
+
+        // a * b mod p from four 32 bit products. With a = ah 2^32 + al, the
+        // middle product m = al bh + ah bl is split at bit 29 since m 2^32 =
+        // (m >> 29) 2^61 + (m mod 2^29) 2^32, and ah bh 2^64 = 8 ah bh.
+        OC_TARGET("avx2")
+        inline __m256i mul61Avx2(__m256i a, __m256i b)
+        {
+            const __m256i p = _mm256_set1_epi64x(p61);
+            __m256i ah = _mm256_srli_epi64(a, 32);
+            __m256i bh = _mm256_srli_epi64(b, 32);
+            __m256i ll = _mm256_mul_epu32(a, b);
+            __m256i m = _mm256_add_epi64(_mm256_mul_epu32(a, bh), _mm256_mul_epu32(ah, b));
+            __m256i hh = _mm256_mul_epu32(ah, bh);
+
+            __m256i s = _mm256_add_epi64(_mm256_slli_epi64(hh, 3), _mm256_srli_epi64(m, 29));
+            s = _mm256_add_epi64(s, _mm256_slli_epi64(_mm256_and_si256(m, _mm256_set1_epi64x((1 << 29) - 1)), 32));
+            s = _mm256_add_epi64(s, _mm256_srli_epi64(ll, 61));
+            s = _mm256_add_epi64(s, _mm256_and_si256(ll, p));
+            return reduce61Avx2(s);
+        }
+
+        // out[i] = f(a[i], b[i]) four at a time, returning how many were done.
+        template<typename Op>
+        OC_TARGET("avx2")
+        u64 apply61Avx2(const u64* a, const u64* b, u64* out, u64 n, Op op)
+        {
+            u64 i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                __m256i x = _mm256_loadu_si256((__m256i*)(a + i));
+                __m256i y = _mm256_loadu_si256((__m256i*)(b + i));
+                _mm256_storeu_si256((__m256i*)(out + i), op(x, y, i));
+            }
+            return i;
+        }
+
+        struct Add61Avx2
+        {
+            OC_TARGET("avx2")
+            __m256i operator()(__m256i a, __m256i b, u64) const { return reduce61Avx2(_mm256_add_epi64(a, b)); }
+        };
+
+        struct Sub61Avx2
+        {
+            OC_TARGET("avx2")
+            __m256i operator()(__m256i a, __m256i b, u64) const
+            {
+                return reduce61Avx2(_mm256_add_epi64(_mm256_sub_epi64(a, b), _mm256_set1_epi64x(p61)));
+            }
+        };
+
+        struct Mul61Avx2
+        {
+            OC_TARGET("avx2")
+            __m256i operator()(__m256i a, __m256i b, u64) const { return mul61Avx2(a, b); }
+        };
+
+        struct MulAdd61Avx2
+        {
+            const u64* acc;
+            OC_TARGET("avx2")
+            __m256i operator()(__m256i a, __m256i b, u64 i) const
+            {
+                __m256i c = _mm256_loadu_si256((__m256i*)(acc + i));
+                return reduce61Avx2(_mm256_add_epi64(c, mul61Avx2(a, b)));
+            }
+        };
+
+        void checkSizes(u64 a, u64 b, u64 out)
+        {
+            if (a != b || a != out)
+                throw std::runtime_error("the spans must have the same size. " LOCATION);
+        }
+
+        // ---------------------------- 2^127 - 1 ---------------------------
+
+        inline void split(const block& x, u64& lo, u64& hi)
+        {
+            lo = _mm_cvtsi128_si64(x);
+            hi = _mm_extract_epi64(x, 1);
+        }
+
+        // x mod p for any 128 bit x = (hi, lo), using 2^127 = 1 and then that
+        // x >= p iff x + 1 >= 2^127 for x <= 2^127.
+        inline block reduce127(u64 lo, u64 hi)
+        {
+            u64 t = hi >> 63;
+            hi &= mask63;
+            hi += addCarry(lo, t, 0);
+
+            u64 lo1 = lo, hi1 = hi;
+            hi1 += addCarry(lo1, 1, 0);
+            u64 ge = 0 - (hi1 >> 63);
+            lo = (lo1 & ge) | (lo & ~ge);
+            hi = ((hi1 & mask63) & ge) | (hi & ~ge);
+            return toBlock(hi, lo);
+        }
+
+        // The 254 bit product of a and b.
+        inline void mul127Wide(const block& a, const block& b, u64 w[4])
+        {
+            u64 a0, a1, b0, b1;
+            split(a, a0, a1);
+            split(b, b0, b1);
+
+            u64 h00, h01, h10, h11;
+            w[0] = mul64(a0, b0, h00);
+            u64 l01 = mul64(a0, b1, h01);
+            u64 l10 = mul64(a1, b0, h10);
+            u64 l11 = mul64(a1, b1, h11);
+
+            w[1] = h00;
+            u64 c0 = addCarry(w[1], l01, 0);
+            u64 c1 = addCarry(w[1], l10, 0);
+            w[2] = l11;
+            u64 c2 = addCarry(w[2], h01, c0);
+            c2 += addCarry(w[2], h10, c1);
+            w[3] = h11 + c2;
+        }
+
+        // w mod p for w < 2^254, as the sum of its two 127 bit halves.
+        inline block reduce254(const u64 w[4])
+        {
+            u64 lo = w[0], hi = w[1] & mask63;
+            u64 c0 = (w[1] >> 63) | (w[2] << 1);
+            u64 c1 = (w[2] >> 63) | (w[3] << 1);
+            hi += addCarry(lo, c0, 0);
+            hi += c1;
+            return reduce127(lo, hi);
+        }
+    }
+
+    // ------------------------------ Mersenne61 ------------------------------
+
+    Mersenne61 Mersenne61::pow(u64 e) const
+    {
+        Mersenne61 ret(1), x = *this;
+        while (e)
+        {
+            if (e & 1)
+                ret *= x;
+            x *= x;
+            e >>= 1;
+        }
+        return ret;
+    }
+
+    Mersenne61 Mersenne61::inverse() const
+    {
+        if (mVal == 0)
+            throw std::runtime_error("zero has no inverse. " LOCATION);
+        return pow(Modulus - 2);
+    }
+
+    void Mersenne61::add(span<const u64> a, span<const u64> b, span<u64> out)
+    {
+        checkSizes(a.size(), b.size(), out.size());
+        u64 n = out.size(), i = 0;
+        if (cpuFeatures().mAVX2)
+            i = apply61Avx2(a.data(), b.data(), out.data(), n, Add61Avx2{});
+        for (; i < n; ++i)
+            out[i] = add(a[i], b[i]);
+    }
+
+    void Mersenne61::sub(span<const u64> a, span<const u64> b, span<u64> out)
+    {
+        checkSizes(a.size(), b.size(), out.size());
+        u64 n = out.size(), i = 0;
+        if (cpuFeatures().mAVX2)
+            i = apply61Avx2(a.data(), b.data(), out.data(), n, Sub61Avx2{});
+        for (; i < n; ++i)
+            out[i] = sub(a[i], b[i]);
+    }
+
+    void Mersenne61::mul(span<const u64> a, span<const u64> b, span<u64> out)
+    {
+        checkSizes(a.size(), b.size(), out.size());
+        u64 n = out.size(), i = 0;
+        if (cpuFeatures().mAVX2)
+            i = apply61Avx2(a.data(), b.data(), out.data(), n, Mul61Avx2{});
+        for (; i < n; ++i)
+            out[i] = mul(a[i], b[i]);
+    }
+
+    void Mersenne61::mul(span<const u64> a, u64 b, span<u64> out)
+    {
+        checkSizes(a.size(), a.size(), out.size());
+        for (u64 i = 0; i < u64(out.size()); ++i)
+            out[i] = mul(a[i], b);
+    }
+
+    void Mersenne61::mulAdd(span<const u64> a, span<const u64> b, span<u64> acc)
+    {
+        checkSizes(a.size(), b.size(), acc.size());
+        u64 n = acc.size(), i = 0;
+        if (cpuFeatures().mAVX2)
+            i = apply61Avx2(a.data(), b.data(), acc.data(), n, MulAdd61Avx2{ acc.data() });
+        for (; i < n; ++i)
+            acc[i] = add(acc[i], mul(a[i], b[i]));
+    }
+
+    u64 Mersenne61::innerProduct(span<const u64> a, span<const u64> b)
+    {
+        checkSizes(a.size(), b.size(), a.size());
+
+        // 32 products of less than 2^122 each fit in 128 bits.
+        u64 ret = 0, n = a.size();
+        for (u64 i = 0; i < n; i += 32)
+        {
+            u64 end = std::min<u64>(n, i + 32);
+            u64 lo = 0, hi = 0;
+            for (u64 j = i; j < end; ++j)
+            {
+                u64 h, l = mul64(a[j], b[j], h);
+                hi += h + addCarry(lo, l, 0);
+            }
+
+            // lo + 2^64 hi = c0 + 2^61 c1 + 2^122 c2.
+            u64 c0 = lo & Modulus;
+            u64 c1 = ((lo >> 61) | (hi << 3)) & Modulus;
+            u64 c2 = hi >> 58;
+            ret = add(ret, reduce(c0 + c1 + c2));
+        }
+        return ret;
+    }
+
+    void Mersenne61::sample(PRNG& prng, span<u64> out)
+    {
+        // 61 random bits are uniform unless they are all ones, which is
+        // redrawn.
+        prng.get(out.data(), out.size());
+        for (auto& x : out)
+        {
+            x &= Modulus;
+            while (x == Modulus)
+                x = prng.get<u64>() & Modulus;
+        }
+    }
+
+    Mersenne61 Mersenne61::sample(PRNG& prng)
+    {
+        Mersenne61 ret;
+        sample(prng, span<u64>(&ret.mVal, 1));
+        return ret;
+    }
+
+    // ------------------------------ Mersenne127 -----------------------------
+
+    const block Mersenne127::Modulus = toBlock(mask63, ~0ULL);
+
+    Mersenne127 Mersenne127::pow(u64 e) const
+    {
+        Mersenne127 ret(1), x = *this;
+        while (e)
+        {
+            if (e & 1)
+                ret *= x;
+            x *= x;
+            e >>= 1;
+        }
+        return ret;
+    }
+
+    Mersenne127 Mersenne127::inverse() const
+    {
+        if (eq(mVal, ZeroBlock))
+            throw std::runtime_error("zero has no inverse. " LOCATION);
+
+        // x^(p - 2) where p - 2 = 2^127 - 3 has all bits set except bit 1.
+        Mersenne127 ret(1), x = *this;
+        for (u64 i = 0; i < 127; ++i)
+        {
+            if (i != 1)
+                ret *= x;
+            x *= x;
+        }
+        return ret;
+    }
+
+    block Mersenne127::reduce(const block& x)
+    {
+        u64 lo, hi;
+        split(x, lo, hi);
+        return reduce127(lo, hi);
+    }
+
+    block Mersenne127::add(const block& a, const block& b)
+    {
+        u64 lo, hi, lo1, hi1;
+        split(a, lo, hi);
+        split(b, lo1, hi1);
+        hi += hi1 + addCarry(lo, lo1, 0);
+        return reduce127(lo, hi);
+    }
+
+    block Mersenne127::sub(const block& a, const block& b)
+    {
+        // a + (p - b), where p - b is b with its 127 bits flipped.
+        u64 lo, hi, lo1, hi1;
+        split(a, lo, hi);
+        split(b, lo1, hi1);
+        hi += (~hi1 & mask63) + addCarry(lo, ~lo1, 0);
+        return reduce127(lo, hi);
+    }
+
+    block Mersenne127::mul(const block& a, const block& b)
+    {
+        u64 w[4];
+        mul127Wide(a, b, w);
+        return reduce254(w);
+    }
+
+    void Mersenne127::add(span<const block> a, span<const block> b, span<block> out)
+    {
+        checkSizes(a.size(), b.size(), out.size());
+        for (u64 i = 0; i < u64(out.size()); ++i)
+            out[i] = add(a[i], b[i]);
+    }
+
+    void Mersenne127::sub(span<const block> a, span<const block> b, span<block> out)
+    {
+        checkSizes(a.size(), b.size(), out.size());
+        for (u64 i = 0; i < u64(out.size()); ++i)
+            out[i] = sub(a[i], b[i]);
+    }
+
+    void Mersenne127::mul(span<const block> a, span<const block> b, span<block> out)
+    {
+        checkSizes(a.size(), b.size(), out.size());
+        for (u64 i = 0; i < u64(out.size()); ++i)
+            out[i] = mul(a[i], b[i]);
+    }
+
+    void Mersenne127::mul(span<const block> a, const block& b, span<block> out)
+    {
+        checkSizes(a.size(), a.size(), out.size());
+        for (u64 i = 0; i < u64(out.size()); ++i)
+            out[i] = mul(a[i], b);
+    }
+
+    void Mersenne127::mulAdd(span<const block> a, span<const block> b, span<block> acc)
+    {
+        checkSizes(a.size(), b.size(), acc.size());
+        for (u64 i = 0; i < u64(acc.size()); ++i)
+            acc[i] = add(acc[i], mul(a[i], b[i]));
+    }
+
+    block Mersenne127::innerProduct(span<const block> a, span<const block> b)
+    {
+        checkSizes(a.size(), b.size(), a.size());
+
+        // the 64 bits above the 256 bit sum count its carries. Each product
+        // is below 2^254, so for fewer than 2^64 products s[4] < 2^62 and
+        // the bits of the sum above 2^254 fit in a u64.
+        u64 s[5] = { 0, 0, 0, 0, 0 };
+        for (u64 i = 0; i < u64(a.size()); ++i)
+        {
+            u64 w[4];
+            mul127Wide(a[i], b[i], w);
+            u64 c = addCarry(s[0], w[0], 0);
+            c = addCarry(s[1], w[1], c);
+            c = addCarry(s[2], w[2], c);
+            c = addCarry(s[3], w[3], c);
+            s[4] += c;
+        }
+
+        // s = c0 + 2^254 c2, where c0 is the low 254 bits.
+        u64 c2 = (s[3] >> 62) | (s[4] << 2);
+        s[3] &= ~0ULL >> 2;
+        return add(reduce254(s), toBlock(0, c2));
+    }
+
+    void Mersenne127::sample(PRNG& prng, span<block> out)
+    {
+        // 127 random bits are uniform unless they are all ones, which is
+        // redrawn.
+        prng.get(out.data(), out.size());
+        for (auto& x : out)
+        {
+            x = x & Modulus;
+            while (eq(x, Modulus))
+                x = prng.get<block>() & Modulus;
+        }
+    }
+
+    Mersenne127 Mersenne127::sample(PRNG& prng)
+    {
+        Mersenne127 ret;
+        sample(prng, span<block>(&ret.mVal, 1));
+        return ret;
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/PRNG.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace osuCrypto
+{
+    // The prime fields modulo p = 2^61 - 1 and p = 2^127 - 1. Since 2^k = 1
+    // mod p for k = 61 resp. 127, a product is reduced by adding its high
+    // bits to its low bits, with a final conditional subtraction that is done
+    // with a mask rather than a branch. The batched operations work on arrays
+    // of reduced elements, i.e. u64 in [0, 2^61 - 1) and blocks in
+    // [0, 2^127 - 1) with the low 64 bits in the first word.
+
+    class Mersenne61
+    {
+    public:
+        static const u64 Modulus = (1ULL << 61) - 1;
+
+        Mersenne61() = default;
+
+        // Any u64, which is reduced.
+        Mersenne61(u64 v) : mVal(reduce(v)) {}
+
+        u64 value() const { return mVal; }
+
+        Mersenne61 operator+(const Mersenne61& b) const { return fromReduced(add(mVal, b.mVal)); }
+        Mersenne61 operator-(const Mersenne61& b) const { return fromReduced(sub(mVal, b.mVal)); }
+        Mersenne61 operator*(const Mersenne61& b) const { return fromReduced(mul(mVal, b.mVal)); }
+        Mersenne61 operator-() const { return fromReduced(sub(0, mVal)); }
+        Mersenne61& operator+=(const Mersenne61& b) { mVal = add(mVal, b.mVal); return *this; }
+        Mersenne61& operator-=(const Mersenne61& b) { mVal = sub(mVal, b.mVal); return *this; }
+        Mersenne61& operator*=(const Mersenne61& b) { mVal = mul(mVal, b.mVal); return *this; }
+        bool operator==(const Mersenne61& b) const { return mVal == b.mVal; }
+        bool operator!=(const Mersenne61& b) const { return mVal != b.mVal; }
+
+        // Returns this^e.
+        Mersenne61 pow(u64 e) const;
+
+        // Returns the inverse, which must exist, i.e. this must not be zero.
+        Mersenne61 inverse() const;
+
+        // Returns x mod p for any x.
+        static u64 reduce(u64 x)
+        {
+            return condSub((x & Modulus) + (x >> 61));
+        }
+
+        // a + b, a - b and a * b for reduced a and b.
+        static u64 add(u64 a, u64 b) { return condSub(a + b); }
+        static u64 sub(u64 a, u64 b) { return condSub(a - b + Modulus); }
+        static u64 mul(u64 a, u64 b)
+        {
+            u64 hi, lo = mul64(a, b, hi);
+            return condSub((lo & Modulus) + ((lo >> 61) | (hi << 3)));
+        }
+
+        // Sets out[i] to a[i] + b[i], a[i] - b[i] and a[i] * b[i]. out may
+        // alias a or b.
+        static void add(span<const u64> a, span<const u64> b, span<u64> out);
+        static void sub(span<const u64> a, span<const u64> b, span<u64> out);
+        static void mul(span<const u64> a, span<const u64> b, span<u64> out);
+
+        // Sets out[i] = a[i] * b for all i.
+        static void mul(span<const u64> a, u64 b, span<u64> out);
+
+        // Sets acc[i] += a[i] * b[i] for all i.
+        static void mulAdd(span<const u64> a, span<const u64> b, span<u64> acc);
+
+        // Returns sum_i a[i] * b[i]. The products are summed unreduced in
+        // 128 bits and reduced once per 32 products.
+        static u64 innerProduct(span<const u64> a, span<const u64> b);
+
+        // Fills out with uniform field elements.
+        static void sample(PRNG& prng, span<u64> out);
+        static Mersenne61 sample(PRNG& prng);
+
+        u64 mVal = 0;
+
+    private:
+        static Mersenne61 fromReduced(u64 v) { Mersenne61 r; r.mVal = v; return r; }
+
+        // x mod p for x < 2p.
+        static u64 condSub(u64 x)
+        {
+            u64 t = x - Modulus;
+            return t + (Modulus & (0 - (t >> 63)));
+        }
+
+        // Returns the low 64 bits of a * b and sets hi to the high 64 bits.
+        static u64 mul64(u64 a, u64 b, u64& hi)
+        {
+#ifdef _MSC_VER
+            return _umul128(a, b, &hi);
+#else
+            unsigned __int128 p = (unsigned __int128)a * b;
+            hi = u64(p >> 64);
+            return u64(p);
+#endif
+        }
+    };
+
+    class Mersenne127
+    {
+    public:
+        // 2^127 - 1.
+        static const block Modulus;
+
+        Mersenne127() = default;
+
+        // Any block, which is reduced.
+        Mersenne127(const block& v) : mVal(reduce(v)) {}
+        Mersenne127(u64 v) : mVal(toBlock(0, v)) {}
+
+        const block& value() const { return mVal; }
+
+        Mersenne127 operator+(const Mersenne127& b) const { return fromReduced(add(mVal, b.mVal)); }
+        Mersenne127 operator-(const Mersenne127& b) const { return fromReduced(sub(mVal, b.mVal)); }
+        Mersenne127 operator*(const Mersenne127& b) const { return fromReduced(mul(mVal, b.mVal)); }
+        Mersenne127 operator-() const { return fromReduced(sub(ZeroBlock, mVal)); }
+        Mersenne127& operator+=(const Mersenne127& b) { mVal = add(mVal, b.mVal); return *this; }
+        Mersenne127& operator-=(const Mersenne127& b) { mVal = sub(mVal, b.mVal); return *this; }
+        Mersenne127& operator*=(const Mersenne127& b) { mVal = mul(mVal, b.mVal); return *this; }
+        bool operator==(const Mersenne127& b) const { return eq(mVal, b.mVal); }
+        bool operator!=(const Mersenne127& b) const { return neq(mVal, b.mVal); }
+
+        // Returns this^e.
+        Mersenne127 pow(u64 e) const;
+
+        // Returns the inverse, which must exist, i.e. this must not be zero.
+        Mersenne127 inverse() const;
+
+        // Returns x mod p for any x.
+        static block reduce(const block& x);
+
+        // a + b, a - b and a * b for reduced a and b.
+        static block add(const block& a, const block& b);
+        static block sub(const block& a, const block& b);
+        static block mul(const block& a, const block& b);
+
+        // Sets out[i] to a[i] + b[i], a[i] - b[i] and a[i] * b[i]. out may
+        // alias a or b.
+        static void add(span<const block> a, span<const block> b, span<block> out);
+        static void sub(span<const block> a, span<const block> b, span<block> out);
+        static void mul(span<const block> a, span<const block> b, span<block> out);
+
+        // Sets out[i] = a[i] * b for all i.
+        static void mul(span<const block> a, const block& b, span<block> out);
+
+        // Sets acc[i] += a[i] * b[i] for all i.
+        static void mulAdd(span<const block> a, span<const block> b, span<block> acc);
+
+        // Returns sum_i a[i] * b[i]. The 254 bit products are summed in 320
+        // bits and reduced once at the end.
+        static block innerProduct(span<const block> a, span<const block> b);
+
+        // Fills out with uniform field elements.
+        static void sample(PRNG& prng, span<block> out);
+        static Mersenne127 sample(PRNG& prng);
+
+        block mVal = ZeroBlock;
+
+    private:
+        static Mersenne127 fromReduced(const block& v) { Mersenne127 r; r.mVal = v; return r; }
+    };
+}
@@ -1,11 +1,35 @@
 #include <cryptoTools/Crypto/PRNG.h>
+#include <cryptoTools/Crypto/PRNGBackends.h>
 #include <cryptoTools/Common/Log.h>
+#include <cryptoTools/Common/BitVector.h>
 #include <algorithm>
 #include <cstring>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace osuCrypto {
 
-    PRNG::PRNG(const block& seed, u64 bufferSize)
+    namespace
+    {
+        // Returns the high 64 bits of a * b and sets lo to the low 64 bits.
+        inline u64 mul64(u64 a, u64 b, u64& lo)
+        {
+#ifdef _MSC_VER
+            u64 hi;
+            lo = _umul128(a, b, &hi);
+            return hi;
+#else
+            unsigned __int128 p = (unsigned __int128)a * b;
+            lo = u64(p);
+            return u64(p >> 64);
+#endif
+        }
+    }
+
+    template<typename Backend>
+    BasicPRNG<Backend>::BasicPRNG(const block& seed, u64 bufferSize)
         :
         mBytesIdx(0),
         mBlockIdx(0)
@@ -13,9 +37,10 @@ namespace osuCrypto {
 		SetSeed(seed, bufferSize);
     }
 
-    PRNG::PRNG(PRNG && s) :
+    template<typename Backend>
+    BasicPRNG<Backend>::BasicPRNG(BasicPRNG && s) :
         mBuffer(std::move(s.mBuffer)),
-        mAes(std::move(s.mAes)),
+        mBackend(std::move(s.mBackend)),
         mBytesIdx(s.mBytesIdx),
         mBlockIdx(s.mBlockIdx),
         mBufferByteCapacity(s.mBufferByteCapacity)
@@ -26,10 +51,11 @@ namespace osuCrypto {
         s.mBufferByteCapacity = 0;
     }
 
-    void PRNG::operator=(PRNG&&s) 
+    template<typename Backend>
+    void BasicPRNG<Backend>::operator=(BasicPRNG&&s) 
     {
         mBuffer = (std::move(s.mBuffer));
-        mAes = (std::move(s.mAes));
+        mBackend = (std::move(s.mBackend));
         mBytesIdx = (s.mBytesIdx);
         mBlockIdx = (s.mBlockIdx);
         mBufferByteCapacity = (s.mBufferByteCapacity);
@@ -41,38 +67,243 @@ namespace osuCrypto {
     }
 
 
-    void PRNG::SetSeed(const block& seed, u64 bufferSize)
+    template<typename Backend>
+    void BasicPRNG<Backend>::SetSeed(const block& seed, u64 bufferSize)
     {
-        mAes.setKey(seed);
+        mBackend.setSeed(seed);
         mBlockIdx = 0;
 
         if (mBuffer.size() == 0)
         {
-            mBuffer.resize(bufferSize);
-            mBufferByteCapacity = (sizeof(block) * bufferSize);
+            mBufferByteCapacity = Backend::BlockSize * bufferSize;
+            mBuffer.resize(mBufferByteCapacity / sizeof(block));
         }
 
 
         refillBuffer();
     }
 
-    u8 PRNG::getBit() { return get<bool>(); }
+    template<typename Backend>
+    u8 BasicPRNG<Backend>::getBit() { return get<bool>(); }
+
+    template<typename Backend>
+    void BasicPRNG<Backend>::getBits(u64* dest, u64 numBits)
+    {
+        u64 numWords = (numBits + 63) / 64;
+        get(dest, numWords);
+        if (numBits % 64)
+            dest[numWords - 1] &= (u64(1) << (numBits % 64)) - 1;
+    }
+
+    template<typename Backend>
+    void BasicPRNG<Backend>::getBits(BitVector& dest, u64 numBits)
+    {
+        dest.resize(numBits);
+        get(dest.data(), dest.sizeBytes());
+        if (numBits % 8)
+            dest.data()[dest.sizeBytes() - 1] &= (1 << (numBits % 8)) - 1;
+    }
+
+    template<typename Backend>
+    u64 BasicPRNG<Backend>::getUniform(u64 bound)
+    {
+        if (bound == 0)
+            throw std::runtime_error("bound must be positive " LOCATION);
+
+        // x * bound / 2^64 is biased only when the low half is below 2^64 % bound.
+        u64 lo, hi = mul64(get<u64>(), bound, lo);
+        if (lo < bound)
+        {
+            u64 threshold = (0 - bound) % bound;
+            while (lo < threshold)
+                hi = mul64(get<u64>(), bound, lo);
+        }
+        return hi;
+    }
+
+    template<typename Backend>
+    void BasicPRNG<Backend>::getUniform(span<u64> out, u64 bound)
+    {
+        if (bound == 0)
+            throw std::runtime_error("bound must be positive " LOCATION);
+
+        // the rejected samples are drawn again at the end.
+        std::vector<u64> rejected;
+
+        if (bound >> 32)
+        {
+            get(out.data(), out.size());
+
+            u64 threshold = (0 - bound) % bound;
+            for (u64 i = 0; i < u64(out.size()); ++i)
+            {
+                u64 lo;
+                out[i] = mul64(out[i], bound, lo);
+                if (lo < threshold)
+                    rejected.push_back(i);
+            }
+        }
+        else
+        {
+            // the same with 32 bit samples, taken straight from the buffer.
+            const block b = _mm_set1_epi64x(bound);
+            const block threshold = _mm_set1_epi32(u32(0 - u32(bound)) % u32(bound));
+            u64 i = 0;
+            while (i < u64(out.size()))
+            {
+                auto buff = getBufferSpan(4 * (out.size() - i));
+                u8* src = buff.data();
+                u64 end = i + buff.size() / 4;
+
+                for (; i + 4 <= end; i += 4, src += 16)
+                {
+                    block x = _mm_loadu_si128((block*)src);
+                    block p02 = _mm_mul_epu32(x, b);
+                    block p13 = _mm_mul_epu32(_mm_srli_epi64(x, 32), b);
+
+                    block r02 = _mm_srli_epi64(p02, 32);
+                    block r13 = _mm_srli_epi64(p13, 32);
+                    _mm_storeu_si128((block*)&out[i], _mm_unpacklo_epi64(r02, r13));
+                    _mm_storeu_si128((block*)&out[i + 2], _mm_unpackhi_epi64(r02, r13));
+
+                    // the low halves, accepted if lo >= threshold.
+                    block lo = _mm_blend_epi16(p02, _mm_slli_epi64(p13, 32), 0xCC);
+                    block accept = _mm_cmpeq_epi32(_mm_max_epu32(lo, threshold), lo);
+                    int mask = _mm_movemask_ps(_mm_castsi128_ps(accept));
+                    if (mask != 0xF)
+                        for (u64 j = 0; j < 4; ++j)
+                            if ((mask >> j & 1) == 0)
+                                rejected.push_back(i + j);
+                }
+
+                for (; i < end; ++i, src += 4)
+                {
+                    u32 x;
+                    memcpy(&x, src, 4);
+                    u64 p = u64(x) * bound;
+                    out[i] = p >> 32;
+                    if (u32(p) < u32(_mm_cvtsi128_si32(threshold)))
+                        rejected.push_back(i);
+                }
+            }
+        }
+
+        for (auto i : rejected)
+            out[i] = getUniform(bound);
+    }
 
-    const block PRNG::getSeed() const
+    template<typename Backend>
+    const block BasicPRNG<Backend>::getSeed() const
     {
 		if(mBuffer.size())
-	        return mAes.mRoundKey[0];
+	        return mBackend.getSeed();
 
 		throw std::runtime_error("PRNG has not been keyed " LOCATION);
     }
 
-    void PRNG::refillBuffer()
+    template<typename Backend>
+    void BasicPRNG<Backend>::jumpTo(u64 blockIdx)
+    {
+        mBlockIdx = blockIdx;
+        refillBuffer();
+    }
+
+    template<typename Backend>
+    std::vector<BasicPRNG<Backend>> BasicPRNG<Backend>::split(u64 k, u64 blocksPerPart)
+    {
+        if (mBuffer.size() == 0)
+            throw std::runtime_error("PRNG has not been keyed " LOCATION);
+
+        u64 begin = nextWholeBlock();
+
+        // this PRNG refills its buffer at begin + k * blocksPerPart.
+        u64 rest = Backend::MaxBlocks - begin;
+        if (rest < bufferBlocks() || (blocksPerPart && k > (rest - bufferBlocks()) / blocksPerPart))
+            throw std::runtime_error("the parts of the split go past the end of the PRNG stream " LOCATION);
+
+        std::vector<BasicPRNG> parts(k);
+        for (u64 i = 0; i < k; ++i)
+        {
+            parts[i].mBackend = mBackend;
+            parts[i].mBuffer.resize(mBuffer.size());
+            parts[i].mBufferByteCapacity = mBufferByteCapacity;
+            parts[i].jumpTo(begin + i * blocksPerPart);
+        }
+
+        jumpTo(begin + k * blocksPerPart);
+        return parts;
+    }
+
+    template<typename Backend>
+    std::vector<BasicPRNG<Backend>> BasicPRNG<Backend>::split(u64 k)
+    {
+        u64 end = nextWholeBlock() + bufferBlocks();
+        u64 rest = end < Backend::MaxBlocks ? Backend::MaxBlocks - end : 0;
+        return split(k, std::min<u64>(u64(1) << 40, rest / (k + 1)));
+    }
+
+    template<typename Backend>
+    BasicPRNG<Backend> BasicPRNG<Backend>::fork()
+    {
+        return BasicPRNG(get<block>(), bufferBlocks());
+    }
+
+    template<typename Backend>
+    void BasicPRNG<Backend>::parallelFill(u8* dest, u64 length, u64 numThreads)
+    {
+        // the bytes up to the next block boundary come from the buffer.
+        u64 head = std::min<u64>(length, (Backend::BlockSize - mBytesIdx % Backend::BlockSize) % Backend::BlockSize);
+        get(dest, head);
+        dest += head;
+        length -= head;
+
+        // a thread is not worth starting for less than this many blocks.
+        const u64 minBlocksPerThread = 1 << 12;
+        u64 numBlocks = (length + Backend::BlockSize - 1) / Backend::BlockSize;
+        numThreads = std::min(numThreads, numBlocks / minBlocksPerThread);
+        if (numThreads < 2)
+        {
+            get(dest, length);
+            return;
+        }
+
+        u64 begin = mBlockIdx - bufferBlocks() + mBytesIdx / Backend::BlockSize;
+        u64 blocksPerThread = (numBlocks + numThreads - 1) / numThreads;
+        u64 bytesPerThread = blocksPerThread * Backend::BlockSize;
+        auto parts = split(numThreads, blocksPerThread);
+
+        auto routine = [&](u64 t)
+        {
+            u64 offset = t * bytesPerThread;
+            if (offset < length)
+                parts[t].get(dest + offset, std::min(bytesPerThread, length - offset));
+        };
+
+        std::vector<std::thread> thrds;
+        for (u64 t = 1; t < numThreads; ++t)
+            thrds.emplace_back(routine, t);
+        routine(0);
+        for (auto& thrd : thrds)
+            thrd.join();
+
+        // continue right after dest, as get(dest, length) would.
+        jumpTo(begin + length / Backend::BlockSize);
+        mBytesIdx = length % Backend::BlockSize;
+    }
+
+    template<typename Backend>
+    void BasicPRNG<Backend>::refillBuffer()
     {
 		if (mBuffer.size() == 0)
 			throw std::runtime_error("PRNG has not been keyed " LOCATION);
 
-		mAes.ecbEncCounterMode(mBlockIdx, mBuffer.size(), mBuffer.data());
-		mBlockIdx += mBuffer.size();
+		mBackend.generate(mBlockIdx, bufferBlocks(), (u8*)mBuffer.data());
+		mBlockIdx += bufferBlocks();
         mBytesIdx = 0;
     }
+
+    template class BasicPRNG<AesCtrBackend>;
+    template class BasicPRNG<Aes256CtrBackend>;
+    template class BasicPRNG<Blake2XbBackend>;
+    template class BasicPRNG<ChaChaBackend>;
 }
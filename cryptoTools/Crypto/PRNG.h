@@ -7,30 +7,87 @@
 
 namespace osuCrypto
 {
+    class BitVector;
+
+    // The default backend of BasicPRNG, AES in counter mode with a KeyBits
+    // bit key. A backend maps a seed and the index of a block of BlockSize
+    // bytes to that block of the stream, so that any part of the stream can
+    // be generated directly. The stream has MaxBlocks blocks.
+    template<int KeyBits>
+    class AesCtrBackendBase
+    {
+    public:
+        // The number of bytes generated per counter value.
+        static const u64 BlockSize = sizeof(block);
+
+        // The number of blocks in the stream, the counter is 64 bits.
+        static const u64 MaxBlocks = ~u64(0);
+
+        void setSeed(const block& seed)
+        {
+            typename AESBase<KeyBits>::Key key;
+            deriveKey(seed, key);
+            mAes.setKey(key);
+            mSeed = seed;
+        }
 
-	// A Peudorandom number generator implemented using AES-NI.
-    class PRNG
+        block getSeed() const { return mSeed; }
+
+        // Writes the blocks {blockIdx, ..., blockIdx + count - 1} of the stream
+        // to the possibly unaligned dest.
+        void generate(u64 blockIdx, u64 count, u8* dest) const
+        {
+            mAes.ecbEncCounterMode(blockIdx, count, dest);
+        }
+
+        // AES that generates the randomness by computing AES_key({0,1,2,...})
+        AESBase<KeyBits> mAes;
+
+        block mSeed;
+
+    private:
+        // A 128 bit key is the seed.
+        static void deriveKey(const block& seed, block& key) { key = seed; }
+
+        // Longer keys are AES_seed of two blocks whose halves differ, which
+        // the counter mode stream of the seed never encrypts.
+        static void deriveKey(const block& seed, std::array<block, 2>& key)
+        {
+            AES aes(seed);
+            key[0] = aes.ecbEncBlock(toBlock(1, 0));
+            key[1] = aes.ecbEncBlock(toBlock(2, 0));
+        }
+    };
+
+    typedef AesCtrBackendBase<128> AesCtrBackend;
+    typedef AesCtrBackendBase<256> Aes256CtrBackend;
+
+	// A Peudorandom number generator whose stream is generated by Backend,
+	// see AesCtrBackend. PRNG uses AES, which is AES-NI when available.
+    template<typename Backend>
+    class BasicPRNG
     {
     public:
+        static_assert(Backend::BlockSize % sizeof(block) == 0, "the buffer holds whole blocks");
 
 		// default construct leaves the PRNG in an invalid state.
 		// SetSeed(...) must be called before get(...)
-        PRNG() = default;
+        BasicPRNG() = default;
 
 		// explicit constructor to initialize the PRNG with the 
-		// given seed and to buffer bufferSize number of AES block
-        PRNG(const block& seed, u64 bufferSize = 256);
+		// given seed and to buffer bufferSize number of Backend blocks
+        BasicPRNG(const block& seed, u64 bufferSize = 256);
 
 		// standard move constructor. The moved from PRNG is invalid
 		// unless SetSeed(...) is called.
-        PRNG(PRNG&& s);
+        BasicPRNG(BasicPRNG&& s);
 
 		// Copy is not allowed.
-        PRNG(const PRNG&) = delete;
+        BasicPRNG(const BasicPRNG&) = delete;
 
         // standard move assignment. The moved from PRNG is invalid
         // unless SetSeed(...) is called.
-        void operator=(PRNG&&);
+        void operator=(BasicPRNG&&);
 
         // Set seed from a block and set the desired buffer size.
         void SetSeed(const block& b, u64 bufferSize = 256);
@@ -38,15 +95,33 @@ namespace osuCrypto
 		// Return the seed for this PRNG.
         const block getSeed() const;
 
+        // Moves to the start of block blockIdx of the stream, i.e. the next
+        // byte returned is byte Backend::BlockSize * blockIdx of the stream.
+        void jumpTo(u64 blockIdx);
+
+        // Returns k PRNGs with the same seed. Part i starts at block
+        // b + i * blocksPerPart, where b is the first unused block of this
+        // PRNG, so the parts are disjoint as long as each takes at most
+        // blocksPerPart blocks. This PRNG continues after the last part.
+        // Throws if that is past the end of the Backend's stream.
+        std::vector<BasicPRNG> split(u64 k, u64 blocksPerPart);
+
+        // The same with parts of 2^40 blocks, or an equal share of the
+        // rest of the stream with this PRNG if the Backend's stream is shorter.
+        std::vector<BasicPRNG> split(u64 k);
+
+        // Returns a PRNG seeded with the next block of this one.
+        BasicPRNG fork();
+
 
         struct AnyPOD
         {
-            PRNG& mPrng;
+            BasicPRNG& mPrng;
 
             template<typename T, typename U = typename std::enable_if<std::is_pod<T>::value, T>::type>
                 operator T()
             {
-                return mPrng.get<T>();
+                return mPrng.template get<T>();
             }
 
         };
@@ -64,7 +139,7 @@ namespace osuCrypto
 			get()
         {
             T ret;
-            get((u8*)&ret, sizeof(T));
+            get(&ret, 1);
             return ret;
         }
 
@@ -77,19 +152,36 @@ namespace osuCrypto
         {
             u64 lengthu8 = length * sizeof(T);
             u8* destu8 = (u8*)dest;
-            while (lengthu8)
-            {
-                u64 step = std::min(lengthu8, mBufferByteCapacity - mBytesIdx);
+            u64 step = std::min(lengthu8, mBufferByteCapacity - mBytesIdx);
+
+            memcpy(destu8, ((u8*)mBuffer.data()) + mBytesIdx, step);
 
-                memcpy(destu8, ((u8*)mBuffer.data()) + mBytesIdx, step);
+            destu8 += step;
+            lengthu8 -= step;
+            mBytesIdx += step;
 
-                destu8 += step;
-                lengthu8 -= step;
-                mBytesIdx += step;
+            if (lengthu8)
+            {
+                if (mBufferByteCapacity == 0)
+                    throw std::runtime_error("PRNG has not been keyed " LOCATION);
+
+                // The buffer is used up and the stream continues at block
+                // mBlockIdx. Whole blocks are generated directly into dest,
+                // only the last partial block goes through the buffer.
+                u64 blocks = lengthu8 / Backend::BlockSize;
+                mBackend.generate(mBlockIdx, blocks, destu8);
+                mBlockIdx += blocks;
+                destu8 += blocks * Backend::BlockSize;
+                lengthu8 -= blocks * Backend::BlockSize;
 
-                if (mBytesIdx == mBufferByteCapacity)
-                    refillBuffer();
+                refillBuffer();
+                memcpy(destu8, mBuffer.data(), lengthu8);
+                mBytesIdx = lengthu8;
             }
+            else if (step && mBytesIdx == mBufferByteCapacity)
+                refillBuffer();
+
+            toBool(dest, length);
         }
 
 		// Templated function that fills the provided buffer 
@@ -102,6 +194,19 @@ namespace osuCrypto
 			get(dest.data(), dest.size());
 		}
 
+		// Fills dest with the same bytes as get(dest) would, using
+		// numThreads threads that each generate a slice of the stream.
+		// Required: T must be a POD type.
+		template<typename T>
+		typename std::enable_if<std::is_pod<T>::value, void>::type
+			parallelFill(span<T> dest, u64 numThreads)
+		{
+			parallelFill((u8*)dest.data(), dest.size() * sizeof(T), numThreads);
+			toBool(dest.data(), dest.size());
+		}
+
+		void parallelFill(u8* dest, u64 length, u64 numThreads);
+
         // returns the buffer of maximum maxSize bytes or however 
         // many the internal buffer has, which ever is smaller. The 
         // returned bytes are "consumed" and will not be used on 
@@ -123,6 +228,22 @@ namespace osuCrypto
 		// Returns a random element from {0,1}
         u8 getBit();
 
+        // Fills the (numBits + 63) / 64 words at dest with packed random bits,
+        // 8 per byte of the stream. The bits of the last word past numBits are zero.
+        void getBits(u64* dest, u64 numBits);
+
+        // Resizes dest to numBits and fills it with packed random bits.
+        void getBits(BitVector& dest, u64 numBits);
+
+        // Returns a uniform element of [0, bound). Uses Lemire's multiply-shift
+        // with rejection, so unlike operator()(bound) there is no modulo bias
+        // and no division except in the rare case of a possible rejection.
+        u64 getUniform(u64 bound);
+
+        // Fills out with uniform elements of [0, bound). The randomness is taken
+        // in bulk and for bound < 2^32 four 32 bit samples are mapped at a time.
+        void getUniform(span<u64> out, u64 bound);
+
 		// STL random number interface
         typedef u64 result_type;
         static result_type min() { return 0; }
@@ -136,11 +257,41 @@ namespace osuCrypto
             return get<typename std::make_unsigned<R>::type>() % mod;
         }
 
+        // Iterates over random bits taken from a PRNG, 64 at a time. Reading a
+        // bit is a mask and an increment is a shift, except for every 64th
+        // increment which takes the next word from the PRNG.
+        class BitIterator
+        {
+        public:
+            BitIterator(BasicPRNG& prng)
+                : mPrng(&prng), mWord(prng.get<u64>()) {}
+
+            // The current bit.
+            u8 operator*() const { return mWord & 1; }
+
+            // Pre increment the iterator by 1.
+            BitIterator& operator++()
+            {
+                if (++mIdx == 64)
+                {
+                    mWord = mPrng->template get<u64>();
+                    mIdx = 0;
+                }
+                else
+                    mWord >>= 1;
+                return *this;
+            }
+
+        private:
+            BasicPRNG* mPrng;
+            u64 mWord, mIdx = 0;
+        };
+
 		// internal buffer to store future random values.
 		std::vector<block> mBuffer;
 
-		// AES that generates the randomness by computing AES_seed({0,1,2,...})
-		AES mAes;
+		// Generates the randomness, see AesCtrBackend.
+		Backend mBackend;
 
 		// Indicators denoting the current state of the buffer.
 		u64 mBytesIdx = 0,
@@ -149,25 +300,28 @@ namespace osuCrypto
 
 		// refills the internal buffer with fresh randomness
 		void refillBuffer();
-    };
 
-	// specialization to make bool work correctly.
-    template<>
-    inline void PRNG::get<bool>(bool* dest, u64 length)
-    {
-        get((u8*)dest, length);
-        for (u64 i = 0; i < length; ++i) dest[i] = ((u8*)dest)[i] & 1;
-    }
+	private:
+		// The number of Backend blocks that the buffer holds.
+		u64 bufferBlocks() const { return mBufferByteCapacity / Backend::BlockSize; }
 
-	// specialization to make bool work correctly.
-    template<>
-    inline bool PRNG::get<bool>()
-    {
-        u8 ret;
-        get((u8*)&ret, 1);
-        return ret & 1;
-    }
+		// The first block that none of the buffered bytes have been taken from.
+		u64 nextWholeBlock() const { return mBlockIdx - bufferBlocks() + (mBytesIdx + Backend::BlockSize - 1) / Backend::BlockSize; }
+
+		// makes bools work correctly.
+		template<typename T>
+		static void toBool(T*, u64) {}
+
+		static void toBool(bool* dest, u64 length)
+		{
+			for (u64 i = 0; i < length; ++i) dest[i] = ((u8*)dest)[i] & 1;
+		}
+    };
+
+    typedef BasicPRNG<AesCtrBackend> PRNG;
+    typedef BasicPRNG<Aes256CtrBackend> Aes256PRNG;
 
+    typedef PRNG::BitIterator PRNGBitIterator;
 
 	template<typename T>
 	typename std::enable_if<std::is_pod<T>::value, PRNG&>::type operator<<(T& rhs, PRNG& lhs)
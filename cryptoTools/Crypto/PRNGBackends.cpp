@@ -0,0 +1,216 @@
+#include <cryptoTools/Crypto/PRNGBackends.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cstring>
+#include <immintrin.h>
+
+namespace osuCrypto
+{
+    void Blake2XbBackend::setSeed(const block& seed)
+    {
+        mSeed = seed;
+        mXof.Reset(Blake2Xb::UnknownOutputLength, (const u8*)&seed, sizeof(block));
+        mXof.Final();
+    }
+
+    void Blake2XbBackend::generate(u64 blockIdx, u64 count, u8* dest) const
+    {
+        if (blockIdx > MaxBlocks || count > MaxBlocks - blockIdx)
+            throw std::runtime_error("BLAKE2Xb has 2^32 output blocks " LOCATION);
+
+        mXof.Output(blockIdx * BlockSize, dest, count * BlockSize);
+    }
+
+    namespace
+    {
+        template<int S>
+        inline block rotl32(const block& x)
+        {
+            return _mm_or_si128(_mm_slli_epi32(x, S), _mm_srli_epi32(x, 32 - S));
+        }
+
+        template<>
+        inline block rotl32<16>(const block& x)
+        {
+            return _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+        }
+
+        template<>
+        inline block rotl32<8>(const block& x)
+        {
+            return _mm_shuffle_epi8(x, _mm_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+        }
+
+        inline void quarterRound(block& a, block& b, block& c, block& d)
+        {
+            a = _mm_add_epi32(a, b); d = rotl32<16>(d ^ a);
+            c = _mm_add_epi32(c, d); b = rotl32<12>(b ^ c);
+            a = _mm_add_epi32(a, b); d = rotl32<8>(d ^ a);
+            c = _mm_add_epi32(c, d); b = rotl32<7>(b ^ c);
+        }
+
+        // Computes the 4 blocks with counters {ctr, ..., ctr + 3}. Register j
+        // holds word j of the 4 blocks, which are transposed at the end.
+        template<int Rounds>
+        inline void chacha4Blocks(const u32* input, u64 ctr, u8* dest)
+        {
+            block in[16], x[16];
+            for (u64 j = 0; j < 16; ++j)
+                in[j] = _mm_set1_epi32(input[j]);
+            in[12] = _mm_setr_epi32(u32(ctr), u32(ctr + 1), u32(ctr + 2), u32(ctr + 3));
+            in[13] = _mm_setr_epi32(u32(ctr >> 32), u32((ctr + 1) >> 32), u32((ctr + 2) >> 32), u32((ctr + 3) >> 32));
+
+            for (u64 j = 0; j < 16; ++j)
+                x[j] = in[j];
+
+            for (int r = 0; r < Rounds; r += 2)
+            {
+                quarterRound(x[0], x[4], x[8], x[12]);
+                quarterRound(x[1], x[5], x[9], x[13]);
+                quarterRound(x[2], x[6], x[10], x[14]);
+                quarterRound(x[3], x[7], x[11], x[15]);
+
+                quarterRound(x[0], x[5], x[10], x[15]);
+                quarterRound(x[1], x[6], x[11], x[12]);
+                quarterRound(x[2], x[7], x[8], x[13]);
+                quarterRound(x[3], x[4], x[9], x[14]);
+            }
+
+            for (u64 g = 0; g < 4; ++g)
+            {
+                block a = _mm_add_epi32(x[4 * g + 0], in[4 * g + 0]);
+                block b = _mm_add_epi32(x[4 * g + 1], in[4 * g + 1]);
+                block c = _mm_add_epi32(x[4 * g + 2], in[4 * g + 2]);
+                block d = _mm_add_epi32(x[4 * g + 3], in[4 * g + 3]);
+
+                block ab01 = _mm_unpacklo_epi32(a, b);
+                block cd01 = _mm_unpacklo_epi32(c, d);
+                block ab23 = _mm_unpackhi_epi32(a, b);
+                block cd23 = _mm_unpackhi_epi32(c, d);
+
+                _mm_storeu_si128((block*)(dest + 0 * 64 + 16 * g), _mm_unpacklo_epi64(ab01, cd01));
+                _mm_storeu_si128((block*)(dest + 1 * 64 + 16 * g), _mm_unpackhi_epi64(ab01, cd01));
+                _mm_storeu_si128((block*)(dest + 2 * 64 + 16 * g), _mm_unpacklo_epi64(ab23, cd23));
+                _mm_storeu_si128((block*)(dest + 3 * 64 + 16 * g), _mm_unpackhi_epi64(ab23, cd23));
+            }
+        }
+    }
+
+    namespace
+    {
+        // The same as the SSE code for 8 blocks at a time.
+        template<int S>
+        OC_TARGET("avx2")
+        inline __m256i rotl32x8(const __m256i& x)
+        {
+            return _mm256_or_si256(_mm256_slli_epi32(x, S), _mm256_srli_epi32(x, 32 - S));
+        }
+
+        template<>
+        OC_TARGET("avx2")
+        inline __m256i rotl32x8<16>(const __m256i& x)
+        {
+            return _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+                2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+        }
+
+        template<>
+        OC_TARGET("avx2")
+        inline __m256i rotl32x8<8>(const __m256i& x)
+        {
+            return _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+                3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+        }
+
+        OC_TARGET("avx2")
+        inline void quarterRoundx8(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+        {
+            a = _mm256_add_epi32(a, b); d = rotl32x8<16>(_mm256_xor_si256(d, a));
+            c = _mm256_add_epi32(c, d); b = rotl32x8<12>(_mm256_xor_si256(b, c));
+            a = _mm256_add_epi32(a, b); d = rotl32x8<8>(_mm256_xor_si256(d, a));
+            c = _mm256_add_epi32(c, d); b = rotl32x8<7>(_mm256_xor_si256(b, c));
+        }
+
+        template<int Rounds>
+        OC_TARGET("avx2")
+        void chacha8Blocks(const u32* input, u64 ctr, u8* dest)
+        {
+            __m256i in[16], x[16];
+            for (u64 j = 0; j < 16; ++j)
+                in[j] = _mm256_set1_epi32(input[j]);
+
+            u32 lo[8], hi[8];
+            for (u64 i = 0; i < 8; ++i)
+            {
+                lo[i] = u32(ctr + i);
+                hi[i] = u32((ctr + i) >> 32);
+            }
+            in[12] = _mm256_loadu_si256((__m256i*)lo);
+            in[13] = _mm256_loadu_si256((__m256i*)hi);
+
+            for (u64 j = 0; j < 16; ++j)
+                x[j] = in[j];
+
+            for (int r = 0; r < Rounds; r += 2)
+            {
+                quarterRoundx8(x[0], x[4], x[8], x[12]);
+                quarterRoundx8(x[1], x[5], x[9], x[13]);
+                quarterRoundx8(x[2], x[6], x[10], x[14]);
+                quarterRoundx8(x[3], x[7], x[11], x[15]);
+
+                quarterRoundx8(x[0], x[5], x[10], x[15]);
+                quarterRoundx8(x[1], x[6], x[11], x[12]);
+                quarterRoundx8(x[2], x[7], x[8], x[13]);
+                quarterRoundx8(x[3], x[4], x[9], x[14]);
+            }
+
+            // the 128 bit lanes hold blocks 0-3 and 4-7.
+            for (u64 g = 0; g < 4; ++g)
+            {
+                __m256i a = _mm256_add_epi32(x[4 * g + 0], in[4 * g + 0]);
+                __m256i b = _mm256_add_epi32(x[4 * g + 1], in[4 * g + 1]);
+                __m256i c = _mm256_add_epi32(x[4 * g + 2], in[4 * g + 2]);
+                __m256i d = _mm256_add_epi32(x[4 * g + 3], in[4 * g + 3]);
+
+                __m256i ab01 = _mm256_unpacklo_epi32(a, b);
+                __m256i cd01 = _mm256_unpacklo_epi32(c, d);
+                __m256i ab23 = _mm256_unpackhi_epi32(a, b);
+                __m256i cd23 = _mm256_unpackhi_epi32(c, d);
+
+                __m256i w[4] = {
+                    _mm256_unpacklo_epi64(ab01, cd01), _mm256_unpackhi_epi64(ab01, cd01),
+                    _mm256_unpacklo_epi64(ab23, cd23), _mm256_unpackhi_epi64(ab23, cd23) };
+
+                for (u64 i = 0; i < 4; ++i)
+                {
+                    _mm_storeu_si128((block*)(dest + i * 64 + 16 * g), _mm256_castsi256_si128(w[i]));
+                    _mm_storeu_si128((block*)(dest + (i + 4) * 64 + 16 * g), _mm256_extracti128_si256(w[i], 1));
+                }
+            }
+        }
+    }
+
+    void ChaChaBackend::generate(u64 blockIdx, u64 count, u8* dest) const
+    {
+        // "expand 16-byte k", the key twice, the counter and the nonce.
+        u32 input[16] = { 0x61707865, 0x3120646e, 0x79622d36, 0x6b206574 };
+        memcpy(input + 4, &mSeed, sizeof(block));
+        memcpy(input + 8, &mSeed, sizeof(block));
+
+        u64 i = 0;
+        if (cpuFeatures().mAVX2)
+            for (; i + 8 <= count; i += 8)
+                chacha8Blocks<20>(input, blockIdx + i, dest + i * BlockSize);
+
+        for (; i + 4 <= count; i += 4)
+            chacha4Blocks<20>(input, blockIdx + i, dest + i * BlockSize);
+
+        if (i < count)
+        {
+            u8 temp[4 * BlockSize];
+            chacha4Blocks<20>(input, blockIdx + i, temp);
+            memcpy(dest + i * BlockSize, temp, (count - i) * BlockSize);
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/PRNG.h>
+#include <cryptoTools/Crypto/Blake2.h>
+
+namespace osuCrypto
+{
+    // BLAKE2Xb keyed with the seed and with an unspecified output length.
+    // Block i of the stream is output node i, i.e. BLAKE2b of the root hash
+    // with node offset i, so the stream is limited to 2^32 blocks.
+    class Blake2XbBackend
+    {
+    public:
+        static const u64 BlockSize = BLAKE2B_OUTBYTES;
+        static const u64 MaxBlocks = u64(1) << 32;
+
+        void setSeed(const block& seed);
+
+        block getSeed() const { return mSeed; }
+
+        void generate(u64 blockIdx, u64 count, u8* dest) const;
+
+        block mSeed;
+
+        // Keyed with the seed and finalized, so that any node can be output.
+        Blake2Xb mXof;
+    };
+
+    // ChaCha20 keyed with the seed, using the 128 bit key constants of the
+    // original ChaCha, a zero nonce and the block index as the 64 bit counter.
+    // Eight blocks are computed at a time with AVX2, or four with SSE, so
+    // this is the constant time backend of choice on hosts without AES-NI.
+    class ChaChaBackend
+    {
+    public:
+        static const u64 BlockSize = 64;
+        static const u64 MaxBlocks = ~u64(0);
+
+        void setSeed(const block& seed) { mSeed = seed; }
+
+        block getSeed() const { return mSeed; }
+
+        void generate(u64 blockIdx, u64 count, u8* dest) const;
+
+        block mSeed;
+    };
+
+    typedef BasicPRNG<Blake2XbBackend> Blake2PRNG;
+    typedef BasicPRNG<ChaChaBackend> ChaChaPRNG;
+}
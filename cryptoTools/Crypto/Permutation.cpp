@@ -0,0 +1,152 @@
+#include <cryptoTools/Crypto/Permutation.h>
+
+#include <array>
+
+namespace osuCrypto
+{
+    namespace
+    {
+        // The values of a batch that are permuted together.
+        const u64 batchSize = 64;
+    }
+
+    void FeistelPrp::setKey(const block& seed, u64 n)
+    {
+        if (n == 0)
+            throw std::runtime_error("the domain must not be empty " LOCATION);
+
+        u64 bits = 0;
+        while (bits < 64 && ((n - 1) >> bits))
+            ++bits;
+
+        mAes.setKey(seed);
+        mN = n;
+        mHalfBits = std::max<u64>(1, (bits + 1) / 2);
+        mMask = (u64(1) << mHalfBits) - 1;
+    }
+
+    u64 FeistelPrp::permute(u64 x) const
+    {
+        u64 y;
+        permute({ &x, 1 }, { &y, 1 });
+        return y;
+    }
+
+    u64 FeistelPrp::inverse(u64 y) const
+    {
+        u64 x;
+        inverse({ &y, 1 }, { &x, 1 });
+        return x;
+    }
+
+    void FeistelPrp::permute(span<const u64> in, span<u64> out) const
+    {
+        if (in.size() != out.size())
+            throw RTE_LOC;
+
+        std::array<u64, batchSize> left, right, idx;
+        std::array<block, batchSize> f;
+
+        for (u64 i = 0; i < u64(in.size()); i += batchSize)
+        {
+            u64 size = std::min<u64>(batchSize, in.size() - i);
+            for (u64 j = 0; j < size; ++j)
+            {
+                if (in[i + j] >= mN)
+                    throw std::runtime_error("value out of the domain " LOCATION);
+                left[j] = in[i + j] >> mHalfBits;
+                right[j] = in[i + j] & mMask;
+                idx[j] = i + j;
+            }
+
+            // the values still outside of the domain are encrypted again.
+            while (size)
+            {
+                for (u64 r = 0; r < Rounds; ++r)
+                {
+                    for (u64 j = 0; j < size; ++j)
+                        f[j] = toBlock(r, right[j]);
+                    mAes.ecbEncBlocks(f.data(), size, f.data());
+
+                    for (u64 j = 0; j < size; ++j)
+                    {
+                        u64 t = left[j] ^ (_mm_cvtsi128_si64(f[j]) & mMask);
+                        left[j] = right[j];
+                        right[j] = t;
+                    }
+                }
+
+                u64 kept = 0;
+                for (u64 j = 0; j < size; ++j)
+                {
+                    u64 y = (left[j] << mHalfBits) | right[j];
+                    if (y < mN)
+                        out[idx[j]] = y;
+                    else
+                    {
+                        left[kept] = left[j];
+                        right[kept] = right[j];
+                        idx[kept++] = idx[j];
+                    }
+                }
+                size = kept;
+            }
+        }
+    }
+
+    void FeistelPrp::inverse(span<const u64> in, span<u64> out) const
+    {
+        if (in.size() != out.size())
+            throw RTE_LOC;
+
+        std::array<u64, batchSize> left, right, idx;
+        std::array<block, batchSize> f;
+
+        for (u64 i = 0; i < u64(in.size()); i += batchSize)
+        {
+            u64 size = std::min<u64>(batchSize, in.size() - i);
+            for (u64 j = 0; j < size; ++j)
+            {
+                if (in[i + j] >= mN)
+                    throw std::runtime_error("value out of the domain " LOCATION);
+                left[j] = in[i + j] >> mHalfBits;
+                right[j] = in[i + j] & mMask;
+                idx[j] = i + j;
+            }
+
+            while (size)
+            {
+                // round r maps (L, R) to (R, L ^ F_r(R)), so it is undone
+                // by (L', R') -> (R' ^ F_r(L'), L').
+                for (u64 r = Rounds; r-- > 0; )
+                {
+                    for (u64 j = 0; j < size; ++j)
+                        f[j] = toBlock(r, left[j]);
+                    mAes.ecbEncBlocks(f.data(), size, f.data());
+
+                    for (u64 j = 0; j < size; ++j)
+                    {
+                        u64 t = right[j] ^ (_mm_cvtsi128_si64(f[j]) & mMask);
+                        right[j] = left[j];
+                        left[j] = t;
+                    }
+                }
+
+                u64 kept = 0;
+                for (u64 j = 0; j < size; ++j)
+                {
+                    u64 x = (left[j] << mHalfBits) | right[j];
+                    if (x < mN)
+                        out[idx[j]] = x;
+                    else
+                    {
+                        left[kept] = left[j];
+                        right[kept] = right[j];
+                        idx[kept++] = idx[j];
+                    }
+                }
+                size = kept;
+            }
+        }
+    }
+}
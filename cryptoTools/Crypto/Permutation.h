@@ -0,0 +1,146 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/AES.h>
+#include <cryptoTools/Crypto/PRNG.h>
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <vector>
+
+namespace osuCrypto
+{
+    // A pseudorandom permutation of {0, ..., n - 1} given by a seed, for any
+    // n. It is a Feistel network over the smallest even number of bits 2b with
+    // 2^2b >= n, where round i maps (L, R) to (R, L ^ F_i(R)) and F_i(R) is
+    // the low b bits of AES_seed(i || R). Values that land outside of the
+    // domain are encrypted again (cycle walking), less than 4 times on average.
+    class FeistelPrp
+    {
+    public:
+        static const u64 Rounds = 8;
+
+        // Default constructor leave the class in an invalid state
+        // until setKey(...) is called.
+        FeistelPrp() = default;
+
+        FeistelPrp(const block& seed, u64 n) { setKey(seed, n); }
+
+        void setKey(const block& seed, u64 n);
+
+        // The size of the domain.
+        u64 size() const { return mN; }
+
+        // Returns pi(x).
+        u64 permute(u64 x) const;
+
+        // Returns the inverse of pi at y.
+        u64 inverse(u64 y) const;
+
+        // Computes out[i] = pi(in[i]). The rounds of a batch of values are
+        // computed together, so that AES is called on 8 or more blocks at a
+        // time. in and out may alias.
+        void permute(span<const u64> in, span<u64> out) const;
+
+        // Computes out[i] = pi^-1(in[i]). in and out may alias.
+        void inverse(span<const u64> in, span<u64> out) const;
+
+        AES mAes;
+        u64 mN = 0, mHalfBits = 0, mMask = 0;
+    };
+
+    // Shuffles data uniformly at random. The result only depends on seed and
+    // not on numThreads, so two parties with the same seed get the same
+    // permutation. The elements are first sent to random buckets of about
+    // 2^15 elements, by parallel stripes of the input, and then each bucket
+    // is shuffled in place with Fisher-Yates. This keeps the random accesses
+    // in cache and lets every pass run in parallel. Uses a copy of data.
+    template<typename T>
+    void parallelShuffle(span<T> data, const block& seed, u64 numThreads = 1)
+    {
+        numThreads = std::max<u64>(1, numThreads);
+        u64 n = data.size();
+        if (n < 2)
+            return;
+
+        u64 numStripes = std::max<u64>(1, std::min<u64>(64, n >> 14));
+        u64 numBuckets = std::max<u64>(1, n >> 15);
+        u64 stripeSize = (n + numStripes - 1) / numStripes;
+
+        // Stripe s draws its buckets from part s of the PRNG stream and
+        // bucket b is shuffled with part numStripes + b.
+        const u64 partBits = 40;
+
+        // Runs routine(k, prng) for k < count, spread over the threads.
+        auto inParallel = [&](u64 count, auto&& routine)
+        {
+            auto run = [&](u64 t)
+            {
+                PRNG prng(seed);
+                for (u64 k = t; k < count; k += numThreads)
+                    routine(k, prng);
+            };
+
+            std::vector<std::thread> thrds;
+            for (u64 t = 1; t < std::min(numThreads, count); ++t)
+                thrds.emplace_back(run, t);
+            run(0);
+            for (auto& thrd : thrds)
+                thrd.join();
+        };
+
+        // Calls f(i, bucket) for the elements of stripe s.
+        auto forEachBucket = [&](u64 s, PRNG& prng, auto&& f)
+        {
+            prng.jumpTo(s << partBits);
+            std::array<u64, 1024> buckets;
+            u64 end = std::min(n, (s + 1) * stripeSize);
+            for (u64 i = s * stripeSize; i < end; i += buckets.size())
+            {
+                u64 size = std::min<u64>(buckets.size(), end - i);
+                prng.getUniform(span<u64>(buckets.data(), size), numBuckets);
+                for (u64 j = 0; j < size; ++j)
+                    f(i + j, buckets[j]);
+            }
+        };
+
+        std::vector<u64> offsets(numStripes * numBuckets);
+        inParallel(numStripes, [&](u64 s, PRNG& prng)
+        {
+            forEachBucket(s, prng, [&](u64, u64 b) { ++offsets[s * numBuckets + b]; });
+        });
+
+        // The elements of bucket b from stripe s go after those from the
+        // stripes before s and the buckets before b.
+        std::vector<u64> bucketBegin(numBuckets + 1);
+        for (u64 b = 0, pos = 0; b < numBuckets; ++b)
+        {
+            bucketBegin[b] = pos;
+            for (u64 s = 0; s < numStripes; ++s)
+            {
+                u64 count = offsets[s * numBuckets + b];
+                offsets[s * numBuckets + b] = pos;
+                pos += count;
+            }
+        }
+        bucketBegin[numBuckets] = n;
+
+        // the same buckets are drawn again to scatter the elements.
+        std::vector<T> temp(n);
+        inParallel(numStripes, [&](u64 s, PRNG& prng)
+        {
+            forEachBucket(s, prng, [&](u64 i, u64 b) { temp[offsets[s * numBuckets + b]++] = std::move(data[i]); });
+        });
+
+        inParallel(numBuckets, [&](u64 b, PRNG& prng)
+        {
+            prng.jumpTo((numStripes + b) << partBits);
+            T* bucket = temp.data() + bucketBegin[b];
+            u64 size = bucketBegin[b + 1] - bucketBegin[b];
+            for (u64 i = size; i > 1; --i)
+                std::swap(bucket[i - 1], bucket[prng.getUniform(i)]);
+
+            std::move(bucket, bucket + size, data.data() + bucketBegin[b]);
+        });
+    }
+}
@@ -0,0 +1,168 @@
+#include <cryptoTools/Crypto/VectorCommit.h>
+#include <cryptoTools/Crypto/Blake2.h>
+#include <array>
+#include <thread>
+
+namespace osuCrypto
+{
+    static_assert(sizeof(Commit) == Blake2::HashSize, "the nodes are Blake2 digests");
+
+    namespace
+    {
+        // Each thread hashes at least this many messages.
+        const u64 minMessagesPerThread = 1 << 12;
+
+        // Blake2::hashMany over count messages, spread over the threads.
+        void hashMany(const u8* in, u64 msgLength, u64 count, Commit* out, u64 numThreads)
+        {
+            numThreads = std::max<u64>(1, std::min(numThreads, count / minMessagesPerThread));
+
+            auto routine = [&](u64 t)
+            {
+                u64 begin = count * t / numThreads;
+                u64 end = count * (t + 1) / numThreads;
+                Blake2::hashMany(in + begin * msgLength, msgLength, end - begin, (u8*)(out + begin), sizeof(Commit));
+            };
+
+            std::vector<std::thread> thrds;
+            for (u64 t = 1; t < numThreads; ++t)
+                thrds.emplace_back(routine, t);
+            routine(0);
+            for (auto& thrd : thrds)
+                thrd.join();
+        }
+
+        // The parents of level, with an odd last node moved up.
+        void hashLevel(const std::vector<Commit>& level, std::vector<Commit>& parents, u64 numThreads)
+        {
+            parents.resize((level.size() + 1) / 2);
+            hashMany(level[0].data(), 2 * sizeof(Commit), level.size() / 2, parents.data(), numThreads);
+            if (level.size() & 1)
+                parents.back() = level.back();
+        }
+
+        Commit hashPair(const Commit& left, const Commit& right)
+        {
+            std::array<Commit, 2> pair{ { left, right } };
+            Commit ret;
+            Blake2::hashMany(pair[0].data(), sizeof(pair), 1, ret.data(), sizeof(Commit));
+            return ret;
+        }
+    }
+
+    void VectorCommit::commit(span<const block> values, PRNG& prng, u64 numThreads)
+    {
+        if (values.size() == 0)
+            throw std::runtime_error("can not commit to an empty vector. " LOCATION);
+
+        u64 n = values.size();
+        mRandomness.resize(n);
+        prng.get(mRandomness.data(), n);
+
+        std::vector<std::array<block, 2>> leaves(n);
+        for (u64 i = 0; i < n; ++i)
+            leaves[i] = { { values[i], mRandomness[i] } };
+
+        mLevels.resize(1);
+        mLevels[0].resize(n);
+        hashMany((u8*)leaves.data(), sizeof(leaves[0]), n, mLevels[0].data(), numThreads);
+
+        while (mLevels.back().size() > 1)
+        {
+            mLevels.emplace_back();
+            hashLevel(mLevels[mLevels.size() - 2], mLevels.back(), numThreads);
+        }
+    }
+
+    std::vector<Commit> VectorCommit::open(span<const u64> idxs) const
+    {
+        std::vector<Commit> proof;
+        std::vector<u64> current(idxs.begin(), idxs.end()), next;
+        for (u64 i = 0; i < current.size(); ++i)
+            if (current[i] >= size() || (i && current[i - 1] >= current[i]))
+                throw std::runtime_error("the indices must be sorted, distinct and less than size(). " LOCATION);
+
+        for (u64 d = 0; d + 1 < mLevels.size(); ++d)
+        {
+            auto& level = mLevels[d];
+            next.clear();
+            for (u64 i = 0; i < current.size(); ++i)
+            {
+                u64 idx = current[i];
+                u64 sibling = idx ^ 1;
+
+                // the sibling is part of the proof unless it is opened too.
+                if (sibling < level.size())
+                {
+                    if (i + 1 < current.size() && current[i + 1] == sibling)
+                        ++i;
+                    else
+                        proof.push_back(level[sibling]);
+                }
+
+                next.push_back(idx / 2);
+            }
+            std::swap(current, next);
+        }
+
+        return proof;
+    }
+
+    bool VectorCommit::verify(
+        const Commit& root,
+        u64 n,
+        span<const u64> idxs,
+        span<const block> values,
+        span<const block> randomness,
+        span<const Commit> proof)
+    {
+        u64 k = idxs.size();
+        if (n == 0 || k == 0 || u64(values.size()) != k || u64(randomness.size()) != k)
+            return false;
+        for (u64 i = 0; i < k; ++i)
+            if (idxs[i] >= n || (i && idxs[i - 1] >= idxs[i]))
+                return false;
+
+        std::vector<std::array<block, 2>> leaves(k);
+        for (u64 i = 0; i < k; ++i)
+            leaves[i] = { { values[i], randomness[i] } };
+
+        std::vector<Commit> digests(k);
+        Blake2::hashMany((u8*)leaves.data(), sizeof(leaves[0]), k, digests[0].data(), sizeof(Commit));
+
+        // the known nodes of the current level, by index.
+        std::vector<std::pair<u64, Commit>> current(k), next;
+        for (u64 i = 0; i < k; ++i)
+            current[i] = { idxs[i], digests[i] };
+
+        auto p = proof.begin();
+        for (u64 m = n; m > 1; m = (m + 1) / 2)
+        {
+            next.clear();
+            for (u64 i = 0; i < current.size(); ++i)
+            {
+                u64 idx = current[i].first;
+                u64 sibling = idx ^ 1;
+                Commit node = current[i].second;
+
+                if (sibling < m)
+                {
+                    Commit other;
+                    if (i + 1 < current.size() && current[i + 1].first == sibling)
+                        other = current[++i].second;
+                    else if (p == proof.end())
+                        return false;
+                    else
+                        other = *p++;
+
+                    node = (idx & 1) ? hashPair(other, node) : hashPair(node, other);
+                }
+
+                next.emplace_back(idx / 2, node);
+            }
+            std::swap(current, next);
+        }
+
+        return p == proof.end() && current.size() == 1 && current[0].second == root;
+    }
+}
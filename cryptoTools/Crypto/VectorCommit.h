@@ -0,0 +1,71 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/Commit.h>
+#include <cryptoTools/Crypto/PRNG.h>
+#include <vector>
+
+namespace osuCrypto
+{
+    // A commitment to a vector of blocks, given by the root of a Merkle tree.
+    // Leaf i is the hash of values[i] and a random block, and each inner node
+    // is the hash of its two children; the last node of a level with an odd
+    // number of nodes moves up unchanged. Leaves hash 32 bytes and inner nodes
+    // 40, so the two are never confused. The nodes of a level are hashed
+    // together with Blake2::hashMany, spread over the threads.
+    //
+    // Any set of leaves is opened with their values and randomness, plus
+    // the siblings on their paths to the root that the verifier can not
+    // compute itself, at most log2(n) per leaf and fewer when paths meet.
+    class VectorCommit
+    {
+    public:
+        VectorCommit() = default;
+
+        VectorCommit(span<const block> values, PRNG& prng, u64 numThreads = 1)
+        {
+            commit(values, prng, numThreads);
+        }
+
+        // Commits to values with fresh randomness from prng.
+        void commit(span<const block> values, PRNG& prng, u64 numThreads = 1);
+
+        // The commitment, to be sent to the verifier.
+        const Commit& root() const { return mLevels.back()[0]; }
+
+        // The number of values committed to.
+        u64 size() const { return mRandomness.size(); }
+
+        // The randomness of leaf i, which opens it along with the value.
+        const block& randomness(u64 i) const { return mRandomness[i]; }
+
+        // The nodes that open the leaves idxs, which must be sorted and
+        // distinct, level by level from the leaves up.
+        std::vector<Commit> open(span<const u64> idxs) const;
+
+        // The path of leaf idx.
+        std::vector<Commit> open(u64 idx) const { return open({ &idx, 1 }); }
+
+        // Returns true if proof opens leaves idxs of a commitment to n
+        // values with the given root to values, with the given randomness.
+        static bool verify(
+            const Commit& root,
+            u64 n,
+            span<const u64> idxs,
+            span<const block> values,
+            span<const block> randomness,
+            span<const Commit> proof);
+
+        // Opens the single leaf idx.
+        static bool verify(const Commit& root, u64 n, u64 idx, const block& value, const block& randomness, span<const Commit> proof)
+        {
+            return verify(root, n, { &idx, 1 }, { &value, 1 }, { &randomness, 1 }, proof);
+        }
+
+    private:
+        std::vector<block> mRandomness;
+
+        // mLevels[0] are the leaves and mLevels.back() the root.
+        std::vector<std::vector<Commit>> mLevels;
+    };
+}
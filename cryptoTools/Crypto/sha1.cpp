@@ -24,9 +24,81 @@
 #include <cryptoTools/Crypto/sha1.h>
 #include <cryptoTools/Common/Log.h>
 #include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Common/CpuFeatures.h>
 #include <stdint.h>
 #include <string>
 #include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+    // Four rounds with the message words w and the round function F.
+    // prev is the ABCD value before the last group, from which
+    // sha1nexte computes E.
+    template<int F>
+    OC_TARGET("sha,sse4.1")
+    inline void sha1ShaNiRounds(__m128i& abcd, __m128i& prev, const __m128i& w)
+    {
+        __m128i e = _mm_sha1nexte_epu32(prev, w);
+        prev = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e, F);
+    }
+
+    // Replaces w0 with the next four words of the message schedule,
+    // given the last 16 words w0, w1, w2, w3.
+    OC_TARGET("sha,sse4.1")
+    inline void sha1ShaNiSchedule(__m128i& w0, const __m128i& w1, const __m128i& w2, const __m128i& w3)
+    {
+        w0 = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(w0, w1), w2), w3);
+    }
+
+    // The SHA-1 compression function with the SHA extensions.
+    OC_TARGET("sha,sse4.1")
+    void sha1CompressShaNi(uint32_t state[5], const uint8_t block[64])
+    {
+        const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+        __m128i e = _mm_set_epi32(state[4], 0, 0, 0);
+
+        __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(block + 0)), byteSwap);
+        __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(block + 16)), byteSwap);
+        __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(block + 32)), byteSwap);
+        __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(block + 48)), byteSwap);
+
+        // the first group adds E to the words directly, which sha1nexte
+        // does too after rotating prev by 30, so E is rotated back first.
+        __m128i abcdSave = abcd;
+        __m128i prev = _mm_or_si128(_mm_slli_epi32(e, 2), _mm_srli_epi32(e, 30));
+
+        sha1ShaNiRounds<0>(abcd, prev, w0);
+        sha1ShaNiRounds<0>(abcd, prev, w1);
+        sha1ShaNiRounds<0>(abcd, prev, w2);
+        sha1ShaNiRounds<0>(abcd, prev, w3);
+        sha1ShaNiSchedule(w0, w1, w2, w3); sha1ShaNiRounds<0>(abcd, prev, w0);
+        sha1ShaNiSchedule(w1, w2, w3, w0); sha1ShaNiRounds<1>(abcd, prev, w1);
+        sha1ShaNiSchedule(w2, w3, w0, w1); sha1ShaNiRounds<1>(abcd, prev, w2);
+        sha1ShaNiSchedule(w3, w0, w1, w2); sha1ShaNiRounds<1>(abcd, prev, w3);
+        sha1ShaNiSchedule(w0, w1, w2, w3); sha1ShaNiRounds<1>(abcd, prev, w0);
+        sha1ShaNiSchedule(w1, w2, w3, w0); sha1ShaNiRounds<1>(abcd, prev, w1);
+        sha1ShaNiSchedule(w2, w3, w0, w1); sha1ShaNiRounds<2>(abcd, prev, w2);
+        sha1ShaNiSchedule(w3, w0, w1, w2); sha1ShaNiRounds<2>(abcd, prev, w3);
+        sha1ShaNiSchedule(w0, w1, w2, w3); sha1ShaNiRounds<2>(abcd, prev, w0);
+        sha1ShaNiSchedule(w1, w2, w3, w0); sha1ShaNiRounds<2>(abcd, prev, w1);
+        sha1ShaNiSchedule(w2, w3, w0, w1); sha1ShaNiRounds<2>(abcd, prev, w2);
+        sha1ShaNiSchedule(w3, w0, w1, w2); sha1ShaNiRounds<3>(abcd, prev, w3);
+        sha1ShaNiSchedule(w0, w1, w2, w3); sha1ShaNiRounds<3>(abcd, prev, w0);
+        sha1ShaNiSchedule(w1, w2, w3, w0); sha1ShaNiRounds<3>(abcd, prev, w1);
+        sha1ShaNiSchedule(w2, w3, w0, w1); sha1ShaNiRounds<3>(abcd, prev, w2);
+        sha1ShaNiSchedule(w3, w0, w1, w2); sha1ShaNiRounds<3>(abcd, prev, w3);
+
+        e = _mm_sha1nexte_epu32(prev, e);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+
+        _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+        state[4] = _mm_extract_epi32(e, 3);
+    }
+}
 
 
 
@@ -34,6 +106,11 @@
 extern "C" void sha1_update_intel(int *hash, const char* input);
 void sha1_compress(uint32_t state[5], const uint8_t block[64])
 {
+    if (osuCrypto::cpuFeatures().mSHA)
+    {
+        sha1CompressShaNi(state, block);
+        return;
+    }
 
 #ifdef ENABLE_NASM
 
@@ -0,0 +1,191 @@
+#include <cryptoTools/Crypto/sha256.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <immintrin.h>
+
+namespace osuCrypto
+{
+    const u64 SHA256::HashSize;
+
+    namespace
+    {
+        alignas(16) const u32 sha256K[64] =
+        {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        const u32 sha256IV[8] =
+        {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+
+        inline u32 rotr(u32 x, int n)
+        {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        inline u32 loadBigEndian(const u8* p)
+        {
+            return (u32(p[0]) << 24) | (u32(p[1]) << 16) | (u32(p[2]) << 8) | u32(p[3]);
+        }
+
+        void compressScalar(u32 state[8], const u8* blocks, u64 numBlocks)
+        {
+            for (u64 b = 0; b < numBlocks; ++b, blocks += 64)
+            {
+                u32 w[64];
+                for (u64 i = 0; i < 16; ++i)
+                    w[i] = loadBigEndian(blocks + 4 * i);
+                for (u64 i = 16; i < 64; ++i)
+                {
+                    u32 s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                    u32 s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+                }
+
+                u32 a = state[0], b1 = state[1], c = state[2], d = state[3];
+                u32 e = state[4], f = state[5], g = state[6], h = state[7];
+                for (u64 i = 0; i < 64; ++i)
+                {
+                    u32 t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+                    u32 t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b1) ^ (a & c) ^ (b1 & c));
+                    h = g; g = f; f = e; e = d + t1;
+                    d = c; c = b1; b1 = a; a = t1 + t2;
+                }
+
+                state[0] += a; state[1] += b1; state[2] += c; state[3] += d;
+                state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+            }
+        }
+
+        // Four rounds with the message words w, two for each sha256rnds2.
+        OC_TARGET("sha,sse4.1")
+        inline void shaNiRounds(__m128i& abef, __m128i& cdgh, const __m128i& w, u64 i)
+        {
+            __m128i msg = _mm_add_epi32(w, _mm_load_si128((const __m128i*)(sha256K + 4 * i)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+        }
+
+        // Replaces w0 with the next four words of the message schedule,
+        // given the last 16 words w0, w1, w2, w3.
+        OC_TARGET("sha,sse4.1")
+        inline void shaNiSchedule(__m128i& w0, const __m128i& w1, const __m128i& w2, const __m128i& w3)
+        {
+            __m128i t = _mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4));
+            w0 = _mm_sha256msg2_epu32(t, w3);
+        }
+
+        // The state is kept as ABEF and CDGH, the layout sha256rnds2 uses.
+        OC_TARGET("sha,sse4.1")
+        void compressShaNi(u32 state[8], const u8* blocks, u64 numBlocks)
+        {
+            const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+            __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0xB1);
+            __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(state + 4)), 0x1B);
+            __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+            __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+            for (u64 b = 0; b < numBlocks; ++b, blocks += 64)
+            {
+                __m128i abefSave = abef, cdghSave = cdgh;
+                __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0)), byteSwap);
+                __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16)), byteSwap);
+                __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 32)), byteSwap);
+                __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 48)), byteSwap);
+
+                shaNiRounds(abef, cdgh, w0, 0);
+                shaNiRounds(abef, cdgh, w1, 1);
+                shaNiRounds(abef, cdgh, w2, 2);
+                shaNiRounds(abef, cdgh, w3, 3);
+                for (u64 i = 4; i < 16; i += 4)
+                {
+                    shaNiSchedule(w0, w1, w2, w3); shaNiRounds(abef, cdgh, w0, i + 0);
+                    shaNiSchedule(w1, w2, w3, w0); shaNiRounds(abef, cdgh, w1, i + 1);
+                    shaNiSchedule(w2, w3, w0, w1); shaNiRounds(abef, cdgh, w2, i + 2);
+                    shaNiSchedule(w3, w0, w1, w2); shaNiRounds(abef, cdgh, w3, i + 3);
+                }
+
+                abef = _mm_add_epi32(abef, abefSave);
+                cdgh = _mm_add_epi32(cdgh, cdghSave);
+            }
+
+            __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+            __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+            _mm_storeu_si128((__m128i*)state, _mm_blend_epi16(feba, dchg, 0xF0));
+            _mm_storeu_si128((__m128i*)(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+        }
+    }
+
+    void SHA256::compress(u32 state[8], const u8* blocks, u64 numBlocks)
+    {
+        if (cpuFeatures().mSHA)
+            compressShaNi(state, blocks, numBlocks);
+        else
+            compressScalar(state, blocks, numBlocks);
+    }
+
+    void SHA256::Reset(u64 outputLength)
+    {
+        if (outputLength > HashSize)
+            throw std::runtime_error("SHA256 output length must be at most 32 bytes. " LOCATION);
+
+        std::memcpy(mState.data(), sha256IV, sizeof(sha256IV));
+        mBufferIdx = 0;
+        mLength = 0;
+        mOutputLength = outputLength;
+    }
+
+    void SHA256::update(const u8* dataIn, u64 length)
+    {
+        mLength += length;
+
+        if (mBufferIdx)
+        {
+            u64 step = std::min<u64>(length, 64 - mBufferIdx);
+            std::memcpy(mBuffer.data() + mBufferIdx, dataIn, step);
+            mBufferIdx += step;
+            dataIn += step;
+            length -= step;
+
+            if (mBufferIdx < 64)
+                return;
+
+            compress(mState.data(), mBuffer.data(), 1);
+            mBufferIdx = 0;
+        }
+
+        // whole blocks are compressed straight from the input.
+        u64 numBlocks = length / 64;
+        compress(mState.data(), dataIn, numBlocks);
+        dataIn += numBlocks * 64;
+        length -= numBlocks * 64;
+
+        std::memcpy(mBuffer.data(), dataIn, length);
+        mBufferIdx = length;
+    }
+
+    void SHA256::Final(u8* DataOut)
+    {
+        // a one bit, zeros and the 64 bit length in bits, big endian.
+        u64 bitLength = mLength * 8;
+        u8 padding[72] = { 0x80 };
+        u64 padLength = (mBufferIdx < 56 ? 56 : 120) - mBufferIdx;
+        for (u64 i = 0; i < 8; ++i)
+            padding[padLength + i] = u8(bitLength >> (56 - 8 * i));
+        update(padding, padLength + 8);
+
+        u8 digest[HashSize];
+        for (u64 i = 0; i < 8; ++i)
+            for (u64 j = 0; j < 4; ++j)
+                digest[4 * i + j] = u8(mState[i] >> (24 - 8 * j));
+        std::memcpy(DataOut, digest, mOutputLength);
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+#include <cryptoTools/Common/Defines.h>
+#include <array>
+#include <type_traits>
+#include <cstring>
+
+namespace osuCrypto {
+
+    // SHA-256, with the same interface as SHA1. The compression function
+    // uses the SHA extensions when the CPU has them.
+    class SHA256
+    {
+    public:
+        // The size of the SHA digest output by Final(...);
+        static const u64 HashSize = 32;
+
+        // Default constructor of the class. Initializes the internal state.
+        SHA256(u64 outputLength = HashSize) { Reset(outputLength); }
+
+        // Resets the interal state.
+        void Reset()
+        {
+            Reset(outputLength());
+        }
+
+        // Resets the interal state and sets the output length in bytes. A
+        // shorter output is a prefix of the SHA-256 digest.
+        void Reset(u64 outputLength);
+
+        // Add length bytes pointed to by dataIn to the internal state.
+        template<typename T>
+        typename std::enable_if<std::is_pod<T>::value>::type Update(const T* dataIn, u64 length)
+        {
+            update((const u8*)dataIn, length * sizeof(T));
+        }
+
+        template<typename T>
+        typename std::enable_if<std::is_pod<T>::value && !std::is_pointer<T>::value>::type Update(const T& blk)
+        {
+            Update((u8*)&blk, sizeof(T));
+        }
+
+        // Finalize the SHA-256 hash and output the result to DataOut.
+        // Required: DataOut must be at least outputLength() bytes long.
+        void Final(u8* DataOut);
+
+        // Finalize the SHA-256 hash and output the result to out.
+        template<typename T>
+        typename std::enable_if<std::is_pod<T>::value && sizeof(T) <= HashSize && std::is_pointer<T>::value == false>::type
+            Final(T& out)
+        {
+            if (sizeof(T) != outputLength())
+                throw std::runtime_error(LOCATION);
+            Final((u8*)&out);
+        }
+
+        u64 outputLength() const { return mOutputLength; }
+
+        // Applies the compression function to numBlocks 64 byte blocks.
+        static void compress(u32 state[8], const u8* blocks, u64 numBlocks);
+
+    private:
+        void update(const u8* dataIn, u64 length);
+
+        std::array<u32, 8> mState;
+        std::array<u8, 64> mBuffer;
+        u64 mBufferIdx, mLength, mOutputLength;
+    };
+}
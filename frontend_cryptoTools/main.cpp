@@ -9,6 +9,8 @@
 using namespace osuCrypto;
 #include <sstream>
 #include <fstream>
+#include <chrono>
+#include <cryptoTools/Crypto/PRNGBackends.h>
 
 //#include <cryptoTools/Common/Backtrace.h>
 
@@ -140,9 +142,41 @@ void print_aes_bristol()
 }
 #endif
 
+// Reports the throughput of get(...) for a PRNG with the given backend.
+template<typename Backend>
+void prngBenchmark(std::string name, u64 numBytes)
+{
+    std::vector<u8> buff(u64(1) << 24);
+    BasicPRNG<Backend> prng(toBlock(1, 2));
+
+    auto start = std::chrono::steady_clock::now();
+    for (u64 i = 0; i < numBytes; i += buff.size())
+        prng.get(buff.data(), buff.size());
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << name << " " << numBytes / seconds / 1e9 << " GB/s" << std::endl;
+}
+
+void prngBenchmark(const CLP& cmd)
+{
+    u64 numBytes = cmd.getOr<u64>("mb", 1024) << 20;
+    prngBenchmark<AesCtrBackend>   ("AES-CTR   ", numBytes);
+    prngBenchmark<Aes256CtrBackend>("AES256-CTR", numBytes);
+    prngBenchmark<Blake2XbBackend> ("Blake2Xb  ", numBytes);
+    prngBenchmark<ChaChaBackend>   ("ChaCha20  ", numBytes);
+}
+
 int main(int argc, char** argv)
 {
     CLP cmd(argc, argv);
+
+    if (cmd.isSet("prng"))
+    {
+        prngBenchmark(cmd);
+        return 0;
+    }
+
     cmd.set("u");
 
 #ifdef ENABLE_CIRCUITS
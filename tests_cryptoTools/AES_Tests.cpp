@@ -7,7 +7,11 @@
 #include "Common.h"
 #include <cryptoTools/Common/Defines.h>
 #include <cryptoTools/Crypto/AES.h> 
+#include <cryptoTools/Crypto/AESStream.h>
+#include <cryptoTools/Crypto/PRNG.h>
 #include <cryptoTools/Common/Log.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cryptoTools/Common/Finally.h>
 
 using namespace osuCrypto;
 
@@ -61,8 +65,426 @@ namespace tests_cryptoTools
                 throw UnitTestFail();
         }
 
+        decKey.ecbDecBlocks(cyphertext2, plaintext);
+        for (u64 i = 0; i < length; ++i)
+        {
+            if (neq(data[i], plaintext[i]))
+                throw UnitTestFail();
+        }
+
+        std::array<block, 16> pt;
+        decKey.ecbDecTwoBlocks(cyphertext1.data(), pt.data());
+        decKey.ecbDecFourBlocks(cyphertext1.data() + 2, pt.data() + 2);
+        decKey.ecbDec8Blocks(cyphertext1.data() + 6, pt.data() + 6);
+        for (u64 i = 0; i < 14; ++i)
+        {
+            if (neq(data[i], pt[i]))
+                throw UnitTestFail();
+        }
+
+        decKey.ecbDec16Blocks(cyphertext1.data() + 16, pt.data());
+        for (u64 i = 0; i < 16; ++i)
+        {
+            if (neq(data[i + 16], pt[i]))
+                throw UnitTestFail();
+        }
+    }
+
+    void AES_dispatch_Test()
+    {
+        block userKey = _mm_set_epi64x(12345678, 1234567);
+        AES encKey(userKey);
+        AESDec decKey(userKey);
+
+        u64 baseIdx = 1ull << 40;
+        std::vector<u64> lengths{ 0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 100, 1000 };
+
+        // all wide kernels, only the 256 bit ones, only SSE, software.
+        forEachCpuConfig({ { &CpuFeatures::mAVX512F }, { &CpuFeatures::mVAES }, { &CpuFeatures::mAES } }, [&]() {
+            for (auto length : lengths)
+            {
+                std::vector<block> data(length), expected(length), ctrExpected(length), ciphertext(length);
+
+                for (u64 i = 0; i < length; ++i)
+                {
+                    data[i] = _mm_set_epi64x(i * 3, i * 7 + 1);
+                    expected[i] = encKey.ecbEncBlock(data[i]);
+                    ctrExpected[i] = encKey.ecbEncBlock(_mm_set1_epi64x(baseIdx + i));
+                }
+
+                encKey.ecbEncBlocks(data, ciphertext);
+                for (u64 i = 0; i < length; ++i)
+                    if (neq(expected[i], ciphertext[i]))
+                        throw UnitTestFail("ecbEncBlocks " LOCATION);
+
+                std::vector<block> plaintext(length);
+                decKey.ecbDecBlocks(ciphertext, plaintext);
+                for (u64 i = 0; i < length; ++i)
+                    if (neq(data[i], plaintext[i]))
+                        throw UnitTestFail("ecbDecBlocks " LOCATION);
+
+                encKey.ecbEncCounterMode(baseIdx, ciphertext);
+                for (u64 i = 0; i < length; ++i)
+                    if (neq(ctrExpected[i], ciphertext[i]))
+                        throw UnitTestFail("ecbEncCounterMode " LOCATION);
+
+                // a permutation of the indices.
+                std::vector<u64> destIdxs(length);
+                for (u64 i = 0; i < length; ++i)
+                    destIdxs[i] = length % 7 ? (i * 7 + 3) % length : length - 1 - i;
+
+                encKey.ecbEncCounterMode(baseIdx, destIdxs, ciphertext);
+                for (u64 i = 0; i < length; ++i)
+                    if (neq(ctrExpected[i], ciphertext[destIdxs[i]]))
+                        throw UnitTestFail("ecbEncCounterMode scatter " LOCATION);
+            }
+        });
+    }
+
+    namespace
+    {
+        // Checks the batch, counter mode and decryption kernels of one key
+        // size against the single block code.
+        template<int KeyBits>
+        void AES_keySize_check(const typename AESBase<KeyBits>::Key& userKey)
+        {
+            AESBase<KeyBits> encKey(userKey);
+            AESDecBase<KeyBits> decKey(userKey);
+
+            u64 length = 100, baseIdx = 1ull << 40;
+            std::vector<block> data(length), ciphertext(length), plaintext(length);
+            for (u64 i = 0; i < length; ++i)
+                data[i] = _mm_set_epi64x(i * 3, i * 7 + 1);
+
+            encKey.ecbEncBlocks(data, ciphertext);
+            decKey.ecbDecBlocks(ciphertext, plaintext);
+            for (u64 i = 0; i < length; ++i)
+            {
+                if (neq(encKey.ecbEncBlock(data[i]), ciphertext[i]))
+                    throw UnitTestFail("ecbEncBlocks " LOCATION);
+                if (neq(decKey.ecbDecBlock(ciphertext[i]), data[i]) || neq(data[i], plaintext[i]))
+                    throw UnitTestFail("ecbDecBlocks " LOCATION);
+            }
+
+            std::array<block, 16> ct;
+            encKey.ecbEncTwoBlocks(data.data(), ct.data());
+            encKey.ecbEncFourBlocks(data.data() + 2, ct.data() + 2);
+            encKey.ecbEnc8Blocks(data.data() + 6, ct.data() + 6);
+            for (u64 i = 0; i < 14; ++i)
+                if (neq(ciphertext[i], ct[i]))
+                    throw UnitTestFail(LOCATION);
+
+            encKey.ecbEnc16Blocks(data.data() + 16, ct.data());
+            for (u64 i = 0; i < 16; ++i)
+                if (neq(ciphertext[i + 16], ct[i]))
+                    throw UnitTestFail(LOCATION);
+
+            encKey.ecbEncCounterMode(baseIdx, ciphertext);
+            for (u64 i = 0; i < length; ++i)
+                if (neq(encKey.ecbEncBlock(_mm_set1_epi64x(baseIdx + i)), ciphertext[i]))
+                    throw UnitTestFail("ecbEncCounterMode " LOCATION);
+        }
+    }
+
+    void AES_keySizes_Test()
+    {
+        // FIPS-197 appendix C: key 00 01 02 ..., plaintext 00 11 22 ... ff.
+        std::array<u8, 32> keyBytes;
+        std::array<u8, 16> ptBytes;
+        for (u64 i = 0; i < 32; ++i) keyBytes[i] = u8(i);
+        for (u64 i = 0; i < 16; ++i) ptBytes[i] = u8(i * 0x11);
+
+        std::array<block, 2> key{ { toBlock(keyBytes.data()), toBlock(keyBytes.data() + 16) } };
+        block pt = toBlock(ptBytes.data());
+
+        std::array<u8, 16> exp128{ { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a } };
+        std::array<u8, 16> exp192{ { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0, 0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 } };
+        std::array<u8, 16> exp256{ { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 } };
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX512F }, { &CpuFeatures::mVAES }, { &CpuFeatures::mAES } }, [&]() {
+            if (neq(AES(key[0]).ecbEncBlock(pt), toBlock(exp128.data())) ||
+                neq(AESDec(key[0]).ecbDecBlock(toBlock(exp128.data())), pt))
+                throw UnitTestFail("AES-128 " LOCATION);
+
+            // only the low 64 bits of the second key block are used by AES-192.
+            std::array<block, 2> key192{ { key[0], _mm_set_epi64x(-1, _mm_cvtsi128_si64(key[1])) } };
+            if (neq(AES192(key192).ecbEncBlock(pt), toBlock(exp192.data())) ||
+                neq(AESDec192(key192).ecbDecBlock(toBlock(exp192.data())), pt))
+                throw UnitTestFail("AES-192 " LOCATION);
+
+            if (neq(AES256(key).ecbEncBlock(pt), toBlock(exp256.data())) ||
+                neq(AESDec256(key).ecbDecBlock(toBlock(exp256.data())), pt))
+                throw UnitTestFail("AES-256 " LOCATION);
+
+            AES_keySize_check<128>(key[0]);
+            AES_keySize_check<192>(key);
+            AES_keySize_check<256>(key);
+        });
+    }
+
+    void AES_multiKey_Test()
+    {
+        forEachCpuConfig({ { &CpuFeatures::mAES } }, [&]() {
+            for (u64 n : { 0, 1, 7, 8, 9, 100 })
+            {
+                std::vector<block> keys(n);
+                for (u64 i = 0; i < n; ++i)
+                    keys[i] = _mm_set_epi64x(i * 31 + 5, i * 17);
+
+                DynamicMultiKeyAES multi(keys);
+                if (multi.size() != n)
+                    throw UnitTestFail(LOCATION);
+
+                std::vector<AES> single(keys.begin(), keys.end());
+                for (u64 i = 0; i < n; ++i)
+                    for (u64 j = 0; j <= AES::Rounds; ++j)
+                        if (neq(multi[i].mRoundKey[j], single[i].mRoundKey[j]))
+                            throw UnitTestFail("key schedule " LOCATION);
+
+                block pt = _mm_set_epi64x(42, 24);
+                std::vector<block> ct(n);
+                multi.ecbEncBlock(pt, ct);
+                for (u64 i = 0; i < n; ++i)
+                    if (neq(ct[i], single[i].ecbEncBlock(pt)))
+                        throw UnitTestFail("ecbEncBlock " LOCATION);
+
+                u64 baseIdx = 1ull << 40;
+                for (u64 blocksPerKey : { 1, 3, 8, 10 })
+                {
+                    std::vector<block> data(n * blocksPerKey), ciphertext(n * blocksPerKey);
+                    for (u64 t = 0; t < data.size(); ++t)
+                        data[t] = _mm_set_epi64x(t, t * 3);
+
+                    multi.ecbEncBlocks(data, ciphertext);
+                    for (u64 i = 0; i < n; ++i)
+                        for (u64 j = 0; j < blocksPerKey; ++j)
+                            if (neq(ciphertext[i * blocksPerKey + j], single[i].ecbEncBlock(data[i * blocksPerKey + j])))
+                                throw UnitTestFail("ecbEncBlocks " LOCATION);
+
+                    multi.ecbEncCounterMode(baseIdx, ciphertext);
+                    for (u64 i = 0; i < n; ++i)
+                        for (u64 j = 0; j < blocksPerKey; ++j)
+                            if (neq(ciphertext[i * blocksPerKey + j], single[i].ecbEncBlock(_mm_set1_epi64x(baseIdx + j))))
+                                throw UnitTestFail("ecbEncCounterMode " LOCATION);
+                }
+            }
+
+            std::array<block, 9> keys;
+            for (u64 i = 0; i < keys.size(); ++i)
+                keys[i] = _mm_set_epi64x(i, ~i);
+            MultiKeyAES<9> fixed(keys);
+            for (u64 i = 0; i < keys.size(); ++i)
+                for (u64 j = 0; j <= AES::Rounds; ++j)
+                    if (neq(fixed.mAESs[i].mRoundKey[j], AES(keys[i]).mRoundKey[j]))
+                        throw UnitTestFail("MultiKeyAES " LOCATION);
+
+            std::array<block, 9> pts, cts;
+            for (u64 i = 0; i < pts.size(); ++i)
+                pts[i] = _mm_set_epi64x(i * 7, i + 1);
+            fixed.ecbEncNBlocks(pts.data(), cts.data());
+            for (u64 i = 0; i < keys.size(); ++i)
+                if (neq(cts[i], AES(keys[i]).ecbEncBlock(pts[i])))
+                    throw UnitTestFail("MultiKeyAES " LOCATION);
+        });
     }
 
+    void AES_hash_Test()
+    {
+        AES aes(_mm_set_epi64x(12345678, 1234567));
+        auto sigma = [](block x) { return _mm_set_epi64x(
+            _mm_extract_epi64(x, 1) ^ _mm_extract_epi64(x, 0),
+            _mm_extract_epi64(x, 1)); };
+
+        u64 tweakIdx = 1ull << 33;
+        forEachCpuConfig({ { &CpuFeatures::mAVX512F }, { &CpuFeatures::mVAES }, { &CpuFeatures::mAES } }, [&]() {
+            for (u64 length : { 0, 1, 7, 8, 15, 16, 17, 33, 100 })
+            {
+                std::vector<block> x(length), tweaks(length), out(length), inPlace(length);
+                for (u64 i = 0; i < length; ++i)
+                {
+                    x[i] = _mm_set_epi64x(i * 3, i * 7 + 1);
+                    tweaks[i] = toBlock(tweakIdx + i);
+                }
+
+                inPlace = x;
+                aes.hashBlocks(x, out);
+                aes.hashBlocks(inPlace, inPlace);
+                for (u64 i = 0; i < length; ++i)
+                {
+                    auto exp = aes.ecbEncBlock(x[i]) ^ x[i];
+                    if (neq(out[i], exp) || neq(inPlace[i], exp) || neq(aes.hashBlock(x[i]), exp))
+                        throw UnitTestFail("hashBlocks " LOCATION);
+                }
+
+                aes.ccrHashBlocks(x, out);
+                for (u64 i = 0; i < length; ++i)
+                {
+                    auto s = sigma(x[i]);
+                    auto exp = aes.ecbEncBlock(s) ^ s;
+                    if (neq(out[i], exp) || neq(aes.ccrHashBlock(x[i]), exp))
+                        throw UnitTestFail("ccrHashBlocks " LOCATION);
+                }
+
+                aes.tccrHashBlocks(x, tweaks, out);
+                aes.tccrHashBlocks(x, tweakIdx, inPlace);
+                for (u64 i = 0; i < length; ++i)
+                {
+                    auto t = aes.ecbEncBlock(x[i]);
+                    auto exp = aes.ecbEncBlock(t ^ tweaks[i]) ^ t;
+                    if (neq(out[i], exp) || neq(inPlace[i], exp) || neq(aes.tccrHashBlock(x[i], tweaks[i]), exp))
+                        throw UnitTestFail("tccrHashBlocks " LOCATION);
+                }
+            }
+        });
+    }
+
+    void AES_bitsliced_Test()
+    {
+        auto detected = detectCpuFeatures();
+        Finally restore([&]() { setCpuFeatures(detected); });
+
+        // The outputs of the default implementation, AES-NI if the CPU has it.
+        std::array<block, 2> key{ { _mm_set_epi64x(12345678, 1234567), _mm_set_epi64x(-3, 42) } };
+        AES aes(key[0]);
+        AESDec dec(key[0]);
+        AES192 aes192(key);
+        AESDec192 dec192(key);
+        AES256 aes256(key);
+        AESDec256 dec256(key);
+
+        u64 length = 100;
+        std::vector<block> data(length), ct(length), ct192(length), ct256(length), ctFixed(length), out(length);
+        for (u64 i = 0; i < length; ++i)
+            data[i] = _mm_set_epi64x(i * 3, i * 7 + 1);
+        aes.ecbEncBlocks(data, ct);
+        aes192.ecbEncBlocks(data, ct192);
+        aes256.ecbEncBlocks(data, ct256);
+        mAesFixedKey.ecbEncBlocks(data, ctFixed);
+
+        std::vector<block> keys(11);
+        for (u64 i = 0; i < keys.size(); ++i)
+            keys[i] = _mm_set_epi64x(i * 31 + 5, i * 17);
+        std::vector<block> multiCt(keys.size());
+        DynamicMultiKeyAES(keys).ecbEncBlock(data[1], multiCt);
+        std::vector<block> tccr(length - 3), ctOther(length);
+        aes.tccrHashBlocks(data.data(), 7, tccr.size(), tccr.data());
+        AES(keys[0]).ecbEncBlocks(data, ctOther);
+
+        auto software = detected;
+        software.mAES = false;
+        setCpuFeatures(software);
+
+        auto check = [](const block* a, const block* b, u64 n) {
+            for (u64 i = 0; i < n; ++i)
+                if (neq(a[i], b[i]))
+                    return false;
+            return true;
+        };
+
+        if (!check(AES(key[0]).mRoundKey, aes.mRoundKey, AES::Rounds + 1) ||
+            !check(AESDec(key[0]).mRoundKey, dec.mRoundKey, AES::Rounds + 1) ||
+            !check(AES192(key).mRoundKey, aes192.mRoundKey, AES192::Rounds + 1) ||
+            !check(AESDec192(key).mRoundKey, dec192.mRoundKey, AES192::Rounds + 1) ||
+            !check(AES256(key).mRoundKey, aes256.mRoundKey, AES256::Rounds + 1) ||
+            !check(AESDec256(key).mRoundKey, dec256.mRoundKey, AES256::Rounds + 1))
+            throw UnitTestFail("key schedule " LOCATION);
+
+        aes.ecbEncBlocks(data, out);
+        if (!check(out.data(), ct.data(), length))
+            throw UnitTestFail("AES-128 " LOCATION);
+        dec.ecbDecBlocks(ct, out);
+        if (!check(out.data(), data.data(), length))
+            throw UnitTestFail("AES-128 dec " LOCATION);
+
+        aes192.ecbEncBlocks(data, out);
+        if (!check(out.data(), ct192.data(), length))
+            throw UnitTestFail("AES-192 " LOCATION);
+        dec192.ecbDecBlocks(ct192, out);
+        if (!check(out.data(), data.data(), length))
+            throw UnitTestFail("AES-192 dec " LOCATION);
+
+        aes256.ecbEncBlocks(data, out);
+        if (!check(out.data(), ct256.data(), length))
+            throw UnitTestFail("AES-256 " LOCATION);
+        dec256.ecbDecBlocks(ct256, out);
+        if (!check(out.data(), data.data(), length))
+            throw UnitTestFail("AES-256 dec " LOCATION);
+
+        mAesFixedKey.ecbEncBlocks(data, out);
+        if (!check(out.data(), ctFixed.data(), length))
+            throw UnitTestFail("mAesFixedKey " LOCATION);
+
+        DynamicMultiKeyAES(keys).ecbEncBlock(data[1], out.data());
+        if (!check(out.data(), multiCt.data(), keys.size()))
+            throw UnitTestFail("DynamicMultiKeyAES " LOCATION);
+
+        // a key set without AES-NI keeps its bitsliced schedule, which is
+        // not used once mRoundKey is overwritten.
+        AES sw(key[0]);
+        sw.tccrHashBlocks(data.data(), 7, tccr.size(), out.data());
+        if (!check(out.data(), tccr.data(), tccr.size()) ||
+            neq(sw.ecbEncBlock(data[5]), ct[5]))
+            throw UnitTestFail("cached schedule " LOCATION);
+
+        AES other(keys[0]);
+        std::copy(other.mRoundKey, other.mRoundKey + AES::Rounds + 1, sw.mRoundKey);
+        sw.ecbEncBlocks(data, out);
+        if (!check(out.data(), ctOther.data(), length))
+            throw UnitTestFail("stale schedule " LOCATION);
+    }
+
+    void AES_stream_Test()
+    {
+        block key = _mm_set_epi64x(12345678, 1234567);
+        block nonce = _mm_set_epi64x(-5, 77);
+        AES aes(key);
+
+        // the keystream at an unaligned address.
+        u64 length = 3001;
+        std::vector<u8> buff(length + 1), expected(length);
+        u8* data = buff.data() + 1;
+        for (u64 i = 0; i < length; i += 16)
+        {
+            block ks = aes.ecbEncBlock(_mm_set1_epi64x(i / 16) ^ nonce);
+            memcpy(expected.data() + i, &ks, std::min<u64>(16, length - i));
+        }
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX512F }, { &CpuFeatures::mVAES }, { &CpuFeatures::mAES } }, [&]() {
+            // one call, and then the same stream in chunks of odd sizes.
+            AESStream stream(key, nonce);
+            memset(data, 0, length);
+            stream.xorKeystream(data, length);
+            if (memcmp(data, expected.data(), length) || stream.position() != length)
+                throw UnitTestFail(LOCATION);
+
+            stream.seek(0);
+            for (u64 i = 0, step = 0; i < length; i += step)
+            {
+                step = std::min<u64>(length - i, 1 + (i * 7 + 3) % 75);
+                stream.xorKeystream(data + i, step);
+            }
+            for (u64 i = 0; i < length; ++i)
+                if (data[i])
+                    throw UnitTestFail(LOCATION);
+
+            for (u64 pos : { 0, 1, 15, 16, 17, 1000, 2999 })
+            {
+                memset(data, 0, length);
+                stream.seek(pos);
+                stream.xorKeystream(data, length - pos);
+                if (memcmp(data, expected.data() + pos, length - pos) || stream.position() != length)
+                    throw UnitTestFail(LOCATION);
+            }
+
+            // with a zero nonce the stream is the PRNG output.
+            std::vector<u8> prngBytes(length);
+            PRNG(key).get(prngBytes.data(), length);
+            memset(data, 0, length);
+            AESStream(key).xorKeystream(data, length);
+            if (memcmp(data, prngBytes.data(), length))
+                throw UnitTestFail(LOCATION);
+        });
+    }
 
     //}
 }
\ No newline at end of file
@@ -5,4 +5,10 @@ namespace tests_cryptoTools
 {
 
     void AES_EncDec_Test();
+    void AES_dispatch_Test();
+    void AES_keySizes_Test();
+    void AES_multiKey_Test();
+    void AES_hash_Test();
+    void AES_bitsliced_Test();
+    void AES_stream_Test();
 }
\ No newline at end of file
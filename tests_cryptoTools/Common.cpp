@@ -1,6 +1,7 @@
 //#include "stdafx.h"
 #include "Common.h"
 #include <cryptoTools/Common/Log.h>
+#include <cryptoTools/Common/Finally.h>
 
 #include <fstream>
 #include <cassert> 
@@ -37,4 +38,24 @@ namespace tests_cryptoTools
         //Log::SetSink(*file); 
     }
 
+    void forEachCpuConfig(
+        const std::vector<std::vector<bool CpuFeatures::*>>& disabled,
+        const std::function<void()>& fn)
+    {
+        auto detected = detectCpuFeatures();
+        Finally restore([&]() { setCpuFeatures(detected); });
+
+        setCpuFeatures(detected);
+        fn();
+
+        for (auto& features : disabled)
+        {
+            auto config = detected;
+            for (auto f : features)
+                config.*f = false;
+
+            setCpuFeatures(config);
+            fn();
+        }
+    }
 }
\ No newline at end of file
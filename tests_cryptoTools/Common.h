@@ -1,6 +1,9 @@
 #pragma once
 // This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use. 
 #include <string>
+#include <vector>
+#include <functional>
+#include <cryptoTools/Common/CpuFeatures.h>
 
 
 namespace tests_cryptoTools
@@ -11,6 +14,16 @@ namespace tests_cryptoTools
     //
     extern std::string SolutionDir;
 
+    // Runs fn with the detected CPU features, then once for each entry of
+    // disabled with those features turned off, e.g.
+    //
+    //     forEachCpuConfig({ { &CpuFeatures::mAVX512F }, { &CpuFeatures::mAES } }, [&]() { ... });
+    //
+    // The detected features are restored afterwards, also if fn throws.
+    void forEachCpuConfig(
+        const std::vector<std::vector<bool osuCrypto::CpuFeatures::*>>& disabled,
+        const std::function<void()>& fn);
+
     class UnitTestFail : public std::exception
     {
         std::string mWhat;
@@ -0,0 +1,109 @@
+#include "GF128_Tests.h"
+
+#include <vector>
+
+#include "Common.h"
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cryptoTools/Crypto/GF128.h>
+#include <cryptoTools/Crypto/PRNG.h>
+
+using namespace osuCrypto;
+
+namespace tests_cryptoTools
+{
+    namespace
+    {
+        // a * b one bit of b at a time, reducing a * x as it goes.
+        block mulReference(block a, const block& b)
+        {
+            u64 bb[2] = { u64(_mm_cvtsi128_si64(b)), u64(_mm_extract_epi64(b, 1)) };
+            block ret = ZeroBlock;
+            for (u64 i = 0; i < 128; ++i)
+            {
+                if ((bb[i / 64] >> (i % 64)) & 1)
+                    ret = ret ^ a;
+
+                u64 lo = _mm_cvtsi128_si64(a), hi = _mm_extract_epi64(a, 1);
+                u64 carry = hi >> 63;
+                a = toBlock((hi << 1) | (lo >> 63), (lo << 1) ^ (carry ? 0x87 : 0));
+            }
+            return ret;
+        }
+    }
+
+    void GF128_mul_Test()
+    {
+        PRNG prng(toBlock(19, 20));
+        forEachCpuConfig({ { &CpuFeatures::mVPCLMUL }, { &CpuFeatures::mVPCLMUL, &CpuFeatures::mPCLMUL } }, [&]() {
+            // x^127 * x = x^128 = x^7 + x^2 + x + 1.
+            if (neq(gf128Mul(toBlock(1ull << 63, 0), toBlock(2)), toBlock(0x87)))
+                throw UnitTestFail(LOCATION);
+
+            for (u64 t = 0; t < 100; ++t)
+            {
+                block a = prng.get<block>(), b = prng.get<block>(), c = prng.get<block>();
+                block ab = gf128Mul(a, b);
+                if (neq(ab, mulReference(a, b)) || neq(ab, gf128Mul(b, a)))
+                    throw UnitTestFail(LOCATION);
+
+                if (neq(gf128Mul(a, b ^ c), ab ^ gf128Mul(a, c)))
+                    throw UnitTestFail(LOCATION);
+
+                if (neq(gf128Square(a), gf128Mul(a, a)))
+                    throw UnitTestFail(LOCATION);
+
+                if (neq(gf128Mul(a, gf128Inverse(a)), OneBlock))
+                    throw UnitTestFail(LOCATION);
+
+                if (neq(gf128Pow(a, 5), gf128Mul(gf128Mul(gf128Square(gf128Square(a)), OneBlock), a)))
+                    throw UnitTestFail(LOCATION);
+
+                block lo, hi;
+                gf128MulUnreduced(a, b, lo, hi);
+                if (neq(gf128Reduce(lo, hi), ab))
+                    throw UnitTestFail(LOCATION);
+            }
+
+            bool thrown = false;
+            try { gf128Inverse(ZeroBlock); }
+            catch (std::exception&) { thrown = true; }
+            if (!thrown)
+                throw UnitTestFail(LOCATION);
+        });
+    }
+
+    void GF128_batch_Test()
+    {
+        PRNG prng(toBlock(21, 22));
+        forEachCpuConfig({ { &CpuFeatures::mVPCLMUL }, { &CpuFeatures::mVPCLMUL, &CpuFeatures::mPCLMUL } }, [&]() {
+            for (u64 n : { 0, 1, 3, 4, 7, 1001 })
+            {
+                std::vector<block> a(n), b(n), c(n);
+                prng.get(a.data(), n);
+                prng.get(b.data(), n);
+
+                block expected = ZeroBlock;
+                for (u64 i = 0; i < n; ++i)
+                    expected = expected ^ mulReference(a[i], b[i]);
+                if (neq(gf128InnerProduct(a, b), expected))
+                    throw UnitTestFail(LOCATION);
+
+                block x = prng.get<block>();
+                gf128Mul(a, x, c);
+                for (u64 i = 0; i < n; ++i)
+                    if (neq(c[i], mulReference(a[i], x)))
+                        throw UnitTestFail(LOCATION);
+
+                gf128Powers(x, c);
+                block p = OneBlock;
+                for (u64 i = 0; i < n; ++i)
+                {
+                    if (neq(c[i], p))
+                        throw UnitTestFail(LOCATION);
+                    p = mulReference(p, x);
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,85 @@
+#include "GgmTree_Tests.h"
+
+#include <vector>
+
+#include "Common.h"
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/GgmTree.h>
+#include <cryptoTools/Crypto/PRNG.h>
+#include <cryptoTools/Common/Log.h>
+
+using namespace osuCrypto;
+
+namespace tests_cryptoTools
+{
+    namespace
+    {
+        // The leaves of the tree below node, one node at a time.
+        void expandReference(const block& node, u64 depth, block* leaves)
+        {
+            if (depth == 0)
+            {
+                *leaves = node;
+                return;
+            }
+
+            u64 half = u64(1) << (depth - 1);
+            expandReference(GgmTree::Aes[0].hashBlock(node), depth - 1, leaves);
+            expandReference(GgmTree::Aes[1].hashBlock(node), depth - 1, leaves + half);
+        }
+    }
+
+    void GgmTree_expand_Test()
+    {
+        PRNG prng(_mm_set_epi64x(12345678, 1234567));
+        std::vector<block> roots(3);
+        prng.get(roots.data(), roots.size());
+
+        for (u64 depth : { 0, 1, 5, 13 })
+        {
+            std::vector<block> expected(roots.size() << depth), leaves(expected.size());
+            for (u64 t = 0; t < roots.size(); ++t)
+                expandReference(roots[t], depth, expected.data() + (t << depth));
+
+            for (auto layout : { GgmTree::Layout::BreadthFirst, GgmTree::Layout::DepthFirst })
+            {
+                for (u64 numThreads : { 1, 3 })
+                {
+                    std::fill(leaves.begin(), leaves.end(), ZeroBlock);
+                    GgmTree::expand(roots, depth, leaves, layout, numThreads);
+                    for (u64 i = 0; i < leaves.size(); ++i)
+                        if (neq(leaves[i], expected[i]))
+                            throw UnitTestFail(LOCATION);
+                }
+            }
+        }
+
+        bool threw = false;
+        try { std::vector<block> leaves(5); GgmTree::expand(roots, 1, leaves); }
+        catch (std::runtime_error&) { threw = true; }
+        if (threw == false)
+            throw UnitTestFail(LOCATION);
+    }
+
+    void GgmTree_puncture_Test()
+    {
+        PRNG prng(_mm_set_epi64x(12345678, 1234567));
+        block root = prng.get<block>();
+
+        for (u64 depth : { 1, 4, 12 })
+        {
+            std::vector<block> full(u64(1) << depth), leaves(full.size()), copath(depth);
+            GgmTree::expand({ &root, 1 }, depth, full);
+
+            for (u64 point : { u64(0), full.size() - 1, full.size() / 3 })
+            {
+                GgmTree::puncture(root, depth, point, copath);
+                GgmTree::expandPunctured(copath, point, leaves);
+
+                for (u64 i = 0; i < leaves.size(); ++i)
+                    if (neq(leaves[i], i == point ? ZeroBlock : full[i]))
+                        throw UnitTestFail(LOCATION);
+            }
+        }
+    }
+}
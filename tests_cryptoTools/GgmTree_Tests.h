@@ -0,0 +1,8 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+
+namespace tests_cryptoTools
+{
+    void GgmTree_expand_Test();
+    void GgmTree_puncture_Test();
+}
@@ -0,0 +1,324 @@
+#include "Hash_Tests.h"
+
+#include <array>
+#include <vector>
+
+#include "Common.h"
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cryptoTools/Crypto/Blake2.h>
+#include <cryptoTools/Crypto/PRNG.h>
+#include <cryptoTools/Crypto/sha1.h>
+#include <cryptoTools/Crypto/sha256.h>
+#include <cryptoTools/Crypto/VectorCommit.h>
+#include <string>
+
+using namespace osuCrypto;
+
+namespace tests_cryptoTools
+{
+    void Blake2_hashMany_Test()
+    {
+        PRNG prng(toBlock(7, 8));
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX512F }, { &CpuFeatures::mAVX512F, &CpuFeatures::mAVX2 } }, [&]() {
+            // messages that end inside, at and after a 128 byte block,
+            // and counts that leave some messages to the scalar code.
+            for (u64 msgLength : { 0, 1, 16, 33, 127, 128, 129, 300 })
+            {
+                for (u64 outLength : { 16, 20, 64 })
+                {
+                    for (u64 count : { 0, 3, 8, 13, 37 })
+                    {
+                        std::vector<u8> in(msgLength * count), out(outLength * count), expected(outLength * count);
+                        prng.get(in.data(), in.size());
+
+                        Blake2::hashMany(in.data(), msgLength, count, out.data(), outLength);
+
+                        Blake2 hasher(outLength);
+                        for (u64 i = 0; i < count; ++i)
+                        {
+                            hasher.Reset();
+                            hasher.Update(in.data() + i * msgLength, msgLength);
+                            hasher.Final(expected.data() + i * outLength);
+                        }
+
+                        if (out != expected)
+                            throw UnitTestFail(LOCATION);
+                    }
+                }
+            }
+
+            std::vector<block> in(21), out(21);
+            std::vector<std::array<u8, Blake2::HashSize>> digests(21);
+            prng.get(in.data(), in.size());
+            Blake2::hashMany<block, block>(in, out);
+            Blake2::hashMany<block, std::array<u8, Blake2::HashSize>>(in, digests);
+            for (u64 i = 0; i < in.size(); ++i)
+            {
+                Blake2 hasher(sizeof(block));
+                block expected;
+                hasher.Update(in[i]);
+                hasher.Final(expected);
+                if (neq(out[i], expected))
+                    throw UnitTestFail(LOCATION);
+
+                std::array<u8, Blake2::HashSize> digest;
+                hasher.Reset(Blake2::HashSize);
+                hasher.Update(in[i]);
+                hasher.Final(digest);
+                if (digest != digests[i])
+                    throw UnitTestFail(LOCATION);
+            }
+        });
+    }
+
+    void Blake2bp_Test()
+    {
+        PRNG prng(toBlock(9, 10));
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX2 } }, [&]() {
+            for (u64 length : { 0, 1, 511, 512, 513, 2048, 5000, 100000 })
+            {
+                std::vector<u8> in(length);
+                prng.get(in.data(), in.size());
+
+                for (u64 outLength : { 20, 64 })
+                {
+                    std::vector<u8> expected(outLength), out(outLength);
+                    blake2bp(expected.data(), outLength, in.data(), in.size(), nullptr, 0);
+
+                    // the input in pieces that start and end inside the 512 byte stripes.
+                    Blake2bp hasher(outLength);
+                    for (u64 i = 0; i < length; )
+                    {
+                        u64 size = std::min<u64>(length - i, prng.getUniform(3000));
+                        hasher.Update(in.data() + i, size);
+                        i += size;
+                    }
+                    hasher.Final(out.data());
+
+                    if (out != expected)
+                        throw UnitTestFail(LOCATION);
+                }
+            }
+        });
+    }
+
+    void Blake2Xb_Test()
+    {
+        PRNG prng(toBlock(11, 12));
+        std::vector<u8> in(300), key(32);
+        prng.get(in.data(), in.size());
+        prng.get(key.data(), key.size());
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX512F }, { &CpuFeatures::mAVX512F, &CpuFeatures::mAVX2 } }, [&]() {
+            for (u64 outLength : { 1, 63, 64, 65, 1000, 3000 })
+            {
+                std::vector<u8> expected(outLength), out(outLength);
+                blake2xb(expected.data(), outLength, in.data(), in.size(), key.data(), key.size());
+
+                Blake2Xb xof;
+                xof.Reset(outLength, key.data(), key.size());
+                xof.Update(in.data(), 100);
+                xof.Update(in.data() + 100, 200);
+                for (u64 i = 0; i < outLength; )
+                {
+                    u64 size = std::min<u64>(outLength - i, prng.getUniform(200));
+                    xof.Squeeze(out.data() + i, size);
+                    i += size;
+                }
+
+                if (out != expected)
+                    throw UnitTestFail(LOCATION);
+
+                bool thrown = false;
+                try { xof.Squeeze(out.data(), 1); }
+                catch (std::exception&) { thrown = true; }
+                if (!thrown)
+                    throw UnitTestFail("read past the output length " LOCATION);
+            }
+
+            // with an unknown output length, any part of the output can be read.
+            std::vector<u8> expected(64 * 37);
+            blake2xb_state state;
+            blake2xb_init(&state, Blake2Xb::UnknownOutputLength);
+            blake2xb_update(&state, in.data(), in.size());
+            blake2xb_final(&state, expected.data(), expected.size());
+
+            Blake2Xb xof;
+            xof.Update(in.data(), in.size());
+            xof.Final();
+            for (u64 t = 0; t < 20; ++t)
+            {
+                u64 offset = prng.getUniform(expected.size());
+                u64 length = prng.getUniform(expected.size() - offset + 1);
+                std::vector<u8> out(length);
+                xof.Output(offset, out.data(), length);
+                if (memcmp(out.data(), expected.data() + offset, length))
+                    throw UnitTestFail(LOCATION);
+            }
+
+            block first;
+            xof.Squeeze(first);
+            if (memcmp(&first, expected.data(), sizeof(block)))
+                throw UnitTestFail(LOCATION);
+        });
+    }
+
+    void SHA1_Test()
+    {
+        // the compression function on the padded block of "abc" from the IV.
+        std::array<u8, 64> abc{ { 'a', 'b', 'c', 0x80 } };
+        abc[63] = 24;
+        const std::array<u32, 5> expected{ { 0xa9993e36, 0x4706816a, 0xba3e2571, 0x7850c26c, 0x9cd0d89d } };
+
+        PRNG prng(toBlock(13, 14));
+        std::vector<u8> in(1000);
+        prng.get(in.data(), in.size());
+
+        std::vector<std::array<u8, SHA1::HashSize>> digests;
+        forEachCpuConfig({ { &CpuFeatures::mSHA } }, [&]() {
+            std::array<u32, 5> state{ { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 } };
+            sha1_compress(state.data(), abc.data());
+            if (state != expected)
+                throw UnitTestFail(LOCATION);
+
+            for (u64 length : { 0, 1, 64, 100, 1000 })
+            {
+                SHA1 sha;
+                sha.Update(in.data(), length);
+                digests.emplace_back();
+                sha.Final(digests.back());
+            }
+        });
+
+        for (u64 i = 0; i < digests.size() / 2; ++i)
+            if (digests[i] != digests[i + digests.size() / 2])
+                throw UnitTestFail(LOCATION);
+    }
+
+    void SHA256_Test()
+    {
+        std::vector<std::pair<std::string, std::string>> vectors{
+            { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+            { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+            { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+            { std::string(1000000, 'a'), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" }
+        };
+
+        PRNG prng(toBlock(15, 16));
+        forEachCpuConfig({ { &CpuFeatures::mSHA } }, [&]() {
+            for (auto& v : vectors)
+            {
+                // the message in pieces that start and end inside blocks.
+                SHA256 sha;
+                for (u64 i = 0; i < v.first.size(); )
+                {
+                    u64 size = std::min<u64>(v.first.size() - i, prng.getUniform(200));
+                    sha.Update(v.first.data() + i, size);
+                    i += size;
+                }
+
+                std::array<u8, SHA256::HashSize> digest;
+                sha.Final(digest);
+
+                std::string hex;
+                for (auto d : digest)
+                    hex += "0123456789abcdef"[d >> 4] + std::string(1, "0123456789abcdef"[d & 15]);
+                if (hex != v.second)
+                    throw UnitTestFail(LOCATION);
+
+                block truncated;
+                SHA256 sha16(sizeof(block));
+                sha16.Update(v.first.data(), v.first.size());
+                sha16.Final(truncated);
+                if (memcmp(&truncated, digest.data(), sizeof(block)))
+                    throw UnitTestFail(LOCATION);
+            }
+        });
+    }
+
+    void VectorCommit_Test()
+    {
+        PRNG prng(toBlock(17, 18));
+
+        for (u64 n : { 1, 2, 3, 7, 8, 100, 10000 })
+        {
+            std::vector<block> values(n);
+            prng.get(values.data(), n);
+
+            block seed = prng.get<block>();
+            PRNG prng1(seed), prng4(seed);
+            VectorCommit vc(values, prng1);
+            VectorCommit vc4(values, prng4, 4);
+            if (vc.size() != n || vc.root() != vc4.root())
+                throw UnitTestFail(LOCATION);
+
+            // single openings.
+            for (u64 t = 0; t < 10; ++t)
+            {
+                u64 i = prng.getUniform(n);
+                auto proof = vc.open(i);
+                if (proof.size() > log2ceil(n))
+                    throw UnitTestFail(LOCATION);
+
+                if (!VectorCommit::verify(vc.root(), n, i, values[i], vc.randomness(i), proof))
+                    throw UnitTestFail(LOCATION);
+
+                block wrong = values[i] ^ OneBlock;
+                if (VectorCommit::verify(vc.root(), n, i, wrong, vc.randomness(i), proof))
+                    throw UnitTestFail(LOCATION);
+
+                if (n > 1)
+                {
+                    auto other = (i + 1) % n;
+                    if (VectorCommit::verify(vc.root(), n, other, values[i], vc.randomness(i), proof))
+                        throw UnitTestFail(LOCATION);
+
+                    auto shortProof = proof;
+                    shortProof.pop_back();
+                    if (VectorCommit::verify(vc.root(), n, i, values[i], vc.randomness(i), shortProof))
+                        throw UnitTestFail(LOCATION);
+                }
+            }
+
+            // a random subset, whose paths share nodes.
+            std::vector<u64> idxs;
+            std::vector<block> opened, rands;
+            for (u64 i = 0; i < n; ++i)
+            {
+                if (i == 0 || prng.getUniform(4) == 0)
+                {
+                    idxs.push_back(i);
+                    opened.push_back(values[i]);
+                    rands.push_back(vc.randomness(i));
+                }
+            }
+
+            auto proof = vc.open(idxs);
+            u64 singles = 0;
+            for (auto i : idxs)
+                singles += vc.open(i).size();
+            if (proof.size() > singles || (idxs.size() > 1 && proof.size() == singles))
+                throw UnitTestFail("the paths are not shared " LOCATION);
+
+            if (!VectorCommit::verify(vc.root(), n, idxs, opened, rands, proof))
+                throw UnitTestFail(LOCATION);
+
+            opened.back() = opened.back() ^ OneBlock;
+            if (VectorCommit::verify(vc.root(), n, idxs, opened, rands, proof))
+                throw UnitTestFail(LOCATION);
+
+            // all leaves need no proof at all.
+            std::vector<u64> all(n);
+            for (u64 i = 0; i < n; ++i)
+                all[i] = i;
+            std::vector<block> allRands(n);
+            for (u64 i = 0; i < n; ++i)
+                allRands[i] = vc.randomness(i);
+            if (vc.open(all).size() || !VectorCommit::verify(vc.root(), n, all, values, allRands, {}))
+                throw UnitTestFail(LOCATION);
+        }
+    }
+}
@@ -0,0 +1,206 @@
+#include "Mersenne_Tests.h"
+
+#include <vector>
+
+#include "Common.h"
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cryptoTools/Crypto/Mersenne.h>
+#include <cryptoTools/Crypto/PRNG.h>
+
+using namespace osuCrypto;
+
+namespace tests_cryptoTools
+{
+    namespace
+    {
+        const u64 p61 = Mersenne61::Modulus;
+
+        // a * b mod p by double and add, one bit of b at a time.
+        u64 mul61Reference(u64 a, u64 b)
+        {
+            u64 ret = 0;
+            for (int i = 63; i >= 0; --i)
+            {
+                ret = (2 * ret) % p61;
+                if ((b >> i) & 1)
+                    ret = (ret + a) % p61;
+            }
+            return ret;
+        }
+
+        // a + b mod p, subtracting p when the sum is at least p.
+        block add127Reference(const block& a, const block& b)
+        {
+            u64 a0 = _mm_cvtsi128_si64(a), a1 = _mm_extract_epi64(a, 1);
+            u64 b0 = _mm_cvtsi128_si64(b), b1 = _mm_extract_epi64(b, 1);
+            u64 lo = a0 + b0;
+            u64 hi = a1 + b1 + (lo < a0);
+
+            // a, b < p so the sum is below 2^128 - 2 and has no carry out.
+            u64 p1 = ~0ULL >> 1, p0 = ~0ULL;
+            if (hi > p1 || (hi == p1 && lo >= p0))
+            {
+                hi -= p1 + (lo < p0);
+                lo -= p0;
+            }
+            return toBlock(hi, lo);
+        }
+
+        block mul127Reference(const block& a, const block& b)
+        {
+            u64 b0 = _mm_cvtsi128_si64(b), b1 = _mm_extract_epi64(b, 1);
+            block ret = ZeroBlock;
+            for (int i = 127; i >= 0; --i)
+            {
+                ret = add127Reference(ret, ret);
+                if (((i < 64 ? b0 : b1) >> (i % 64)) & 1)
+                    ret = add127Reference(ret, a);
+            }
+            return ret;
+        }
+    }
+
+    void Mersenne61_Test()
+    {
+        PRNG prng(toBlock(221));
+
+        for (u64 x : std::vector<u64>{ 0, 1, p61 - 1, p61, p61 + 1, 2 * p61, ~0ULL })
+            if (Mersenne61::reduce(x) != x % p61)
+                throw UnitTestFail(LOCATION);
+
+        std::vector<u64> edges{ 0, 1, 2, p61 - 1, p61 - 2, 1ULL << 60, (1ULL << 32) - 1 };
+        for (u64 i = 0; i < 100; ++i)
+            edges.push_back(prng.get<u64>() % p61);
+
+        for (u64 a : edges)
+        {
+            for (u64 j = 0; j < 10; ++j)
+            {
+                u64 b = edges[(j * 13 + a) % edges.size()];
+                if (Mersenne61::mul(a, b) != mul61Reference(a, b) ||
+                    Mersenne61::add(a, b) != (a + b) % p61 ||
+                    Mersenne61::sub(a, b) != (a + p61 - b) % p61)
+                    throw UnitTestFail(LOCATION);
+            }
+
+            if (a && Mersenne61(a) * Mersenne61(a).inverse() != Mersenne61(1))
+                throw UnitTestFail(LOCATION);
+        }
+
+        bool threw = false;
+        try { Mersenne61(0).inverse(); }
+        catch (std::runtime_error&) { threw = true; }
+        if (!threw)
+            throw UnitTestFail(LOCATION);
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX2 } }, [&]() {
+            for (u64 n : { 0, 1, 3, 4, 37, 1000 })
+            {
+                std::vector<u64> a(n), b(n), out(n), acc(n);
+                Mersenne61::sample(prng, a);
+                Mersenne61::sample(prng, b);
+                Mersenne61::sample(prng, acc);
+                if (n > 3)
+                    a[0] = b[0] = a[1] = p61 - 1;
+
+                Mersenne61::add(a, b, out);
+                for (u64 i = 0; i < n; ++i)
+                    if (out[i] != Mersenne61::add(a[i], b[i]))
+                        throw UnitTestFail(LOCATION);
+
+                Mersenne61::sub(a, b, out);
+                for (u64 i = 0; i < n; ++i)
+                    if (out[i] != Mersenne61::sub(a[i], b[i]))
+                        throw UnitTestFail(LOCATION);
+
+                Mersenne61::mul(a, b, out);
+                for (u64 i = 0; i < n; ++i)
+                    if (out[i] != Mersenne61::mul(a[i], b[i]))
+                        throw UnitTestFail(LOCATION);
+
+                auto acc0 = acc;
+                Mersenne61::mulAdd(a, b, acc);
+                Mersenne61 ip = 0;
+                for (u64 i = 0; i < n; ++i)
+                {
+                    if (acc[i] != Mersenne61::add(acc0[i], out[i]))
+                        throw UnitTestFail(LOCATION);
+                    ip += Mersenne61(a[i]) * Mersenne61(b[i]);
+                }
+
+                if (Mersenne61::innerProduct(a, b) != ip.value())
+                    throw UnitTestFail(LOCATION);
+            }
+        });
+
+        // the largest products, summed in 128 bits.
+        std::vector<u64> big(1000, p61 - 1);
+        if (Mersenne61::innerProduct(big, big) != 1000)
+            throw UnitTestFail(LOCATION);
+    }
+
+    void Mersenne127_Test()
+    {
+        PRNG prng(toBlock(222));
+        const block p = Mersenne127::Modulus;
+        const block pm1 = toBlock(~0ULL >> 1, ~0ULL - 1);
+
+        if (neq(Mersenne127::reduce(p), ZeroBlock) ||
+            neq(Mersenne127::reduce(AllOneBlock), OneBlock) ||
+            neq(Mersenne127::reduce(toBlock(1ULL << 63, 5)), toBlock(0, 6)))
+            throw UnitTestFail(LOCATION);
+
+        std::vector<block> edges{ ZeroBlock, OneBlock, pm1, toBlock(1, 0), toBlock(0, ~0ULL) };
+        std::vector<block> r(100);
+        Mersenne127::sample(prng, r);
+        edges.insert(edges.end(), r.begin(), r.end());
+
+        for (u64 k = 0; k < edges.size(); ++k)
+        {
+            block a = edges[k];
+            for (u64 j = 0; j < 10; ++j)
+            {
+                block b = edges[(j * 13 + k) % edges.size()];
+                if (neq(Mersenne127::mul(a, b), mul127Reference(a, b)) ||
+                    neq(Mersenne127::add(a, b), add127Reference(a, b)) ||
+                    neq(Mersenne127::add(Mersenne127::sub(a, b), b), a))
+                    throw UnitTestFail(LOCATION);
+            }
+
+            if (neq(a, ZeroBlock) && Mersenne127(a) * Mersenne127(a).inverse() != Mersenne127(1))
+                throw UnitTestFail(LOCATION);
+        }
+
+        if (Mersenne127(pm1) * Mersenne127(pm1) != Mersenne127(1) ||
+            -Mersenne127(1) != Mersenne127(pm1))
+            throw UnitTestFail(LOCATION);
+
+        for (u64 n : { 0, 1, 37, 1000 })
+        {
+            std::vector<block> a(n), b(n), out(n), acc(n);
+            Mersenne127::sample(prng, a);
+            Mersenne127::sample(prng, b);
+            Mersenne127::sample(prng, acc);
+
+            Mersenne127::mul(a, b, out);
+            auto acc0 = acc;
+            Mersenne127::mulAdd(a, b, acc);
+            Mersenne127 ip = 0;
+            for (u64 i = 0; i < n; ++i)
+            {
+                if (neq(out[i], Mersenne127::mul(a[i], b[i])) ||
+                    neq(acc[i], Mersenne127::add(acc0[i], out[i])))
+                    throw UnitTestFail(LOCATION);
+                ip += Mersenne127(a[i]) * Mersenne127(b[i]);
+            }
+
+            if (neq(Mersenne127::innerProduct(a, b), ip.value()))
+                throw UnitTestFail(LOCATION);
+        }
+
+        std::vector<block> big(1000, pm1);
+        if (neq(Mersenne127::innerProduct(big, big), toBlock(0, 1000)))
+            throw UnitTestFail(LOCATION);
+    }
+}
@@ -1,6 +1,9 @@
 #include "Misc_Tests.h"
 
 #include <cryptoTools/Common/BitVector.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cryptoTools/Common/Finally.h>
+#include <cryptoTools/Common/RankSelect.h>
 #include "Common.h"
 
 using namespace osuCrypto;
@@ -145,4 +148,206 @@ namespace tests_cryptoTools
 
 
     }
+
+    void BitVector_nChoosek_Test()
+    {
+        PRNG prng(toBlock(242));
+        BitVector v;
+
+        for (u64 k = 0; k <= 12; ++k)
+        {
+            v.nChoosek(20, k, prng);
+            if (v.size() != 20 || v.hammingWeight() != k)
+                throw UnitTestFail(LOCATION);
+        }
+
+        // each of the n positions is chosen with probability k / n.
+        u64 n = 20, k = 5, trials = 20000;
+        std::vector<u64> freq(n);
+        for (u64 t = 0; t < trials; ++t)
+        {
+            v.nChoosek(n, k, prng);
+            for (u64 i = 0; i < n; ++i)
+                freq[i] += v[i];
+        }
+
+        // the standard deviation is about 61.
+        for (u64 i = 0; i < n; ++i)
+            if (freq[i] < 5000 - 400 || freq[i] > 5000 + 400)
+                throw UnitTestFail(LOCATION);
+    }
+
+    void BitVector_Ops_Test()
+    {
+        PRNG prng(toBlock(241));
+
+        for (u64 n : { 0, 1, 7, 8, 100, 128, 1000, 1003 })
+        {
+            BitVector a(n), b(n), c(n);
+            a.randomize(prng);
+            b.randomize(prng);
+            c.randomize(prng);
+
+            BitVector r = a ^ (b & ~c);
+            BitVector s = ~(a | b) ^ c;
+            if (r.size() != n || s.size() != n)
+                throw UnitTestFail(LOCATION);
+            for (u64 i = 0; i < n; ++i)
+            {
+                if (r[i] != (a[i] ^ (b[i] & !c[i])) ||
+                    s[i] != (!(a[i] | b[i]) ^ c[i]))
+                    throw UnitTestFail(LOCATION);
+            }
+
+            // the same expressions fused into one pass.
+            if (r != BitVector(bitExpr(a) ^ (b & ~bitExpr(c))) ||
+                s != (~(bitExpr(a) | b) ^ c).eval())
+                throw UnitTestFail(LOCATION);
+
+            // the plain operators return a BitVector.
+            auto d = a ^ b;
+            u64 w = 0;
+            for (u64 i = 0; i < n; ++i)
+            {
+                w += d[i];
+                if ((a & b)[i] != (a[i] & b[i]))
+                    throw UnitTestFail(LOCATION);
+            }
+            if ((a ^ b).hammingWeight() != w ||
+                (n && (~a).data()[0] != u8(~a.data()[0] & (n < 8 ? (1 << n) - 1 : 0xFF))))
+                throw UnitTestFail(LOCATION);
+
+            // the three operand forms, with dst aliasing an operand.
+            BitVector x = a, y = a, z;
+            xorInto(x, x, b);
+            andInto(y, b, y);
+            orInto(z, a, b);
+            if (x != BitVector(a ^ b) || y != BitVector(a & b) || z != BitVector(a | b))
+                throw UnitTestFail(LOCATION);
+
+            BitVector a0 = a, b0 = b, c0 = c;
+            a ^= b;
+            b &= c;
+            c |= bitExpr(r) & s;
+            for (u64 i = 0; i < n; ++i)
+            {
+                if (x[i] != (a0[i] ^ b0[i]) ||
+                    a[i] != x[i] ||
+                    b[i] != (b0[i] & c0[i]) ||
+                    c[i] != (c0[i] | (r[i] & s[i])))
+                    throw UnitTestFail(LOCATION);
+            }
+
+            // the bits past the end are left clear.
+            BitVector ones = ~BitVector(n);
+            if (ones.hammingWeight() != n)
+                throw UnitTestFail(LOCATION);
+        }
+
+        BitVector a(10), b(11);
+        bool threw = false;
+        try { BitVector c = a & b; }
+        catch (std::runtime_error&) { threw = true; }
+        if (!threw)
+            throw UnitTestFail(LOCATION);
+    }
+
+    void BitVector_Popcount_Test()
+    {
+        PRNG prng(toBlock(251));
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX2, &CpuFeatures::mBMI2 }, { &CpuFeatures::mAVX2, &CpuFeatures::mPOPCNT } }, [&]() {
+            for (u64 n : { 0, 5, 64, 100, 255, 256, 1000, 4099 })
+            {
+                BitVector v(n);
+                v.randomize(prng);
+
+                // bits past the end are not counted.
+                if (n & 7)
+                    v.data()[n / 8] |= u8(0xFF << (n & 7));
+
+                u64 ham = 0;
+                for (u64 i = 0; i < n; ++i)
+                    ham += v[i];
+
+                if (v.hammingWeight() != ham || v.parity() != (ham & 1))
+                    throw UnitTestFail(LOCATION);
+            }
+        });
+    }
+
+    void RankSelect_Test()
+    {
+        PRNG prng(toBlock(252));
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX2, &CpuFeatures::mBMI2 }, { &CpuFeatures::mAVX2, &CpuFeatures::mPOPCNT } }, [&]() {
+            for (u64 n : { 0, 1, 511, 512, 513, 5000, 70000 })
+            {
+                // sparse, half full and full.
+                for (u64 density : { 50, 2, 1 })
+                {
+                    BitVector v(n);
+                    for (u64 i = 0; i < n; ++i)
+                        v[i] = prng.get<u8>() % density == 0;
+
+                    RankSelect rs(v);
+                    if (rs.size() != n || rs.count() != v.hammingWeight())
+                        throw UnitTestFail(LOCATION);
+
+                    u64 r = 0;
+                    for (u64 i = 0; i <= n; ++i)
+                    {
+                        if (rs.rank(i) != r)
+                            throw UnitTestFail(LOCATION);
+
+                        if (i < n && v[i])
+                        {
+                            if (rs.select(r) != i)
+                                throw UnitTestFail(LOCATION);
+                            ++r;
+                        }
+                    }
+
+                    bool threw = false;
+                    try { rs.select(r); }
+                    catch (std::runtime_error&) { threw = true; }
+                    if (!threw)
+                        throw UnitTestFail(LOCATION);
+                }
+            }
+        });
+    }
+
+    namespace
+    {
+        int variantAvx2() { return 2; }
+        int variantBaseline() { return 1; }
+    }
+
+    void CpuDispatch_Test()
+    {
+        auto detected = detectCpuFeatures();
+        Finally restore([&]() { setCpuFeatures(detected); });
+
+        CpuDispatch<int()> kernel{
+            { variantAvx2, { &CpuFeatures::mAVX2 } },
+            { variantBaseline, {} } };
+
+        if (kernel() != (detected.mAVX2 ? 2 : 1))
+            throw UnitTestFail(LOCATION);
+
+        auto noAvx2 = detected;
+        noAvx2.mAVX2 = false;
+        setCpuFeatures(noAvx2);
+        if (kernel() != 1)
+            throw UnitTestFail(LOCATION);
+
+        // no variant without requirements.
+        CpuDispatch<int()> avx2Only{ { variantAvx2, { &CpuFeatures::mAVX2 } } };
+        bool threw = false;
+        try { avx2Only(); }
+        catch (std::runtime_error&) { threw = true; }
+        if (!threw)
+            throw UnitTestFail(LOCATION);
+    }
 }
@@ -9,4 +9,9 @@ namespace tests_cryptoTools
     void BitVector_Append_Test_Impl();
     void BitVector_Copy_Test_Impl();
     void BitVector_Resize_Test_Impl();
+    void BitVector_Ops_Test();
+    void BitVector_nChoosek_Test();
+    void BitVector_Popcount_Test();
+    void RankSelect_Test();
+    void CpuDispatch_Test();
 }
\ No newline at end of file
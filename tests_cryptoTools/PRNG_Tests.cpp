@@ -0,0 +1,305 @@
+#include "PRNG_Tests.h"
+
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+#include "Common.h"
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/PRNG.h>
+#include <cryptoTools/Crypto/PRNGBackends.h>
+#include <cryptoTools/Common/BitVector.h>
+#include <cryptoTools/Common/Log.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+
+using namespace osuCrypto;
+
+namespace tests_cryptoTools
+{
+    namespace
+    {
+        // The stream of BasicPRNG<Backend> is the same for a single get,
+        // gets in odd chunks, jumpTo and parallelFill.
+        template<typename Backend>
+        void testBackend(const block& seed)
+        {
+            u64 length = 200000, bs = Backend::BlockSize;
+            std::vector<u8> expected(length), data(length + 1);
+            BasicPRNG<Backend> prng(seed, 7);
+            prng.get(expected.data(), length);
+
+            prng.SetSeed(seed);
+            for (u64 i = 0, step = 0; i < length; i += step)
+            {
+                step = std::min<u64>(length - i, (i * 13 + 5) % 9001);
+                prng.get(data.data() + 1 + i, step);
+            }
+            if (memcmp(data.data() + 1, expected.data(), length))
+                throw UnitTestFail(LOCATION);
+
+            for (u64 blockIdx : { 3, 0, 1000 })
+            {
+                prng.jumpTo(blockIdx);
+                prng.get(data.data(), 1000);
+                if (memcmp(data.data(), expected.data() + blockIdx * bs, 1000))
+                    throw UnitTestFail(LOCATION);
+            }
+
+            BasicPRNG<Backend> p2(seed);
+            p2.template get<u8>();
+            p2.parallelFill(span<u8>(data.data(), length - 1), 3);
+            if (memcmp(data.data(), expected.data() + 1, length - 1) || neq(p2.getSeed(), seed))
+                throw UnitTestFail(LOCATION);
+
+            // the default parts fit in the stream, whose length depends on
+            // the backend, and parts past its end are rejected.
+            BasicPRNG<Backend> p3(seed);
+            auto parts = p3.split(2);
+            u64 partBlocks = std::min<u64>(u64(1) << 40, (Backend::MaxBlocks - 256) / 3);
+            std::vector<u8> partData(1000);
+            for (u64 i = 0; i < 3; ++i)
+            {
+                p2.jumpTo(i * partBlocks);
+                p2.get(data.data(), partData.size());
+                (i < 2 ? parts[i] : p3).get(partData.data(), partData.size());
+                if (memcmp(data.data(), partData.data(), partData.size()))
+                    throw UnitTestFail(LOCATION);
+            }
+
+            bool threw = false;
+            try { BasicPRNG<Backend>(seed).split(2, Backend::MaxBlocks / 2); }
+            catch (std::runtime_error&) { threw = true; }
+            if (!threw)
+                throw UnitTestFail(LOCATION);
+        }
+    }
+
+    void PRNG_parallel_Test()
+    {
+        block seed = _mm_set_epi64x(12345678, 1234567);
+
+        u64 length = (1 << 18) + 13;
+        std::vector<u8> expected(length + 100), data(length + 1);
+        PRNG(seed).get(expected.data(), expected.size());
+
+        // jumpTo moves to any block of the stream.
+        PRNG prng(seed);
+        for (u64 blockIdx : { 5, 0, 300, 17 })
+        {
+            prng.jumpTo(blockIdx);
+            prng.get(data.data(), 1000);
+            if (memcmp(data.data(), expected.data() + blockIdx * 16, 1000))
+                throw UnitTestFail(LOCATION);
+        }
+
+        // the parts are consecutive slices and this PRNG continues after them.
+        prng.jumpTo(0);
+        prng.get<u8>();
+        auto parts = prng.split(3, 20);
+        for (u64 i = 0; i < parts.size(); ++i)
+        {
+            parts[i].get(data.data(), 20 * 16);
+            if (memcmp(data.data(), expected.data() + (1 + i * 20) * 16, 20 * 16))
+                throw UnitTestFail(LOCATION);
+        }
+        prng.get(data.data(), 16);
+        if (memcmp(data.data(), expected.data() + 61 * 16, 16))
+            throw UnitTestFail(LOCATION);
+
+        // a fork is seeded from the parent's stream.
+        prng.jumpTo(0);
+        block forkSeed;
+        memcpy(&forkSeed, expected.data(), sizeof(block));
+        if (neq(prng.fork().get<block>(), PRNG(forkSeed).get<block>()))
+            throw UnitTestFail(LOCATION);
+        prng.get(data.data(), 16);
+        if (memcmp(data.data(), expected.data() + 16, 16))
+            throw UnitTestFail(LOCATION);
+
+        // parallelFill gives the same bytes as get, from any offset and to
+        // an unaligned destination, and leaves the PRNG in the same state.
+        for (u64 offset : { 0, 1, 16, 33 })
+        {
+            for (u64 numThreads : { 1, 2, 3, 7 })
+            {
+                PRNG p(seed);
+                p.get(data.data(), offset);
+                p.parallelFill(span<u8>(data.data() + 1, length), numThreads);
+                if (memcmp(data.data() + 1, expected.data() + offset, length))
+                    throw UnitTestFail(LOCATION);
+
+                p.get(data.data(), 50);
+                if (memcmp(data.data(), expected.data() + offset + length, 50))
+                    throw UnitTestFail(LOCATION);
+            }
+        }
+
+        std::vector<u64> words(length / 8);
+        PRNG(seed).parallelFill(span<u64>(words), 4);
+        if (memcmp(words.data(), expected.data(), words.size() * 8))
+            throw UnitTestFail(LOCATION);
+    }
+
+    void PRNG_bulkGet_Test()
+    {
+        block seed = _mm_set_epi64x(12345678, 1234567);
+        u64 length = 100000;
+        std::vector<block> expected((length + 15) / 16);
+        AES(seed).ecbEncCounterMode(0, expected.size(), expected.data());
+
+        std::vector<u8> data(length + 1);
+        forEachCpuConfig({ { &CpuFeatures::mAES } }, [&]() {
+            // requests that start and end inside blocks and buffers, some of
+            // them much larger than the buffer, to an unaligned destination.
+            for (u64 bufferSize : { 1, 4, 256 })
+            {
+                PRNG prng(seed, bufferSize);
+                memset(data.data(), 0, data.size());
+                for (u64 i = 0, step = 0; i < length; i += step)
+                {
+                    step = std::min<u64>(length - i, (i * 13 + 5) % 9001);
+                    prng.get(data.data() + 1 + i, step);
+                }
+
+                if (memcmp(data.data() + 1, expected.data(), length))
+                    throw UnitTestFail(LOCATION);
+            }
+        });
+    }
+
+    void PRNG_uniform_Test()
+    {
+        block seed = _mm_set_epi64x(12345678, 1234567);
+        u64 n = 100003;
+        std::vector<u64> out(n), again(n);
+
+        // 2^31 + 1 and 2^63 + 1 reject almost half of the raw samples.
+        for (u64 bound : { u64(1), u64(3), u64(1000), (u64(1) << 31) + 1, u64(3) << 30,
+            u64(1) << 32, (u64(1) << 32) + 1, (u64(1) << 63) + 1, ~u64(0) })
+        {
+            PRNG prng(seed);
+            prng.getUniform(out, bound);
+            PRNG(seed).getUniform(again, bound);
+            if (out != again)
+                throw UnitTestFail(LOCATION);
+
+            // every value is in range and about half are below bound / 2.
+            u64 low = 0;
+            for (auto v : out)
+            {
+                if (v >= bound)
+                    throw UnitTestFail(LOCATION);
+                low += v < bound / 2;
+            }
+            double expected = double(n) * (bound / 2) / bound;
+            if (bound > 1 && std::abs(low - expected) > 5 * std::sqrt(expected))
+                throw UnitTestFail(LOCATION);
+
+            for (u64 i = 0; i < 1000; ++i)
+                if (prng.getUniform(bound) >= bound)
+                    throw UnitTestFail(LOCATION);
+        }
+
+        // a modulo of 32 bit samples would give 0 twice as often as 2^31.
+        u64 bound = u64(3) << 30, small = 0;
+        PRNG(seed).getUniform(out, bound);
+        for (auto v : out)
+            small += v < (u64(1) << 30);
+        if (std::abs(small - n / 3.0) > 5 * std::sqrt(n / 3.0))
+            throw UnitTestFail(LOCATION);
+
+        bool threw = false;
+        try { PRNG(seed).getUniform(0); }
+        catch (std::runtime_error&) { threw = true; }
+        if (threw == false)
+            throw UnitTestFail(LOCATION);
+    }
+
+    void PRNG_bits_Test()
+    {
+        block seed = _mm_set_epi64x(12345678, 1234567);
+        std::vector<u64> expected(100);
+        PRNG(seed).get(expected.data(), expected.size());
+
+        // the bits are the bytes of the stream, with the top of the last word cleared.
+        for (u64 numBits : { 1, 63, 64, 65, 1000, 6400 })
+        {
+            std::vector<u64> words(expected.size() + 1, ~u64(0));
+            PRNG(seed).getBits(words.data(), numBits);
+
+            BitVector bv;
+            PRNG(seed).getBits(bv, numBits);
+            if (bv.size() != numBits)
+                throw UnitTestFail(LOCATION);
+
+            u64 weight = 0;
+            for (u64 i = 0; i < numBits; ++i)
+            {
+                u8 bit = (expected[i / 64] >> (i % 64)) & 1;
+                weight += bit;
+                if (bit != ((words[i / 64] >> (i % 64)) & 1) || bit != bv[i])
+                    throw UnitTestFail(LOCATION);
+            }
+            if (numBits % 64 && words[numBits / 64] >> (numBits % 64))
+                throw UnitTestFail(LOCATION);
+            if (words[(numBits + 63) / 64] != ~u64(0) || bv.hammingWeight() != weight)
+                throw UnitTestFail(LOCATION);
+        }
+
+        // the iterator reads the words of the stream bit by bit.
+        PRNG prng(seed);
+        PRNGBitIterator iter(prng);
+        for (u64 i = 0; i < 64 * expected.size(); ++i, ++iter)
+            if (*iter != ((expected[i / 64] >> (i % 64)) & 1))
+                throw UnitTestFail(LOCATION);
+    }
+
+    void PRNG_backends_Test()
+    {
+        block seed = _mm_set_epi64x(12345678, 1234567);
+
+        testBackend<AesCtrBackend>(seed);
+        testBackend<Aes256CtrBackend>(seed);
+        testBackend<Blake2XbBackend>(seed);
+
+        // the AES-256 key is AES_seed of two blocks outside the counter stream.
+        AES kdf(seed);
+        std::array<block, 2> key256{ { kdf.ecbEncBlock(toBlock(1, 0)), kdf.ecbEncBlock(toBlock(2, 0)) } };
+        std::vector<block> ctr(100), ctr256(ctr.size());
+        AES256(key256).ecbEncCounterMode(0, ctr.size(), ctr.data());
+        Aes256PRNG(seed).get(ctr256.data(), ctr256.size());
+        if (memcmp(ctr.data(), ctr256.data(), ctr.size() * sizeof(block)))
+            throw UnitTestFail(LOCATION);
+
+        // the stream of Blake2PRNG is the BLAKE2Xb output of unspecified length.
+        std::vector<u8> expected(64 * 100), data(expected.size());
+        blake2xb_state state;
+        blake2xb_init_key(&state, 0xFFFFFFFFUL, &seed, sizeof(block));
+        blake2xb_final(&state, expected.data(), expected.size());
+        Blake2PRNG(seed).get(data.data(), data.size());
+        if (data != expected)
+            throw UnitTestFail(LOCATION);
+
+        // a reference ChaCha20 with the 16 byte key constants, at counters
+        // 0, 5 and 2^32 + 1.
+        std::vector<std::vector<u8>> chacha = {
+            { 0, 189, 254, 215, 112, 154, 214, 59, 253, 201, 102, 100, 237, 96, 87, 32 },
+            { 172, 135, 36, 75, 206, 163, 227, 103, 90, 44, 186, 137, 154, 63, 11, 128 },
+            { 210, 235, 81, 29, 67, 60, 162, 143, 34, 158, 137, 200, 103, 164, 172, 30 } };
+        u64 counters[] = { 0, 5, (u64(1) << 32) + 1 };
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX2 } }, [&]() {
+            testBackend<ChaChaBackend>(seed);
+
+            ChaChaPRNG prng(seed);
+            for (u64 i = 0; i < 3; ++i)
+            {
+                prng.jumpTo(counters[i]);
+                std::vector<u8> bytes(16);
+                prng.get(bytes.data(), bytes.size());
+                if (bytes != chacha[i])
+                    throw UnitTestFail(LOCATION);
+            }
+        });
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+// This file and the associated implementation has been placed in the public domain, waiving all copyright. No restrictions are placed on its use.
+
+namespace tests_cryptoTools
+{
+    void PRNG_parallel_Test();
+    void PRNG_bulkGet_Test();
+    void PRNG_uniform_Test();
+    void PRNG_bits_Test();
+    void PRNG_backends_Test();
+}
@@ -0,0 +1,129 @@
+#include "Permutation_Tests.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <vector>
+
+#include "Common.h"
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Crypto/Permutation.h>
+#include <cryptoTools/Crypto/PRNG.h>
+
+using namespace osuCrypto;
+
+namespace tests_cryptoTools
+{
+    void FeistelPrp_Test()
+    {
+        block seed = toBlock(34, 25);
+        for (u64 n : { 1ull, 2ull, 3ull, 5ull, 16ull, 17ull, 1000ull, 12345ull })
+        {
+            FeistelPrp prp(seed, n);
+
+            std::vector<u64> x(n), y(n), z(n);
+            std::iota(x.begin(), x.end(), 0);
+            prp.permute(x, y);
+            prp.inverse(y, z);
+
+            std::vector<u8> seen(n);
+            for (u64 i = 0; i < n; ++i)
+            {
+                if (y[i] >= n || seen[y[i]]++)
+                    throw UnitTestFail("not a permutation " LOCATION);
+                if (z[i] != i)
+                    throw UnitTestFail("inverse " LOCATION);
+                if (prp.permute(i) != y[i] || prp.inverse(y[i]) != i)
+                    throw UnitTestFail("batch " LOCATION);
+            }
+
+            if (n > 16)
+            {
+                FeistelPrp other(toBlock(34, 26), n);
+                u64 same = 0;
+                for (u64 i = 0; i < n; ++i)
+                    same += other.permute(i) == y[i];
+                if (same > n / 4)
+                    throw UnitTestFail("seed " LOCATION);
+            }
+        }
+
+        // large domains, including all of u64.
+        PRNG prng(seed);
+        for (u64 n : { (1ull << 40) + 7, ~0ull })
+        {
+            FeistelPrp prp(seed, n);
+            std::vector<u64> x(100), y(100), z(100);
+            for (auto& xx : x)
+                xx = prng.get<u64>() % n;
+
+            prp.permute(x, y);
+            prp.inverse(y, z);
+            if (x != z)
+                throw UnitTestFail(LOCATION);
+
+            for (auto yy : y)
+                if (yy >= n)
+                    throw UnitTestFail(LOCATION);
+        }
+
+        bool thrown = false;
+        try { FeistelPrp(seed, 10).permute(10); }
+        catch (std::exception&) { thrown = true; }
+        if (!thrown)
+            throw UnitTestFail("out of domain " LOCATION);
+    }
+
+    void parallelShuffle_Test()
+    {
+        block seed = toBlock(3, 4);
+        for (u64 n : { 0ull, 1ull, 2ull, 100ull, 100000ull, 1234567ull })
+        {
+            std::vector<u64> x(n);
+            std::iota(x.begin(), x.end(), 0);
+
+            auto y = x;
+            parallelShuffle<u64>(y, seed);
+
+            for (u64 numThreads : { 0ull, 2ull, 5ull })
+            {
+                auto z = x;
+                parallelShuffle<u64>(z, seed, numThreads);
+                if (y != z)
+                    throw UnitTestFail("depends on the thread count " LOCATION);
+            }
+
+            auto sorted = y;
+            std::sort(sorted.begin(), sorted.end());
+            if (sorted != x)
+                throw UnitTestFail("not a permutation " LOCATION);
+
+            if (n > 16)
+            {
+                u64 fixed = 0;
+                for (u64 i = 0; i < n; ++i)
+                    fixed += y[i] == i;
+                if (fixed > 10)
+                    throw UnitTestFail(LOCATION);
+
+                auto z = x;
+                parallelShuffle<u64>(z, toBlock(3, 5));
+                if (z == y)
+                    throw UnitTestFail("seed " LOCATION);
+            }
+        }
+
+        // each of the 6 permutations of 3 elements should be about as likely.
+        std::array<u64, 6> counts{};
+        u64 trials = 6000;
+        for (u64 t = 0; t < trials; ++t)
+        {
+            std::array<u8, 3> x{ {0, 1, 2} };
+            parallelShuffle<u8>(x, toBlock(7, t));
+            ++counts[x[0] * 2 + (x[1] > x[2])];
+        }
+        for (auto c : counts)
+            if (c < 850 || c > 1150)
+                throw UnitTestFail("biased " LOCATION);
+    }
+}
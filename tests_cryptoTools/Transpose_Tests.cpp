@@ -0,0 +1,121 @@
+#include "Transpose_Tests.h"
+
+#include <vector>
+
+#include "Common.h"
+#include <cryptoTools/Common/Defines.h>
+#include <cryptoTools/Common/CpuFeatures.h>
+#include <cryptoTools/Common/Matrix.h>
+#include <cryptoTools/Common/Transpose.h>
+#include <cryptoTools/Crypto/PRNG.h>
+
+using namespace osuCrypto;
+
+namespace tests_cryptoTools
+{
+    namespace
+    {
+        u8 getBit(const u8* row, u64 j) { return (row[j / 8] >> (j % 8)) & 1; }
+
+        // The bitwise transpose of in, padded with zeros like transpose().
+        Matrix<u8> transposeReference(const MatrixView<u8>& in)
+        {
+            Matrix<u8> out(8 * in.cols(), (in.rows() + 7) / 8);
+            for (u64 i = 0; i < in.rows(); ++i)
+                for (u64 j = 0; j < 8 * in.cols(); ++j)
+                    out(j, i / 8) |= getBit(in.data(i), j) << (i % 8);
+            return out;
+        }
+    }
+
+    void Transpose_128_Test()
+    {
+        PRNG prng(toBlock(211));
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX2 } }, [&]() {
+            std::array<block, 128> in, data;
+            prng.get(in.data(), in.size());
+            data = in;
+            transpose128(data);
+
+            for (u64 i = 0; i < 128; ++i)
+                for (u64 j = 0; j < 128; ++j)
+                    if (getBit((u8*)&data[j], i) != getBit((u8*)&in[i], j))
+                        throw UnitTestFail(LOCATION);
+
+            transpose128(data);
+            for (u64 i = 0; i < 128; ++i)
+                if (neq(data[i], in[i]))
+                    throw UnitTestFail(LOCATION);
+
+            std::array<std::array<block, 8>, 128> wide, wideIn;
+            prng.get(wideIn.data(), wideIn.size());
+            wide = wideIn;
+            transpose128x1024(wide);
+            for (u64 i = 0; i < 128; ++i)
+                for (u64 j = 0; j < 1024; ++j)
+                    if (getBit((u8*)&wide[j % 128][j / 128], i) != getBit((u8*)wideIn[i].data(), j))
+                        throw UnitTestFail(LOCATION);
+        });
+    }
+
+    void Transpose_matrix_Test()
+    {
+        PRNG prng(toBlock(212));
+
+        forEachCpuConfig({ { &CpuFeatures::mAVX2 } }, [&]() {
+            for (u64 rows : { 1, 100, 128, 300, 1024 })
+            {
+                for (u64 cols : { 1, 16, 21, 48 })
+                {
+                    Matrix<u8> in(rows, cols);
+                    prng.get(in.data(), in.size());
+                    auto expected = transposeReference(in);
+
+                    for (u64 numThreads : { 1, 3 })
+                    {
+                        // the padding bytes past (rows + 7) / 8 are left alone.
+                        Matrix<u8> out(8 * cols, (rows + 7) / 8 + 2);
+                        memset(out.data(), 0xcc, out.size());
+                        transpose(in, out, numThreads);
+
+                        for (u64 j = 0; j < out.rows(); ++j)
+                        {
+                            if (memcmp(out.data(j), expected.data(j), expected.cols()) ||
+                                out(j, expected.cols()) != 0xcc ||
+                                out(j, expected.cols() + 1) != 0xcc)
+                                throw UnitTestFail(LOCATION);
+                        }
+                    }
+                }
+            }
+
+            // N x 128 into 128 x N and back.
+            u64 n = 640;
+            Matrix<block> tall(n, 1), wide(128, n / 128), back(n, 1);
+            prng.get(tall.data(), tall.size());
+            transpose(tall, wide, 2);
+            transpose(wide, back);
+            for (u64 i = 0; i < n; ++i)
+                if (neq(tall(i, 0), back(i, 0)))
+                    throw UnitTestFail(LOCATION);
+
+            for (u64 i = 0; i < n; ++i)
+                for (u64 j = 0; j < 128; ++j)
+                    if (getBit((u8*)wide.data(j), i) != getBit((u8*)tall.data(i), j))
+                        throw UnitTestFail(LOCATION);
+        });
+
+        // 10 rows need 2 bytes in each of the 16 output rows.
+        Matrix<u8> in(10, 2);
+        for (auto shape : { std::make_pair(16, 1), std::make_pair(15, 2) })
+        {
+            Matrix<u8> bad(shape.first, shape.second);
+            bool threw = false;
+            try { transpose(in, bad); }
+            catch (std::runtime_error&) { threw = true; }
+            if (!threw)
+                throw UnitTestFail(LOCATION);
+        }
+    }
+}
@@ -2,6 +2,13 @@
 #include <functional>
 
 #include "tests_cryptoTools/AES_Tests.h"
+#include "tests_cryptoTools/PRNG_Tests.h"
+#include "tests_cryptoTools/GgmTree_Tests.h"
+#include "tests_cryptoTools/Permutation_Tests.h"
+#include "tests_cryptoTools/Hash_Tests.h"
+#include "tests_cryptoTools/GF128_Tests.h"
+#include "tests_cryptoTools/Transpose_Tests.h"
+#include "tests_cryptoTools/Mersenne_Tests.h"
 #include "tests_cryptoTools/BtChannel_Tests.h"
 #include "tests_cryptoTools/Ecc_Tests.h"
 #include "tests_cryptoTools/REcc_Tests.h"
@@ -37,12 +44,46 @@ namespace tests_cryptoTools
 
 
         th.add("AES                                     ", AES_EncDec_Test);
+        th.add("AES_dispatch_Test                       ", AES_dispatch_Test);
+        th.add("AES_keySizes_Test                       ", AES_keySizes_Test);
+        th.add("AES_multiKey_Test                       ", AES_multiKey_Test);
+        th.add("AES_hash_Test                           ", AES_hash_Test);
+        th.add("AES_bitsliced_Test                      ", AES_bitsliced_Test);
+        th.add("AES_stream_Test                         ", AES_stream_Test);
+
+        th.add("PRNG_parallel_Test                      ", PRNG_parallel_Test);
+        th.add("PRNG_bulkGet_Test                       ", PRNG_bulkGet_Test);
+        th.add("PRNG_uniform_Test                       ", PRNG_uniform_Test);
+        th.add("PRNG_bits_Test                          ", PRNG_bits_Test);
+        th.add("PRNG_backends_Test                      ", PRNG_backends_Test);
+
+        th.add("GgmTree_expand_Test                     ", GgmTree_expand_Test);
+        th.add("GgmTree_puncture_Test                   ", GgmTree_puncture_Test);
+        th.add("FeistelPrp_Test                         ", FeistelPrp_Test);
+        th.add("parallelShuffle_Test                    ", parallelShuffle_Test);
+        th.add("Blake2_hashMany_Test                    ", Blake2_hashMany_Test);
+        th.add("Blake2bp_Test                           ", Blake2bp_Test);
+        th.add("Blake2Xb_Test                           ", Blake2Xb_Test);
+        th.add("SHA1_Test                               ", SHA1_Test);
+        th.add("SHA256_Test                             ", SHA256_Test);
+        th.add("VectorCommit_Test                       ", VectorCommit_Test);
+        th.add("GF128_mul_Test                          ", GF128_mul_Test);
+        th.add("GF128_batch_Test                        ", GF128_batch_Test);
+        th.add("Transpose_128_Test                      ", Transpose_128_Test);
+        th.add("Transpose_matrix_Test                   ", Transpose_matrix_Test);
+        th.add("Mersenne61_Test                         ", Mersenne61_Test);
+        th.add("Mersenne127_Test                        ", Mersenne127_Test);
 
         th.add("BitVector_Indexing_Test                 ", BitVector_Indexing_Test_Impl);
         th.add("BitVector_Parity                        ", BitVector_Parity_Test_Impl);
         th.add("BitVector_Append_Test                   ", BitVector_Append_Test_Impl);
         th.add("BitVector_Copy_Test                     ", BitVector_Copy_Test_Impl);
         th.add("BitVector_Resize_Test                   ", BitVector_Resize_Test_Impl);
+        th.add("BitVector_nChoosek_Test                 ", BitVector_nChoosek_Test);
+        th.add("BitVector_Ops_Test                      ", BitVector_Ops_Test);
+        th.add("BitVector_Popcount_Test                 ", BitVector_Popcount_Test);
+        th.add("RankSelect_Test                         ", RankSelect_Test);
+        th.add("CpuDispatch_Test                        ", CpuDispatch_Test);
         //th.add("CuckooIndex_many_Test                   ", CuckooIndex_many_Test_Impl);
         //th.add("CuckooIndex_paramSweep_Test             ", CuckooIndex_paramSweep_Test_Impl);
         //th.add("CuckooIndex_parallel_Test               ", CuckooIndex_parallel_Test_Impl);